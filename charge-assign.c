@@ -18,11 +18,27 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "common.h"
 
 // #define CA_DEBUG
 
 /* Helper functions */
 
+/* OpenMP pragmas inside of the macro templates */
+#define CA_OMP(A) _Pragma(#A)
+
+/* Instantiation of the templates and dispatch for all orders
+   in BSPLINE_FOR_EACH_CAO. */
+#define CA_INSTANTIATE(cao, NAME, UNUSED) NAME##_template(cao)
+#define CA_DISPATCH(cao, NAME, ARGS) case cao: NAME##_##cao ARGS; break;
+
+
 #ifdef WRAP1
 inline static int wrap_mesh_index(int ind, int mesh) {
   if((ind > 0) && (ind < mesh))
@@ -51,8 +67,89 @@ inline static int int_floor(const FLOAT_TYPE x)
   return i - ( n & g ); /* i-1 if x<0 and x!=i */
 }
 
+/* Inverse mesh spacing per axis of the complex mesh, which may have a
+   different number of points per axis for a non-cubic box. */
+inline static void mesh_inverse_spacing(const system_t *s, const data_t *d, FLOAT_TYPE Hi[3])
+{
+  int dim;
+
+  for (dim=0;dim<3;dim++)
+    Hi[dim] = (double)d->grid[dim]/(double)s->box_l[dim];
+}
+
 /* Charge assignment functions */
 
+/* Thread-parallel charge assignment.
+   Particles are binned into columns of the mesh by the (x,y) index of the
+   first point of their stencil. The number of columns per direction is even
+   and every column is at least cao mesh planes wide, so a stencil only
+   reaches into its own column and the next one in each direction. Columns
+   of the same color (parity of the x and y column index) thus never write
+   to the same mesh point and can be filled concurrently without atomics. */
+
+typedef void (*assign_charge_range_t)(system_t *, parameters_t *, data_t *, int, const int *, int);
+
+static void assign_charge_colored(system_t *s, parameters_t *p, data_t *d, int ii, assign_charge_range_t assign_range)
+{
+#ifdef _OPENMP
+  const int cao = p->cao;
+  /* Number of columns per direction, even and at most mesh/cao */
+  const int n_col[2] = { (d->grid[0] / cao) & ~1, (d->grid[1] / cao) & ~1 };
+  const int n_cols = n_col[0]*n_col[1];
+
+  if((n_col[0] >= 2) && (n_col[1] >= 2) && (omp_get_max_threads() > 1) && !omp_in_parallel()) {
+    int id, dim, c, color;
+    int base[2];
+    FLOAT_TYPE pos;
+    FLOAT_TYPE Hi[3];
+    const FLOAT_TYPE pos_shift = (FLOAT_TYPE)((cao-1)/2);
+    int *col = Init_array(s->nparticles, sizeof(int));
+    int *offset = Init_array(n_cols+1, sizeof(int));
+    int *fill = Init_array(n_cols, sizeof(int));
+    int *ids = Init_array(s->nparticles, sizeof(int));
+
+    mesh_inverse_spacing(s, d, Hi);
+
+    /* Counting sort of the particles into columns */
+    for (id=0;id<s->nparticles;id++) {
+      for (dim=0;dim<2;dim++) {
+	pos = s->p->fields[dim][id]*Hi[dim] - pos_shift + 0.5*ii;
+	base[dim] = wrap_mesh_index( int_floor(pos + 0.5), d->grid[dim]);
+	base[dim] = (base[dim] * n_col[dim]) / d->grid[dim];
+      }
+      col[id] = base[0]*n_col[1] + base[1];
+      offset[col[id]+1]++;
+    }
+
+    for (c=0;c<n_cols;c++)
+      offset[c+1] += offset[c];
+
+    for (id=0;id<s->nparticles;id++) {
+      c = col[id];
+      ids[offset[c] + fill[c]++] = id;
+    }
+
+    for (color=0;color<4;color++) {
+      const int cx = color >> 1;
+      const int cy = color & 1;
+#pragma omp parallel for schedule(dynamic) private(c)
+      for (c=0;c<n_cols/4;c++) {
+	const int col_id = (2*(c / (n_col[1]/2)) + cx)*n_col[1] + 2*(c % (n_col[1]/2)) + cy;
+	assign_range(s, p, d, ii, ids + offset[col_id], offset[col_id+1] - offset[col_id]);
+      }
+    }
+
+    FFTW_FREE(col);
+    FFTW_FREE(offset);
+    FFTW_FREE(fill);
+    FFTW_FREE(ids);
+    return;
+  }
+#endif
+  assign_range(s, p, d, ii, NULL, s->nparticles);
+}
+
+
 /* Assignment on complex grid */
 void assign_charge_dynamic(system_t *s, parameters_t *p, data_t *d, int ii)
 {
@@ -72,14 +169,14 @@ void assign_charge_dynamic(system_t *s, parameters_t *p, data_t *d, int ii)
     int i,j,k;
     FLOAT_TYPE MI2 = 2.0*(FLOAT_TYPE)MaxInterpol;
 
-    FLOAT_TYPE Hi = (double)d->mesh/(double)s->length;
+    FLOAT_TYPE Hi[3];
 
     FLOAT_TYPE *cf = d->cf[ii];
     FLOAT_TYPE **interpol = d->inter->interpol;
     FLOAT_TYPE *Qmesh = d->Qmesh;
     FLOAT_TYPE q;
     const int cao = p->cao;
-    const int mesh = d->mesh;
+    const int *grid = d->grid;
 
     // Make sure parameter-set and data-set are compatible
 
@@ -88,26 +185,28 @@ void assign_charge_dynamic(system_t *s, parameters_t *p, data_t *d, int ii)
     /* Shift for odd charge assignment order */
     pos_shift = (FLOAT_TYPE)((p->cao-1)/2);
 
+    mesh_inverse_spacing(s, d, Hi);
+
     for (id=0;id<s->nparticles;id++) {
         /* particle position in mesh coordinates */
         for (dim=0;dim<3;dim++) {
-            pos    = s->p->fields[dim][id]*Hi - pos_shift + 0.5*ii;
+            pos    = s->p->fields[dim][id]*Hi[dim] - pos_shift + 0.5*ii;
             nmp = int_floor(pos + 0.5);
-	    base[dim]  = wrap_mesh_index( nmp, d->mesh);
+	    base[dim]  = wrap_mesh_index( nmp, grid[dim]);
             arg[dim] = int_floor((pos - nmp + 0.5)*MI2);
             d->ca_ind[ii][3*id + dim] = base[dim];
         }
 	q = s->q[id];
         cf_cnt = cf + id*p->cao3;
 	for (i0=0; i0<cao; i0++) {
-	  i = wrap_mesh_index(base[0] + i0, mesh);
+	  i = wrap_mesh_index(base[0] + i0, grid[0]);
 	  tmp0 = q * interpol[arg[0]][i0];
 	  for (i1=0; i1<cao; i1++) {
 	    tmp1 = tmp0 * interpol[arg[1]][i1];
-	    j = wrap_mesh_index(base[1] + i1, mesh);
+	    j = wrap_mesh_index(base[1] + i1, grid[1]);
 	    for (i2=0; i2<cao; i2++) {
 	      cur_ca_frac_val = tmp1 * interpol[arg[2]][i2];
-	      k = wrap_mesh_index(base[2] + i2, mesh);
+	      k = wrap_mesh_index(base[2] + i2, grid[2]);
 	      *cf_cnt++ = cur_ca_frac_val;
 	      Qmesh[c_ind(i,j,k)+ii] += cur_ca_frac_val;
 	    }
@@ -116,16 +215,19 @@ void assign_charge_dynamic(system_t *s, parameters_t *p, data_t *d, int ii)
     }
 }
 
-#define assign_charge_template(cao) void assign_charge_##cao(system_t *s, parameters_t *p, data_t *d, int ii) \
+#define assign_charge_template(cao) static void assign_charge_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
 { \
-    int dim, i0, i1, i2, id; \
+    int dim, i0, i1, i2, id, n; \
     FLOAT_TYPE tmp0, tmp1; \
     /* position of a particle in local mesh units */ \
     FLOAT_TYPE pos; \
     /* 1d-index of nearest mesh point */ \
     int nmp; \
-    /* index for caf interpolation grid */ \
-    int arg[3]; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const int direct = d->inter->direct; \
+    const int separable = d->cf_separable; \
     /* index, index jumps for rs_mesh array */ \
     FLOAT_TYPE cur_ca_frac_val; \
     FLOAT_TYPE * restrict cf_cnt; \
@@ -133,13 +235,13 @@ void assign_charge_dynamic(system_t *s, parameters_t *p, data_t *d, int ii)
     int i,j,k; \
     FLOAT_TYPE MI2 = 2.0*(FLOAT_TYPE)MaxInterpol; \
  \
-    FLOAT_TYPE Hi = (double)d->mesh/(double)s->length; \
+    FLOAT_TYPE Hi[3]; \
  \
     FLOAT_TYPE * restrict cf = d->cf[ii]; \
     FLOAT_TYPE ** restrict interpol = d->inter->interpol; \
     FLOAT_TYPE * restrict Qmesh = d->Qmesh; \
     FLOAT_TYPE q; \
-    const int mesh = d->mesh; \
+    const int * restrict grid = d->grid; \
  \
  \
     FLOAT_TYPE pos_shift; \
@@ -147,78 +249,77 @@ void assign_charge_dynamic(system_t *s, parameters_t *p, data_t *d, int ii)
     /* Shift for odd charge assignment order */ \
     pos_shift = (FLOAT_TYPE)((cao-1)/2); \
  \
-    for (id=0;id<s->nparticles;id++) { \
+    mesh_inverse_spacing(s, d, Hi); \
+ \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
         /* particle position in mesh coordinates */ \
         for (dim=0;dim<3;dim++) { \
-            pos    = s->p->fields[dim][id]*Hi - pos_shift + 0.5*ii; \
+            pos    = s->p->fields[dim][id]*Hi[dim] - pos_shift + 0.5*ii; \
             nmp = int_floor(pos + 0.5); \
-	    base[dim]  = wrap_mesh_index( nmp, d->mesh); \
-            arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+	    base[dim]  = wrap_mesh_index( nmp, grid[dim]); \
+            if(direct) { \
+              caf_bspline_weights(cao, pos - nmp, w[dim]); \
+              caf[dim] = w[dim]; \
+            } else { \
+              caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+            } \
             d->ca_ind[ii][3*id + dim] = base[dim]; \
         } \
 	q = s->q[id]; \
+        if(separable) { \
+          for (dim=0;dim<3;dim++) \
+            for (i0=0; i0<cao; i0++) \
+              cf[3*cao*id + cao*dim + i0] = caf[dim][i0]; \
+        } \
         cf_cnt = cf + id*cao*cao*cao; \
 	for (i0=0; i0<cao; i0++) { \
-	  i = wrap_mesh_index(base[0] + i0, mesh); \
-	  tmp0 = q * interpol[arg[0]][i0]; \
+	  i = wrap_mesh_index(base[0] + i0, grid[0]); \
+	  tmp0 = q * caf[0][i0]; \
 	  for (i1=0; i1<cao; i1++) { \
-	    tmp1 = tmp0 * interpol[arg[1]][i1]; \
-	    j = wrap_mesh_index(base[1] + i1, mesh); \
+	    tmp1 = tmp0 * caf[1][i1]; \
+	    j = wrap_mesh_index(base[1] + i1, grid[1]); \
 	    for (i2=0; i2<cao; i2++) { \
-	      cur_ca_frac_val = tmp1 * interpol[arg[2]][i2]; \
-	      k = wrap_mesh_index(base[2] + i2, mesh); \
-	      *cf_cnt++ = cur_ca_frac_val; \
+	      cur_ca_frac_val = tmp1 * caf[2][i2]; \
+	      k = wrap_mesh_index(base[2] + i2, grid[2]); \
+	      if(!separable) \
+		*cf_cnt++ = cur_ca_frac_val; \
 	      Qmesh[c_ind(i,j,k)+ii] += cur_ca_frac_val; \
 	    } \
 	  } \
 	}  \
     } \
 } \
+ \
+void assign_charge_##cao(system_t *s, parameters_t *p, data_t *d, int ii) \
+{ \
+  assign_charge_colored(s, p, d, ii, assign_charge_range_##cao); \
+}
 
-assign_charge_template(1)
-assign_charge_template(2)
-assign_charge_template(3)
-assign_charge_template(4)
-assign_charge_template(5)
-assign_charge_template(6)
-assign_charge_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge, )
 
 void assign_charge(system_t *s, parameters_t *p, data_t *d, int ii) {
   switch(p->cao) {
-  case 1:
-    assign_charge_1(s, p, d, ii);
-    break;
-  case 2:
-    assign_charge_2(s, p, d, ii);
-    break;
-  case 3:
-    assign_charge_3(s, p, d, ii);
-    break;
-  case 4:
-    assign_charge_4(s, p, d, ii);
-    break;
-  case 5:
-    assign_charge_5(s, p, d, ii);
-    break;
-  case 6:
-    assign_charge_6(s, p, d, ii);
-    break;
-  case 7:
-    assign_charge_7(s, p, d, ii);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge, (s, p, d, ii))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
   }
 }
 
-#define assign_charge_real_template(cao) void assign_charge_real_##cao(system_t *s, parameters_t *p, data_t *d) \
+/* Assignment on the r2c mesh QMESH of type MESH_T, instantiated for the
+   double mesh and for the float mesh of the mixed precision mode. */
+#define assign_charge_real_template_t(cao, SUF, MESH_T, QMESH) static void assign_charge_real##SUF##_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
 { \
-    int dim, i0, i1, i2, id; \
+    int dim, i0, i1, i2, id, n; \
     FLOAT_TYPE tmp0, tmp1; \
     FLOAT_TYPE pos; \
     int nmp; \
-    int arg[3]; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const int direct = d->inter->direct; \
+    const int separable = d->cf_separable; \
     FLOAT_TYPE cur_ca_frac_val; \
     FLOAT_TYPE *cf_cnt; \
     int base[3]; \
@@ -229,7 +330,7 @@ void assign_charge(system_t *s, parameters_t *p, data_t *d, int ii) {
 \
     FLOAT_TYPE *cf = d->cf[0]; \
     FLOAT_TYPE **interpol = d->inter->interpol; \
-    FLOAT_TYPE *Qmesh = d->Qmesh; \
+    MESH_T *Qmesh = QMESH; \
     FLOAT_TYPE q; \
     const int mesh = d->mesh; \
     int indx, indy; \
@@ -238,79 +339,294 @@ void assign_charge(system_t *s, parameters_t *p, data_t *d, int ii) {
 \
     pos_shift = (FLOAT_TYPE)((cao-1)/2); \
 \
-    for (id=0;id<s->nparticles;id++) { \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
         for (dim=0;dim<3;dim++) { \
             pos    = s->p->fields[dim][id]*Hi - pos_shift; \
             nmp = int_floor(pos + 0.5); \
 	    base[dim]  = wrap_mesh_index( nmp, d->mesh); \
-            arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+            if(direct) { \
+              caf_bspline_weights(cao, pos - nmp, w[dim]); \
+              caf[dim] = w[dim]; \
+            } else { \
+              caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+            } \
             d->ca_ind[0][3*id + dim] = base[dim]; \
         }	q = s->q[id]; \
+        if(separable) { \
+          for (dim=0;dim<3;dim++) \
+            for (i0=0; i0<cao; i0++) \
+              cf[3*cao*id + cao*dim + i0] = caf[dim][i0]; \
+        } \
         cf_cnt = cf + id*cao*cao*cao; \
 	for (i0=0; i0<cao; i0++) { \
 	  i = wrap_mesh_index(base[0] + i0, mesh); \
 	  indx = mesh*(mesh+2) * i; \
-	  tmp0 = q * interpol[arg[0]][i0]; \
+	  tmp0 = q * caf[0][i0]; \
 	  for (i1=0; i1<cao; i1++) { \
-	    tmp1 = tmp0 * interpol[arg[1]][i1]; \
+	    tmp1 = tmp0 * caf[1][i1]; \
 	    j = wrap_mesh_index(base[1] + i1, mesh); \
 	    indy = indx + (mesh+2) * j; \
 	    for (i2=0; i2<cao; i2++) { \
-	      cur_ca_frac_val = tmp1 * interpol[arg[2]][i2]; \
+	      cur_ca_frac_val = tmp1 * caf[2][i2]; \
 	      k = wrap_mesh_index(base[2] + i2, mesh); \
-	      *cf_cnt++ = cur_ca_frac_val; \
+	      if(!separable) \
+		*cf_cnt++ = cur_ca_frac_val; \
 	      Qmesh[indy + k] += cur_ca_frac_val; \
 	    } \
 	  } \
 	}  \
     } \
 } \
+ \
+void assign_charge_real##SUF##_##cao(system_t *s, parameters_t *p, data_t *d) \
+{ \
+  assign_charge_colored(s, p, d, 0, assign_charge_real##SUF##_range_##cao); \
+}
 
+#define assign_charge_real_template(cao) assign_charge_real_template_t(cao, , FLOAT_TYPE, d->Qmesh)
+#define assign_charge_real_float_template(cao) assign_charge_real_template_t(cao, _float, float, d->Qmesh_f)
 
-assign_charge_real_template(1)
-assign_charge_real_template(2)
-assign_charge_real_template(3)
-assign_charge_real_template(4)
-assign_charge_real_template(5)
-assign_charge_real_template(6)
-assign_charge_real_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_real, )
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_real_float, )
 
 void assign_charge_real(system_t *s, parameters_t *p, data_t *d) {
   switch(p->cao) {
-  case 1:
-    assign_charge_real_1(s, p, d);
-    break;
-  case 2:
-    assign_charge_real_2(s, p, d);
-    break;
-  case 3:
-    assign_charge_real_3(s, p, d);
-    break;
-  case 4:
-    assign_charge_real_4(s, p, d);
-    break;
-  case 5:
-    assign_charge_real_5(s, p, d);
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_real, (s, p, d))
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
-  case 6:
-    assign_charge_real_6(s, p, d);
+  }
+}
+
+void assign_charge_real_float(system_t *s, parameters_t *p, data_t *d) {
+  switch(p->cao) {
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_real_float, (s, p, d))
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
-  case 7:
-    assign_charge_real_7(s, p, d);
+  }
+}
+
+/* Assignment on a ghost-padded real mesh.
+   The padded mesh has pmesh = mesh + cao - 1 points per direction, the
+   halo behind the last plane holds the stencil points that would wrap
+   around. The inner loops therefore need no wrapping and the z-lines are
+   contiguous. fold_padded_mesh_real() adds the halo back onto the
+   periodic r2c mesh before the fft, mirror_padded_mesh_real() copies the
+   force mesh out to the halo before the gather. */
+
+#define assign_charge_real_padded_template(cao) static void assign_charge_real_padded_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
+{ \
+    int dim, i0, i1, i2, id, n; \
+    FLOAT_TYPE tmp0, tmp1; \
+    FLOAT_TYPE pos; \
+    int nmp; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const int direct = d->inter->direct; \
+    const int separable = d->cf_separable; \
+    FLOAT_TYPE * restrict cf_cnt; \
+    int base[3]; \
+    const FLOAT_TYPE MI2 = 2.0*(FLOAT_TYPE)MaxInterpol; \
+ \
+    const FLOAT_TYPE Hi = (double)d->mesh/(double)s->length; \
+ \
+    FLOAT_TYPE * restrict cf = d->cf[0]; \
+    FLOAT_TYPE ** restrict interpol = d->inter->interpol; \
+    FLOAT_TYPE * restrict Qmesh = d->Qmesh_pad; \
+    FLOAT_TYPE q; \
+    const int mesh = d->mesh; \
+    const int pmesh = mesh + cao - 1; \
+ \
+    const FLOAT_TYPE pos_shift = (FLOAT_TYPE)((cao-1)/2); \
+ \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
+        for (dim=0;dim<3;dim++) { \
+            pos    = s->p->fields[dim][id]*Hi - pos_shift; \
+            nmp = int_floor(pos + 0.5); \
+	    base[dim]  = wrap_mesh_index( nmp, mesh); \
+            if(direct) { \
+              caf_bspline_weights(cao, pos - nmp, w[dim]); \
+              caf[dim] = w[dim]; \
+            } else { \
+              caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+            } \
+            d->ca_ind[0][3*id + dim] = base[dim]; \
+        } \
+	q = s->q[id]; \
+        if(separable) { \
+          for (dim=0;dim<3;dim++) \
+            for (i0=0; i0<cao; i0++) \
+              cf[3*cao*id + cao*dim + i0] = caf[dim][i0]; \
+        } \
+        cf_cnt = cf + id*cao*cao*cao; \
+	for (i0=0; i0<cao; i0++) { \
+	  tmp0 = q * caf[0][i0]; \
+	  for (i1=0; i1<cao; i1++) { \
+	    FLOAT_TYPE * restrict row = Qmesh + pmesh*(pmesh*(base[0] + i0) + base[1] + i1) + base[2]; \
+	    tmp1 = tmp0 * caf[1][i1]; \
+	    CA_OMP(omp simd) \
+	    for (i2=0; i2<cao; i2++) { \
+	      const FLOAT_TYPE v = tmp1 * caf[2][i2]; \
+	      if(!separable) \
+		cf_cnt[cao*(cao*i0 + i1) + i2] = v; \
+	      row[i2] += v; \
+	    } \
+	  } \
+	} \
+    } \
+} \
+ \
+void assign_charge_real_padded_##cao(system_t *s, parameters_t *p, data_t *d) \
+{ \
+  assign_charge_colored(s, p, d, 0, assign_charge_real_padded_range_##cao); \
+}
+
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_real_padded, )
+
+void assign_charge_real_padded(system_t *s, parameters_t *p, data_t *d) {
+  switch(p->cao) {
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_real_padded, (s, p, d))
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
+  }
+}
+
+#define assign_forces_real_padded_template(cao) void assign_forces_real_padded_##cao(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f) { \
+  int i,i0,i1,i2; \
+  const FLOAT_TYPE * restrict cf_cnt, * restrict cf_row; \
+  FLOAT_TYPE cf_scale; \
+  const int separable = d->cf_separable; \
+  const int * restrict base; \
+  int l_ind; \
+  FLOAT_TYPE field_x, field_y, field_z; \
+  const FLOAT_TYPE * restrict fmesh_x = d->Fmesh_pad->fields[0], * restrict fmesh_y = d->Fmesh_pad->fields[1], * restrict fmesh_z = d->Fmesh_pad->fields[2]; \
+  const int pmesh = d->mesh + cao - 1; \
+ \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt,cf_row,cf_scale,base,l_ind,field_x,field_y,field_z)) \
+  for (i=0; i<s->nparticles; i++) { \
+    field_x = field_y = field_z = 0; \
+    base = d->ca_ind[0] + 3*i; \
+    cf_cnt = d->cf[0] + (separable ? 3*cao : cao*cao*cao)*i; \
+    for (i0=0; i0<cao; i0++) { \
+      for (i1=0; i1<cao; i1++) { \
+	l_ind = pmesh*(pmesh*(base[0] + i0) + base[1] + i1) + base[2]; \
+	if(separable) { \
+	  cf_row = cf_cnt + 2*cao; \
+	  cf_scale = s->q[i]*cf_cnt[i0]*cf_cnt[cao + i1]; \
+	} else { \
+	  cf_row = cf_cnt + cao*(cao*i0 + i1); \
+	  cf_scale = 1.0; \
+	} \
+	CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
+	for (i2=0; i2<cao; i2++) { \
+	  const FLOAT_TYPE B = force_prefac*cf_scale*cf_row[i2]; \
+	  field_x -= fmesh_x[l_ind + i2]*B; \
+	  field_y -= fmesh_y[l_ind + i2]*B; \
+	  field_z -= fmesh_z[l_ind + i2]*B; \
+	} \
+      } \
+    } \
+    f->f_k->fields[0][i] += field_x; \
+    f->f_k->fields[1][i] += field_y; \
+    f->f_k->fields[2][i] += field_z; \
+  } \
+} \
+
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_real_padded, )
+
+void assign_forces_real_padded(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
+  switch(p->cao) {
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_real_padded, (prefactor, s, p, d, f))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
   }
 }
+
+/* Adds the halo of the padded charge mesh to its periodic images
+   and stores the result in the r2c layout of d->Qmesh. */
+void fold_padded_mesh_real(parameters_t *p, data_t *d) {
+  const int mesh = d->mesh;
+  const int halo = p->cao - 1;
+  const int pmesh = mesh + halo;
+  FLOAT_TYPE * restrict pad = d->Qmesh_pad;
+  FLOAT_TYPE * restrict Qmesh = d->Qmesh;
+  int i, j, k;
+
+  /* x-direction, whole planes */
+#pragma omp parallel for private(k)
+  for (i=0; i<halo; i++)
+    for (k=0; k<pmesh*pmesh; k++)
+      pad[pmesh*pmesh*i + k] += pad[pmesh*pmesh*(i+mesh) + k];
+
+  /* y-direction, whole lines */
+#pragma omp parallel for private(j, k)
+  for (i=0; i<mesh; i++)
+    for (j=0; j<halo; j++)
+      for (k=0; k<pmesh; k++)
+	pad[pmesh*(pmesh*i + j) + k] += pad[pmesh*(pmesh*i + j + mesh) + k];
+
+  /* z-direction and copy into the periodic mesh */
+#pragma omp parallel for private(j, k)
+  for (i=0; i<mesh; i++)
+    for (j=0; j<mesh; j++) {
+      const FLOAT_TYPE * restrict row = pad + pmesh*(pmesh*i + j);
+      FLOAT_TYPE * restrict q_row = Qmesh + mesh*(mesh+2)*i + (mesh+2)*j;
+      for (k=0; k<mesh; k++)
+	q_row[k] = row[k];
+      for (k=0; k<halo; k++)
+	q_row[k] += row[k + mesh];
+    }
+}
+
+/* Copies the r2c layout force meshes into the padded force meshes,
+   filling the halo with the periodic images. */
+void mirror_padded_mesh_real(parameters_t *p, data_t *d) {
+  const int mesh = d->mesh;
+  const int halo = p->cao - 1;
+  const int pmesh = mesh + halo;
+  int dim, i, j, k;
+
+  for (dim=0; dim<3; dim++) {
+    const FLOAT_TYPE * restrict Fmesh = d->Fmesh->fields[dim];
+    FLOAT_TYPE * restrict pad = d->Fmesh_pad->fields[dim];
+
+#pragma omp parallel for private(j, k)
+    for (i=0; i<mesh; i++) {
+      for (j=0; j<mesh; j++) {
+	FLOAT_TYPE * restrict row = pad + pmesh*(pmesh*i + j);
+	const FLOAT_TYPE * restrict f_row = Fmesh + mesh*(mesh+2)*i + (mesh+2)*j;
+	for (k=0; k<mesh; k++)
+	  row[k] = f_row[k];
+	for (k=0; k<halo; k++)
+	  row[k + mesh] = f_row[k];
+      }
+      for (j=0; j<halo; j++)
+	memcpy(pad + pmesh*(pmesh*i + j + mesh), pad + pmesh*(pmesh*i + j), pmesh*sizeof(FLOAT_TYPE));
+    }
+
+#pragma omp parallel for
+    for (i=0; i<halo; i++)
+      memcpy(pad + pmesh*pmesh*(i + mesh), pad + pmesh*pmesh*i, pmesh*pmesh*sizeof(FLOAT_TYPE));
+  }
+}
  
-#define assign_charge_real_res_template(cao) void assign_charge_real_res_##cao(system_t *s, parameters_t *p, data_t *d) \
+#define assign_charge_real_res_template(cao) static void assign_charge_real_res_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
 { \
-    int dim, i0, i1, i2, id; \
+    int dim, i0, i1, i2, id, n; \
     FLOAT_TYPE tmp0, tmp1; \
     FLOAT_TYPE pos; \
     int nmp; \
-    int arg[3]; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const int direct = d->inter->direct; \
+    const int separable = d->cf_separable; \
     FLOAT_TYPE cur_ca_frac_val; \
     FLOAT_TYPE *cf_cnt; \
     int base[3]; \
@@ -330,65 +646,56 @@ void assign_charge_real(system_t *s, parameters_t *p, data_t *d) {
  \
     pos_shift = (FLOAT_TYPE)((cao-1)/2); \
  \
-    for (id=0;id<s->nparticles;id++) { \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
         for (dim=0;dim<3;dim++) { \
             pos    = s->p->fields[dim][id]*Hi - pos_shift; \
             nmp = int_floor(pos + 0.5); \
 	    base[dim]  = wrap_mesh_index( nmp, d->mesh); \
-            arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+            if(direct) { \
+              caf_bspline_weights(cao, pos - nmp, w[dim]); \
+              caf[dim] = w[dim]; \
+            } else { \
+              caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+            } \
             d->ca_ind[0][3*id + dim] = base[dim]; \
         }	q = s->q[id]; \
+        if(separable) { \
+          for (dim=0;dim<3;dim++) \
+            for (i0=0; i0<cao; i0++) \
+              cf[3*cao*id + cao*dim + i0] = caf[dim][i0]; \
+        } \
         cf_cnt = cf + id*cao*cao*cao; \
 	for (i0=0; i0<cao; i0++) { \
 	  i = wrap_mesh_index(base[0] + i0, mesh); \
 	  indx = mesh*(mesh+2) * i; \
-	  tmp0 = q * interpol[arg[0]][i0]; \
+	  tmp0 = q * caf[0][i0]; \
 	  for (i1=0; i1<cao; i1++) { \
-	    tmp1 = tmp0 * interpol[arg[1]][i1]; \
+	    tmp1 = tmp0 * caf[1][i1]; \
 	    j = wrap_mesh_index(base[1] + i1, mesh); \
 	    indy = indx + (mesh+2) * j; \
 	    for (i2=0; i2<cao; i2++) { \
-	      cur_ca_frac_val = tmp1 * interpol[arg[2]][i2]; \
+	      cur_ca_frac_val = tmp1 * caf[2][i2]; \
 	      k = wrap_mesh_index(base[2] + i2, mesh); \
-	      *cf_cnt++ = cur_ca_frac_val;	       \
+	      if(!separable) \
+		*cf_cnt++ = cur_ca_frac_val;	       \
 	      Qmesh[indy + k] += cur_ca_frac_val; \
 	    } \
 	  } \
 	}  \
     } \
 } \
+ \
+void assign_charge_real_res_##cao(system_t *s, parameters_t *p, data_t *d) \
+{ \
+  assign_charge_colored(s, p, d, 0, assign_charge_real_res_range_##cao); \
+}
 
-assign_charge_real_res_template(1)
-assign_charge_real_res_template(2)
-assign_charge_real_res_template(3)
-assign_charge_real_res_template(4)
-assign_charge_real_res_template(5)
-assign_charge_real_res_template(6)
-assign_charge_real_res_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_real_res, )
 
 void assign_charge_real_res(system_t *s, parameters_t *p, data_t *d) {
   switch(p->cao) {
-  case 1:
-    assign_charge_real_res_1(s, p, d);
-    break;
-  case 2:
-    assign_charge_real_res_2(s, p, d);
-    break;
-  case 3:
-    assign_charge_real_res_3(s, p, d);
-    break;
-  case 4:
-    assign_charge_real_res_4(s, p, d);
-    break;
-  case 5:
-    assign_charge_real_res_5(s, p, d);
-    break;
-  case 6:
-    assign_charge_real_res_6(s, p, d);
-    break;
-  case 7:
-    assign_charge_real_res_7(s, p, d);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_real_res, (s, p, d))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -505,16 +812,18 @@ void assign_charge_real_nostor_res_dynamic(system_t *s, parameters_t *p, data_t
     }
 }
 
-#define assign_charge_real_nostor_template(cao) void assign_charge_real_nostor_##cao(system_t *s, parameters_t *p, data_t *d) \
+#define assign_charge_real_nostor_template(cao) static void assign_charge_real_nostor_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
 { \
-    int dim, i0, i1, i2, id; \
+    int dim, i0, i1, i2, id, n; \
     FLOAT_TYPE tmp0, tmp1; \
     /* position of a particle in local mesh units */ \
     FLOAT_TYPE pos; \
     /* 1d-index of nearest mesh point */ \
     int nmp; \
-    /* index for caf interpolation grid */ \
-    int arg[3]; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const int direct = d->inter->direct; \
     /* index, index jumps for rs_mesh array */ \
     int base[3]; \
     int i,j,k; \
@@ -533,62 +842,46 @@ void assign_charge_real_nostor_res_dynamic(system_t *s, parameters_t *p, data_t
     /* Shift for odd charge assignment order */ \
     pos_shift = (FLOAT_TYPE)((cao-1)/2); \
  \
-    for (id=0;id<s->nparticles;id++) { \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
         /* particle position in mesh coordinates */ \
         for (dim=0;dim<3;dim++) { \
             pos    = s->p->fields[dim][id]*Hi - pos_shift; \
             nmp = int_floor(pos + 0.5); \
 	    base[dim]  = wrap_mesh_index( nmp, d->mesh); \
-            arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+            if(direct) { \
+              caf_bspline_weights(cao, pos - nmp, w[dim]); \
+              caf[dim] = w[dim]; \
+            } else { \
+              caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+            } \
         }	 \
 	q = s->q[id]; \
 	for (i0=0; i0<cao; i0++) { \
 	  i = wrap_mesh_index(base[0] + i0, mesh); \
-	  tmp0 = q * interpol[arg[0]][i0]; \
+	  tmp0 = q * caf[0][i0]; \
 	  for (i1=0; i1<cao; i1++) { \
-	    tmp1 = tmp0 * interpol[arg[1]][i1]; \
+	    tmp1 = tmp0 * caf[1][i1]; \
 	    j = wrap_mesh_index(base[1] + i1, mesh); \
 	    for (i2=0; i2<cao; i2++) { \
 	      k = wrap_mesh_index(base[2] + i2, mesh); \
-	      Qmesh[mesh*(mesh+2) * i + (mesh+2) * j + k] += tmp1 * interpol[arg[2]][i2]; \
+	      Qmesh[mesh*(mesh+2) * i + (mesh+2) * j + k] += tmp1 * caf[2][i2]; \
 	    } \
 	  } \
 	}  \
     } \
+} \
+ \
+void assign_charge_real_nostor_##cao(system_t *s, parameters_t *p, data_t *d) \
+{ \
+  assign_charge_colored(s, p, d, 0, assign_charge_real_nostor_range_##cao); \
 }
 
-
-assign_charge_real_nostor_template(1)
-assign_charge_real_nostor_template(2)
-assign_charge_real_nostor_template(3)
-assign_charge_real_nostor_template(4)
-assign_charge_real_nostor_template(5)
-assign_charge_real_nostor_template(6)
-assign_charge_real_nostor_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_real_nostor, )
 
 void assign_charge_real_nostor(system_t *s, parameters_t *p, data_t *d) {
   switch(p->cao) {
-  case 1:
-    assign_charge_real_nostor_1(s, p, d);
-    break;
-  case 2:
-    assign_charge_real_nostor_2(s, p, d);
-    break;
-  case 3:
-    assign_charge_real_nostor_3(s, p, d);
-    break;
-  case 4:
-    assign_charge_real_nostor_4(s, p, d);
-    break;
-  case 5:
-    assign_charge_real_nostor_5(s, p, d);
-    break;
-  case 6:
-    assign_charge_real_nostor_6(s, p, d);
-    break;
-  case 7:
-    assign_charge_real_nostor_7(s, p, d);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_real_nostor, (s, p, d))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -598,83 +891,104 @@ void assign_charge_real_nostor(system_t *s, parameters_t *p, data_t *d) {
 
 
 // assign the forces obtained from k-space
-void assign_forces(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f, int ii) {
-  int i,i0,i1,i2;
-  FLOAT_TYPE *cf_cnt;
-  int *base;
-  int j,k,l;
-  FLOAT_TYPE B;
-  FLOAT_TYPE field_x, field_y, field_z;
-  int l_ind;
-  FLOAT_TYPE *fmesh_x = d->Fmesh->fields[0], *fmesh_y = d->Fmesh->fields[1], *fmesh_z = d->Fmesh->fields[2];
-  int mesh = d->mesh;
-
-  const int cao = p->cao;
-
-  cf_cnt = d->cf[ii];
+#define assign_forces_template(cao) void assign_forces_##cao(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f, int ii) { \
+  int i,i0,i1,i2; \
+  const FLOAT_TYPE * restrict cf_cnt, * restrict cf_row; \
+  FLOAT_TYPE cf_scale; \
+  const int separable = d->cf_separable; \
+  const int * restrict base; \
+  int j,k; \
+  FLOAT_TYPE field_x, field_y, field_z; \
+  const FLOAT_TYPE * restrict fmesh_x = d->Fmesh->fields[0], * restrict fmesh_y = d->Fmesh->fields[1], * restrict fmesh_z = d->Fmesh->fields[2]; \
+  const int * restrict grid = d->grid; \
+  /* Interlaced forces are averaged over both meshes */ \
+  const FLOAT_TYPE scale = (ii == 1) ? 0.5 : 1.0; \
+ \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt,cf_row,cf_scale,base,j,k,field_x,field_y,field_z)) \
+  for (i=0; i<s->nparticles; i++) { \
+    field_x = field_y = field_z = 0; \
+    base = d->ca_ind[ii] + 3*i; \
+    cf_cnt = d->cf[ii] + (separable ? 3*cao : cao*cao*cao)*i; \
+    for (i0=0; i0<cao; i0++) { \
+      j = wrap_mesh_index(base[0] + i0, grid[0]); \
+      for (i1=0; i1<cao; i1++) { \
+	k = wrap_mesh_index(base[1] + i1, grid[1]); \
+	if(separable) { \
+	  cf_row = cf_cnt + 2*cao; \
+	  cf_scale = s->q[i]*cf_cnt[i0]*cf_cnt[cao + i1]; \
+	} else { \
+	  cf_row = cf_cnt + cao*(cao*i0 + i1); \
+	  cf_scale = 1.0; \
+	} \
+	CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
+	for (i2=0; i2<cao; i2++) { \
+	  const int l_ind = c_ind(j,k,wrap_mesh_index(base[2] + i2, grid[2]))+ii; \
+	  const FLOAT_TYPE B = force_prefac*cf_scale*cf_row[i2]; \
+	  field_x -= fmesh_x[l_ind]*B; \
+	  field_y -= fmesh_y[l_ind]*B; \
+	  field_z -= fmesh_z[l_ind]*B; \
+	} \
+      } \
+    } \
+    f->f_k->fields[0][i] = scale*(f->f_k->fields[0][i] + field_x); \
+    f->f_k->fields[1][i] = scale*(f->f_k->fields[1][i] + field_y); \
+    f->f_k->fields[2][i] = scale*(f->f_k->fields[2][i] + field_z); \
+  } \
+} \
 
-  for (i=0; i<s->nparticles; i++) {
-    field_x = field_y = field_z = 0;
-    base = d->ca_ind[ii] + 3*i;
-    for (i0=0; i0<cao; i0++) {
-      j = wrap_mesh_index(base[0] + i0, mesh);
-      for (i1=0; i1<cao; i1++) {
-	k = wrap_mesh_index(base[1] + i1, mesh);
-	for (i2=0; i2<cao; i2++) {
-	  l = wrap_mesh_index(base[2] + i2, mesh);
-	  B = force_prefac*(*cf_cnt++);
-	  l_ind = c_ind(j,k,l)+ii;
-	  field_x -= fmesh_x[l_ind]*B;
-	  field_y -= fmesh_y[l_ind]*B;
-	  field_z -= fmesh_z[l_ind]*B;
-	}
-      }
-    }
-    f->f_k->fields[0][i] += field_x;
-    f->f_k->fields[1][i] += field_y;
-    f->f_k->fields[2][i] += field_z;
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces, )
 
-    if (ii==1) {
-      f->f_k->fields[0][i] *= 0.5;
-      f->f_k->fields[1][i] *= 0.5;
-      f->f_k->fields[2][i] *= 0.5;
-    }
+void assign_forces(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f, int ii) {
+  switch(p->cao) {
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces, (force_prefac, s, p, d, f, ii))
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", p->cao);
+    break;
   }
 }
 
 // assign the forces obtained from k-space
 #define assign_forces_interlacing_template(cao) void assign_forces_interlacing_##cao(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f) { \
   int i,i0,i1,i2; \
-  FLOAT_TYPE * restrict cf_cnt1, * restrict cf_cnt2; \
-  int * restrict base1, * restrict base2; \
-  int j1,k1,l1,j2,k2,l2; \
-  FLOAT_TYPE B1, B2; \
+  const FLOAT_TYPE * restrict cf_cnt1, * restrict cf_cnt2, * restrict cf_row1, * restrict cf_row2; \
+  FLOAT_TYPE cf_scale1, cf_scale2; \
+  const int separable = d->cf_separable; \
+  const int * restrict base1, * restrict base2; \
+  int j1,k1,j2,k2; \
   FLOAT_TYPE field_x, field_y, field_z; \
-  int l_ind1, l_ind2; \
   const FLOAT_TYPE * restrict fmesh_x = d->Fmesh->fields[0], * restrict fmesh_y = d->Fmesh->fields[1], * restrict fmesh_z = d->Fmesh->fields[2]; \
  \
   const int mesh = d->mesh; \
  \
-  cf_cnt1 = d->cf[0]; \
-  cf_cnt2 = d->cf[1]; \
- \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt1,cf_cnt2,cf_row1,cf_row2,cf_scale1,cf_scale2,base1,base2,j1,k1,j2,k2,field_x,field_y,field_z)) \
   for (i=0; i<s->nparticles; i++) { \
     field_x = field_y = field_z = 0; \
     base1 = d->ca_ind[0] + 3*i; \
     base2 = d->ca_ind[1] + 3*i; \
+    cf_cnt1 = d->cf[0] + (separable ? 3*cao : cao*cao*cao)*i; \
+    cf_cnt2 = d->cf[1] + (separable ? 3*cao : cao*cao*cao)*i; \
     for (i0=0; i0<cao; i0++) { \
       j1 = wrap_mesh_index(base1[0] + i0, mesh); \
       j2 = wrap_mesh_index(base2[0] + i0, mesh); \
       for (i1=0; i1<cao; i1++) { \
 	k1 = wrap_mesh_index(base1[1] + i1, mesh); \
 	k2 = wrap_mesh_index(base2[1] + i1, mesh); \
+	if(separable) { \
+	  cf_row1 = cf_cnt1 + 2*cao; \
+	  cf_row2 = cf_cnt2 + 2*cao; \
+	  cf_scale1 = s->q[i]*cf_cnt1[i0]*cf_cnt1[cao + i1]; \
+	  cf_scale2 = s->q[i]*cf_cnt2[i0]*cf_cnt2[cao + i1]; \
+	} else { \
+	  cf_row1 = cf_cnt1 + cao*(cao*i0 + i1); \
+	  cf_row2 = cf_cnt2 + cao*(cao*i0 + i1); \
+	  cf_scale1 = cf_scale2 = 1.0; \
+	} \
+	CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
 	for (i2=0; i2<cao; i2++) { \
-	  l1 = wrap_mesh_index(base1[2] + i2, mesh); \
-	  l2 = wrap_mesh_index(base2[2] + i2, mesh); \
-	  B1 = 0.5*force_prefac*(*cf_cnt1++); \
-	  B2 = 0.5*force_prefac*(*cf_cnt2++); \
-	  l_ind1 = c_ind(j1,k1,l1); \
-	  l_ind2 = c_ind(j2,k2,l2); \
+	  const int l_ind1 = c_ind(j1,k1,wrap_mesh_index(base1[2] + i2, mesh)); \
+	  const int l_ind2 = c_ind(j2,k2,wrap_mesh_index(base2[2] + i2, mesh)); \
+	  const FLOAT_TYPE B1 = 0.5*force_prefac*cf_scale1*cf_row1[i2]; \
+	  const FLOAT_TYPE B2 = 0.5*force_prefac*cf_scale2*cf_row2[i2]; \
 	  field_x -= fmesh_x[l_ind1]*B1 + fmesh_x[l_ind2+1]*B2; \
 	  field_y -= fmesh_y[l_ind1]*B1 + fmesh_y[l_ind2+1]*B2; \
 	  field_z -= fmesh_z[l_ind1]*B1 + fmesh_z[l_ind2+1]*B2; \
@@ -687,37 +1001,11 @@ void assign_forces(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t
   } \
 } \
 
-assign_forces_interlacing_template(1)
-assign_forces_interlacing_template(2)
-assign_forces_interlacing_template(3)
-assign_forces_interlacing_template(4)
-assign_forces_interlacing_template(5)
-assign_forces_interlacing_template(6)
-assign_forces_interlacing_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_interlacing, )
 
 void assign_forces_interlacing(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
   switch(p->cao) {
-  case 1:
-    assign_forces_interlacing_1(prefactor, s, p, d, f);
-    break;
-  case 2:
-    assign_forces_interlacing_2(prefactor, s, p, d, f);
-    break;
-  case 3:
-    assign_forces_interlacing_3(prefactor, s, p, d, f);
-    break;
-  case 4:
-    assign_forces_interlacing_4(prefactor, s, p, d, f);
-    break;
-  case 5:
-    assign_forces_interlacing_5(prefactor, s, p, d, f);
-    break;
-  case 6:
-    assign_forces_interlacing_6(prefactor, s, p, d, f);
-    break;
-  case 7:
-    assign_forces_interlacing_7(prefactor, s, p, d, f);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_interlacing, (prefactor, s, p, d, f))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -727,38 +1015,52 @@ void assign_forces_interlacing(FLOAT_TYPE prefactor, system_t *s, parameters_t *
 #define assign_forces_interlacing_ad_template(cao) void assign_forces_interlacing_ad_##cao(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f) { \
   int i,i0,i1,i2; \
   int cf_cnt; \
-  int *base1, *base2; \
-  int j1,k1,l1,j2,k2,l2; \
-  FLOAT_TYPE B1, B2; \
+  const int * restrict base1, * restrict base2; \
+  int j1,k1,j2,k2; \
   FLOAT_TYPE field_x, field_y, field_z; \
-  int mesh = d->mesh; \
- \
-  FLOAT_TYPE *dQ0 = d->dQ[0]; \
- \
-  FLOAT_TYPE *dQ1 = d->dQ[1]; \
+  const int mesh = d->mesh; \
  \
-  cf_cnt = 0; \
+  const FLOAT_TYPE * restrict Qmesh = d->Qmesh; \
+  const FLOAT_TYPE * restrict dQ0 = d->dQ[0]; \
+  const FLOAT_TYPE * restrict dQ1 = d->dQ[1]; \
+  const int separable = d->cf_separable; \
  \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt,base1,base2,j1,k1,j2,k2,field_x,field_y,field_z)) \
   for (i=0; i<s->nparticles; i++) { \
     field_x = field_y = field_z = 0; \
     base1 = d->ca_ind[0] + 3*i; \
     base2 = d->ca_ind[1] + 3*i; \
-    cf_cnt = 3*i*cao*cao*cao; \
     for (i0=0; i0<cao; i0++) { \
       j1 = wrap_mesh_index(base1[0] + i0, mesh); \
       j2 = wrap_mesh_index(base2[0] + i0, mesh); \
       for (i1=0; i1<cao; i1++) { \
 	k1 = wrap_mesh_index(base1[1] + i1, mesh); \
 	k2 = wrap_mesh_index(base2[1] + i1, mesh); \
+	if(separable) { \
+	  const FLOAT_TYPE * restrict w1 = d->cf[0] + 3*cao*i, * restrict wd1 = dQ0 + 3*cao*i; \
+	  const FLOAT_TYPE * restrict w2 = d->cf[1] + 3*cao*i, * restrict wd2 = dQ1 + 3*cao*i; \
+	  const FLOAT_TYPE qLeni = s->q[i] / s->length; \
+	  const FLOAT_TYPE sx1 = qLeni*wd1[i0]*w1[cao + i1], sx2 = qLeni*wd2[i0]*w2[cao + i1]; \
+	  const FLOAT_TYPE sy1 = qLeni*w1[i0]*wd1[cao + i1], sy2 = qLeni*w2[i0]*wd2[cao + i1]; \
+	  const FLOAT_TYPE sz1 = qLeni*w1[i0]*w1[cao + i1], sz2 = qLeni*w2[i0]*w2[cao + i1]; \
+	  CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
+	  for (i2=0; i2<cao; i2++) { \
+	    const FLOAT_TYPE B1 = Qmesh[c_ind(j1,k1,wrap_mesh_index(base1[2] + i2, mesh))+0]; \
+	    const FLOAT_TYPE B2 = Qmesh[c_ind(j2,k2,wrap_mesh_index(base2[2] + i2, mesh))+1]; \
+	    field_x -= 0.5*force_prefac*(B1*sx1*w1[2*cao + i2] + B2*sx2*w2[2*cao + i2]); \
+	    field_y -= 0.5*force_prefac*(B1*sy1*w1[2*cao + i2] + B2*sy2*w2[2*cao + i2]); \
+	    field_z -= 0.5*force_prefac*(B1*sz1*wd1[2*cao + i2] + B2*sz2*wd2[2*cao + i2]); \
+	  } \
+	  continue; \
+	} \
+	cf_cnt = 3*(i*cao*cao*cao + cao*(cao*i0 + i1)); \
+	CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
 	for (i2=0; i2<cao; i2++) { \
-	  l1 = wrap_mesh_index(base1[2] + i2, mesh); \
-	  l2 = wrap_mesh_index(base2[2] + i2, mesh); \
-	  B1 = d->Qmesh[c_ind(j1,k1,l1)+0]; \
-	  B2 = d->Qmesh[c_ind(j2,k2,l2)+1]; \
-	  field_x -= 0.5*force_prefac*(B1*dQ0[cf_cnt+0] + B2*dQ1[cf_cnt+0]); \
-	  field_y -= 0.5*force_prefac*(B1*dQ0[cf_cnt+1] + B2*dQ1[cf_cnt+1]); \
-	  field_z -= 0.5*force_prefac*(B1*dQ0[cf_cnt+2] + B2*dQ1[cf_cnt+2]); \
-	  cf_cnt+=3; \
+	  const FLOAT_TYPE B1 = Qmesh[c_ind(j1,k1,wrap_mesh_index(base1[2] + i2, mesh))+0]; \
+	  const FLOAT_TYPE B2 = Qmesh[c_ind(j2,k2,wrap_mesh_index(base2[2] + i2, mesh))+1]; \
+	  field_x -= 0.5*force_prefac*(B1*dQ0[cf_cnt+3*i2+0] + B2*dQ1[cf_cnt+3*i2+0]); \
+	  field_y -= 0.5*force_prefac*(B1*dQ0[cf_cnt+3*i2+1] + B2*dQ1[cf_cnt+3*i2+1]); \
+	  field_z -= 0.5*force_prefac*(B1*dQ0[cf_cnt+3*i2+2] + B2*dQ1[cf_cnt+3*i2+2]); \
 	} \
       } \
     } \
@@ -768,37 +1070,11 @@ void assign_forces_interlacing(FLOAT_TYPE prefactor, system_t *s, parameters_t *
   } \
 } \
 
-assign_forces_interlacing_ad_template(1)
-assign_forces_interlacing_ad_template(2)
-assign_forces_interlacing_ad_template(3)
-assign_forces_interlacing_ad_template(4)
-assign_forces_interlacing_ad_template(5)
-assign_forces_interlacing_ad_template(6)
-assign_forces_interlacing_ad_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_interlacing_ad, )
 
 void assign_forces_interlacing_ad(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
   switch(p->cao) {
-  case 1:
-    assign_forces_interlacing_ad_1(prefactor, s, p, d, f);
-    break;
-  case 2:
-    assign_forces_interlacing_ad_2(prefactor, s, p, d, f);
-    break;
-  case 3:
-    assign_forces_interlacing_ad_3(prefactor, s, p, d, f);
-    break;
-  case 4:
-    assign_forces_interlacing_ad_4(prefactor, s, p, d, f);
-    break;
-  case 5:
-    assign_forces_interlacing_ad_5(prefactor, s, p, d, f);
-    break;
-  case 6:
-    assign_forces_interlacing_ad_6(prefactor, s, p, d, f);
-    break;
-  case 7:
-    assign_forces_interlacing_ad_7(prefactor, s, p, d, f);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_interlacing_ad, (prefactor, s, p, d, f))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -846,75 +1122,70 @@ void assign_forces_real_dynamic(FLOAT_TYPE force_prefac, system_t *s, parameters
 
 }
 
-#define assign_forces_real_template(cao) void assign_forces_real_##cao(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f) { \
+/* Gather from the r2c force meshes FMESH of type MESH_T. */
+#define assign_forces_real_template_t(cao, SUF, MESH_T, FMESH) void assign_forces_real##SUF##_##cao(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f) { \
   int i,i0,i1,i2; \
-  FLOAT_TYPE * restrict cf_cnt; \
-  int * restrict base; \
-  int j,k,l; \
-  FLOAT_TYPE B; \
+  const FLOAT_TYPE * restrict cf_cnt, * restrict cf_row; \
+  FLOAT_TYPE cf_scale; \
+  const int separable = d->cf_separable; \
+  const int * restrict base; \
+  int j,k; \
   FLOAT_TYPE field_x, field_y, field_z; \
   int l_ind; \
-  FLOAT_TYPE * restrict fmesh_x = d->Fmesh->fields[0], * restrict fmesh_y = d->Fmesh->fields[1], * restrict fmesh_z = d->Fmesh->fields[2]; \
-  int mesh = d->mesh; \
- \
-  cf_cnt = d->cf[0]; \
+  const MESH_T * restrict fmesh_x = FMESH[0], * restrict fmesh_y = FMESH[1], * restrict fmesh_z = FMESH[2]; \
+  const int mesh = d->mesh; \
  \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt,cf_row,cf_scale,base,j,k,l_ind,field_x,field_y,field_z)) \
   for (i=0; i<s->nparticles; i++) { \
     field_x = field_y = field_z = 0; \
     base = d->ca_ind[0] + 3*i; \
+    cf_cnt = d->cf[0] + (separable ? 3*cao : cao*cao*cao)*i; \
     for (i0=0; i0<cao; i0++) { \
       j = wrap_mesh_index(base[0] + i0, mesh); \
       for (i1=0; i1<cao; i1++) { \
 	k = wrap_mesh_index(base[1] + i1, mesh); \
+	l_ind = mesh*(mesh+2) * j + (mesh+2) * k; \
+	if(separable) { \
+	  cf_row = cf_cnt + 2*cao; \
+	  cf_scale = s->q[i]*cf_cnt[i0]*cf_cnt[cao + i1]; \
+	} else { \
+	  cf_row = cf_cnt + cao*(cao*i0 + i1); \
+	  cf_scale = 1.0; \
+	} \
+	CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
 	for (i2=0; i2<cao; i2++) { \
-	  l = wrap_mesh_index(base[2] + i2, mesh); \
-	  B = force_prefac*(*cf_cnt++); \
-	  l_ind = mesh*(mesh+2) * j + (mesh+2) * k + l; \
-	  field_x -= fmesh_x[l_ind]*B; \
-	  field_y -= fmesh_y[l_ind]*B; \
-	  field_z -= fmesh_z[l_ind]*B; \
+	  const int l = l_ind + wrap_mesh_index(base[2] + i2, mesh); \
+	  const FLOAT_TYPE B = force_prefac*cf_scale*cf_row[i2]; \
+	  field_x -= fmesh_x[l]*B; \
+	  field_y -= fmesh_y[l]*B; \
+	  field_z -= fmesh_z[l]*B; \
 	} \
       } \
     } \
     f->f_k->fields[0][i] += field_x; \
     f->f_k->fields[1][i] += field_y; \
     f->f_k->fields[2][i] += field_z; \
- \
   } \
- \
 } \
 
-assign_forces_real_template(1)
-assign_forces_real_template(2)
-assign_forces_real_template(3)
-assign_forces_real_template(4)
-assign_forces_real_template(5)
-assign_forces_real_template(6)
-assign_forces_real_template(7)
+#define assign_forces_real_template(cao) assign_forces_real_template_t(cao, , FLOAT_TYPE, d->Fmesh->fields)
+#define assign_forces_real_float_template(cao) assign_forces_real_template_t(cao, _float, float, d->Fmesh_f)
+
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_real, )
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_real_float, )
 
 void assign_forces_real(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
   switch(p->cao) {
-  case 1:
-    assign_forces_real_1(prefactor, s, p, d, f);
-    break;
-  case 2:
-    assign_forces_real_2(prefactor, s, p, d, f);
-    break;
-  case 3:
-    assign_forces_real_3(prefactor, s, p, d, f);
-    break;
-  case 4:
-    assign_forces_real_4(prefactor, s, p, d, f);
-    break;
-  case 5:
-    assign_forces_real_5(prefactor, s, p, d, f);
-    break;
-  case 6:
-    assign_forces_real_6(prefactor, s, p, d, f);
-    break;
-  case 7:
-    assign_forces_real_7(prefactor, s, p, d, f);
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_real, (prefactor, s, p, d, f))
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
+  }
+}
+
+void assign_forces_real_float(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
+  switch(p->cao) {
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_real_float, (prefactor, s, p, d, f))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -979,13 +1250,15 @@ void assign_forces_real_nostor_dynamic(FLOAT_TYPE force_prefac, system_t *s, par
   int i,i0,i1,i2; \
   FLOAT_TYPE pos; \
   int base[3]; \
-  int arg[3]; \
+  /* assignment weights of the particle */ \
+  const FLOAT_TYPE *caf[3]; \
+  FLOAT_TYPE w[3][cao]; \
+  const int direct = d->inter->direct; \
   int nmp, dim; \
-  int j,k,l; \
-  FLOAT_TYPE B; \
+  int j,k; \
   FLOAT_TYPE field_x, field_y, field_z; \
   int l_ind; \
-  FLOAT_TYPE * restrict fmesh_x = d->Fmesh->fields[0], * restrict fmesh_y = d->Fmesh->fields[1], * restrict fmesh_z = d->Fmesh->fields[2]; \
+  const FLOAT_TYPE * restrict fmesh_x = d->Fmesh->fields[0], * restrict fmesh_y = d->Fmesh->fields[1], * restrict fmesh_z = d->Fmesh->fields[2]; \
   const int mesh = d->mesh; \
   FLOAT_TYPE MI2 = 2.0*(FLOAT_TYPE)MaxInterpol; \
   FLOAT_TYPE Hi = (double)d->mesh/(double)s->length; \
@@ -994,88 +1267,73 @@ void assign_forces_real_nostor_dynamic(FLOAT_TYPE force_prefac, system_t *s, par
   const FLOAT_TYPE pos_shift = (FLOAT_TYPE)((cao-1)/2); \
   FLOAT_TYPE q; \
  \
+  CA_OMP(omp parallel for private(i0,i1,i2,pos,base,caf,w,nmp,dim,j,k,l_ind,field_x,field_y,field_z,tmp0,tmp1,q)) \
   for (i=0; i<s->nparticles; i++) { \
     field_x = field_y = field_z = 0; \
     for (dim=0;dim<3;dim++) { \
       pos    = s->p->fields[dim][i]*Hi - pos_shift; \
       nmp = int_floor(pos + 0.5); \
       base[dim]  = wrap_mesh_index( nmp, d->mesh); \
-      arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+      if(direct) { \
+        caf_bspline_weights(cao, pos - nmp, w[dim]); \
+        caf[dim] = w[dim]; \
+      } else { \
+        caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+      } \
     } \
     q = s->q[i]; \
     for (i0=0; i0<cao; i0++) { \
       j = wrap_mesh_index(base[0] + i0, mesh); \
-      tmp0 = q * interpol[arg[0]][i0]; \
+      tmp0 = q * caf[0][i0]; \
       for (i1=0; i1<cao; i1++) { \
-	tmp1 = tmp0 * interpol[arg[1]][i1]; \
+	const FLOAT_TYPE * restrict ip_z = caf[2]; \
+	tmp1 = tmp0 * caf[1][i1]; \
 	k = wrap_mesh_index(base[1] + i1, mesh); \
+	l_ind = mesh*(mesh+2) * j + (mesh+2) * k; \
+	CA_OMP(omp simd reduction(+:field_x,field_y,field_z)) \
 	for (i2=0; i2<cao; i2++) { \
-	  l = wrap_mesh_index(base[2] + i2, mesh); \
-	  B = force_prefac* tmp1 * interpol[arg[2]][i2]; \
-	  l_ind = mesh*(mesh+2) * j + (mesh+2) * k + l; \
-	  field_x -= fmesh_x[l_ind]*B; \
-	  field_y -= fmesh_y[l_ind]*B; \
-	  field_z -= fmesh_z[l_ind]*B; \
+	  const int l = l_ind + wrap_mesh_index(base[2] + i2, mesh); \
+	  const FLOAT_TYPE B = force_prefac* tmp1 * ip_z[i2]; \
+	  field_x -= fmesh_x[l]*B; \
+	  field_y -= fmesh_y[l]*B; \
+	  field_z -= fmesh_z[l]*B; \
 	} \
       } \
     } \
     f->f_k->fields[0][i] += field_x; \
     f->f_k->fields[1][i] += field_y; \
     f->f_k->fields[2][i] += field_z; \
- \
   } \
- \
 } \
 
-assign_forces_real_nostor_template(1)
-assign_forces_real_nostor_template(2)
-assign_forces_real_nostor_template(3)
-assign_forces_real_nostor_template(4)
-assign_forces_real_nostor_template(5)
-assign_forces_real_nostor_template(6)
-assign_forces_real_nostor_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_real_nostor, )
 
 void assign_forces_real_nostor(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
   switch(p->cao) {
-  case 1:
-    assign_forces_real_nostor_1(prefactor, s, p, d, f);
-    break;
-  case 2:
-    assign_forces_real_nostor_2(prefactor, s, p, d, f);
-    break;
-  case 3:
-    assign_forces_real_nostor_3(prefactor, s, p, d, f);
-    break;
-  case 4:
-    assign_forces_real_nostor_4(prefactor, s, p, d, f);
-    break;
-  case 5:
-    assign_forces_real_nostor_5(prefactor, s, p, d, f);
-    break;
-  case 6:
-    assign_forces_real_nostor_6(prefactor, s, p, d, f);
-    break;
-  case 7:
-    assign_forces_real_nostor_7(prefactor, s, p, d, f);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_real_nostor, (prefactor, s, p, d, f))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
   }
 }
 
-#define assign_charge_and_derivatives_template(cao) void assign_charge_and_derivatives_##cao(system_t *s, parameters_t *p, data_t *d, int ii) \
+#define assign_charge_and_derivatives_template(cao) static void assign_charge_and_derivatives_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
 { \
     int dim, i0, i1, i2; \
-    int id; \
+    int id, n; \
     FLOAT_TYPE tmp0, tmp1, tmp2; \
     FLOAT_TYPE tmp0_x, tmp1_y, tmp2_z; \
     /* position of a particle in local mesh units */ \
     FLOAT_TYPE pos; \
     /* 1d-index of nearest mesh point */ \
     int nmp; \
-    /* index for caf interpolation grid */ \
-    int arg[3]; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const FLOAT_TYPE *caf_d[3]; \
+    FLOAT_TYPE w_d[3][cao]; \
+    const int direct = d->inter->direct; \
+    const int separable = d->cf_separable; \
     /* index, index jumps for rs_mesh array */ \
     int cf_cnt; \
  \
@@ -1092,10 +1350,14 @@ void assign_forces_real_nostor(FLOAT_TYPE prefactor, system_t *s, parameters_t *
  \
     FLOAT_TYPE * restrict Qmesh = d->Qmesh; \
     FLOAT_TYPE * restrict dQ = d->dQ[ii]; \
+    FLOAT_TYPE * restrict cf = d->cf[ii]; \
+    FLOAT_TYPE ** restrict interpol = d->inter->interpol; \
+    FLOAT_TYPE ** restrict interpol_d = d->inter->interpol_d; \
  \
     pos_shift = (double)((cao-1)/2); \
     /* particle position in mesh coordinates */ \
-    for (id=0;id<s->nparticles;id++) { \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
         cf_cnt = 3*id*cao*cao*cao; \
 	q = s->q[id] ; \
 	qLeni = q * Leni; \
@@ -1103,26 +1365,44 @@ void assign_forces_real_nostor(FLOAT_TYPE prefactor, system_t *s, parameters_t *
 	  pos    = s->p->fields[dim][id]*Hi - pos_shift + 0.5*ii; \
 	  nmp = int_floor(pos + 0.5); \
 	  base[dim]  = wrap_mesh_index( nmp, d->mesh); \
-	  arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+	  if(direct) { \
+	    caf_bspline_weights(cao, pos - nmp, w[dim]); \
+	    caf_bspline_d_weights(cao, pos - nmp, w_d[dim]); \
+	    caf_d[dim] = w_d[dim]; \
+	    caf[dim] = w[dim]; \
+	  } else { \
+	    caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+	    caf_d[dim] = interpol_d[int_floor((pos - nmp + 0.5)*MI2)]; \
+	  } \
 	  d->ca_ind[ii][3*id + dim] = base[dim]; \
         } \
+ \
+        if(separable) { \
+          for (dim=0;dim<3;dim++) \
+            for (i0=0; i0<cao; i0++) { \
+              cf[3*cao*id + cao*dim + i0] = caf[dim][i0]; \
+              dQ[3*cao*id + cao*dim + i0] = caf_d[dim][i0]; \
+            } \
+        } \
  \
         for (i0=0; i0<cao; i0++) { \
 	  i = wrap_mesh_index(base[0] + i0, d->mesh); \
-	  tmp0 = d->inter->interpol[arg[0]][i0]; \
-	  tmp0_x = d->inter->interpol_d[arg[0]][i0]; \
+	  tmp0 = caf[0][i0]; \
+	  tmp0_x = caf_d[0][i0]; \
 	  for (i1=0; i1<cao; i1++) { \
 	    j = wrap_mesh_index(base[1] + i1, d->mesh); \
-	    tmp1 = d->inter->interpol[arg[1]][i1]; \
-	    tmp1_y = d->inter->interpol_d[arg[1]][i1]; \
+	    tmp1 = caf[1][i1]; \
+	    tmp1_y = caf_d[1][i1]; \
 	    for (i2=0; i2<cao; i2++) { \
 	      k = wrap_mesh_index(base[2] + i2, d->mesh); \
-	      tmp2 = d->inter->interpol[arg[2]][i2]; \
-	      tmp2_z = d->inter->interpol_d[arg[2]][i2]; \
+	      tmp2 = caf[2][i2]; \
+	      tmp2_z = caf_d[2][i2]; \
  \
-	      dQ[cf_cnt+0] = tmp0_x * tmp1 * tmp2 * qLeni; \
-	      dQ[cf_cnt+1] = tmp0 * tmp1_y * tmp2 * qLeni; \
-	      dQ[cf_cnt+2] = tmp0 * tmp1 * tmp2_z * qLeni; \
+	      if(!separable) { \
+		dQ[cf_cnt+0] = tmp0_x * tmp1 * tmp2 * qLeni; \
+		dQ[cf_cnt+1] = tmp0 * tmp1_y * tmp2 * qLeni; \
+		dQ[cf_cnt+2] = tmp0 * tmp1 * tmp2_z * qLeni; \
+	      } \
  \
 	      Qmesh[c_ind(i,j,k)+ii] += q * tmp0 * tmp1 * tmp2; \
 	      cf_cnt+=3; \
@@ -1131,38 +1411,17 @@ void assign_forces_real_nostor(FLOAT_TYPE prefactor, system_t *s, parameters_t *
         } \
     } \
 } \
+ \
+void assign_charge_and_derivatives_##cao(system_t *s, parameters_t *p, data_t *d, int ii) \
+{ \
+  assign_charge_colored(s, p, d, ii, assign_charge_and_derivatives_range_##cao); \
+}
 
-assign_charge_and_derivatives_template(1)
-assign_charge_and_derivatives_template(2)
-assign_charge_and_derivatives_template(3)
-assign_charge_and_derivatives_template(4)
-assign_charge_and_derivatives_template(5)
-assign_charge_and_derivatives_template(6)
-assign_charge_and_derivatives_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_and_derivatives, )
 
 void assign_charge_and_derivatives(system_t *s, parameters_t *p, data_t *d, int ii) {
   switch(p->cao) {
-  case 1:
-    assign_charge_and_derivatives_1(s, p, d, ii);
-    break;
-  case 2:
-    assign_charge_and_derivatives_2(s, p, d, ii);
-    break;
-  case 3:
-    assign_charge_and_derivatives_3(s, p, d, ii);
-    break;
-  case 4:
-    assign_charge_and_derivatives_4(s, p, d, ii);
-    break;
-  case 5:
-    assign_charge_and_derivatives_5(s, p, d, ii);
-    break;
-  case 6:
-    assign_charge_and_derivatives_6(s, p, d, ii);
-    break;
-  case 7:
-    assign_charge_and_derivatives_7(s, p, d, ii);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_and_derivatives, (s, p, d, ii))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -1240,18 +1499,23 @@ void assign_charge_and_derivatives_real_dynamic(system_t *s, parameters_t *p, da
     }
 }
 
-#define assign_charge_and_derivatives_real_template(cao) void assign_charge_and_derivatives_real_##cao(system_t *s, parameters_t *p, data_t *d) \
+#define assign_charge_and_derivatives_real_template(cao) static void assign_charge_and_derivatives_real_range_##cao(system_t *s, parameters_t *p, data_t *d, int ii, const int *ids, int np) \
 { \
     int dim, i0, i1, i2; \
-    int id; \
+    int id, n; \
     FLOAT_TYPE tmp0, tmp1, tmp2; \
     FLOAT_TYPE tmp0_x, tmp1_y, tmp2_z; \
     /* position of a particle in local mesh units */ \
     FLOAT_TYPE pos; \
     /* 1d-index of nearest mesh point */ \
     int nmp; \
-    /* index for caf interpolation grid */ \
-    int arg[3]; \
+    /* assignment weights of the particle */ \
+    const FLOAT_TYPE *caf[3]; \
+    FLOAT_TYPE w[3][cao]; \
+    const FLOAT_TYPE *caf_d[3]; \
+    FLOAT_TYPE w_d[3][cao]; \
+    const int direct = d->inter->direct; \
+    const int separable = d->cf_separable; \
     /* index, index jumps for rs_mesh array */ \
     int cf_cnt; \
  \
@@ -1266,6 +1530,7 @@ void assign_charge_and_derivatives_real_dynamic(system_t *s, parameters_t *p, da
  \
     FLOAT_TYPE * restrict Qmesh = d->Qmesh; \
     FLOAT_TYPE * restrict dQ = d->dQ[0]; \
+    FLOAT_TYPE * restrict cf = d->cf[0]; \
     FLOAT_TYPE ** restrict interpol = d->inter->interpol; \
     FLOAT_TYPE ** restrict interpol_d = d->inter->interpol_d; \
  \
@@ -1273,7 +1538,8 @@ void assign_charge_and_derivatives_real_dynamic(system_t *s, parameters_t *p, da
  \
     pos_shift = (double)((cao-1)/2); \
     /* particle position in mesh coordinates */ \
-    for (id=0;id<s->nparticles;id++) { \
+    for (n=0;n<np;n++) { \
+        id = ids ? ids[n] : n; \
         cf_cnt = 3*id*cao*cao*cao; \
 	q = s->q[id] ; \
 	qLeni = q * Leni; \
@@ -1281,26 +1547,44 @@ void assign_charge_and_derivatives_real_dynamic(system_t *s, parameters_t *p, da
 	  pos    = s->p->fields[dim][id]*Hi - pos_shift; \
 	  nmp = int_floor(pos + 0.5); \
 	  base[dim]  = wrap_mesh_index( nmp, Mesh); \
-	  arg[dim] = int_floor((pos - nmp + 0.5)*MI2); \
+	  if(direct) { \
+	    caf_bspline_weights(cao, pos - nmp, w[dim]); \
+	    caf_bspline_d_weights(cao, pos - nmp, w_d[dim]); \
+	    caf_d[dim] = w_d[dim]; \
+	    caf[dim] = w[dim]; \
+	  } else { \
+	    caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)]; \
+	    caf_d[dim] = interpol_d[int_floor((pos - nmp + 0.5)*MI2)]; \
+	  } \
 	  d->ca_ind[0][3*id + dim] = base[dim]; \
         } \
+ \
+        if(separable) { \
+          for (dim=0;dim<3;dim++) \
+            for (i0=0; i0<cao; i0++) { \
+              cf[3*cao*id + cao*dim + i0] = caf[dim][i0]; \
+              dQ[3*cao*id + cao*dim + i0] = caf_d[dim][i0]; \
+            } \
+        } \
  \
         for (i0=0; i0<cao; i0++) { \
 	  i = wrap_mesh_index(base[0] + i0, Mesh); \
-	  tmp0 = interpol[arg[0]][i0]; \
-	  tmp0_x = interpol_d[arg[0]][i0]; \
+	  tmp0 = caf[0][i0]; \
+	  tmp0_x = caf_d[0][i0]; \
 	  for (i1=0; i1<cao; i1++) { \
 	    j = wrap_mesh_index(base[1] + i1, Mesh); \
-	    tmp1 = interpol[arg[1]][i1]; \
-	    tmp1_y = interpol_d[arg[1]][i1]; \
+	    tmp1 = caf[1][i1]; \
+	    tmp1_y = caf_d[1][i1]; \
 	    for (i2=0; i2<cao; i2++) { \
 	      k = wrap_mesh_index(base[2] + i2, Mesh); \
-	      tmp2 = interpol[arg[2]][i2]; \
-	      tmp2_z = interpol_d[arg[2]][i2]; \
+	      tmp2 = caf[2][i2]; \
+	      tmp2_z = caf_d[2][i2]; \
  \
-	      dQ[cf_cnt+0] = tmp0_x * tmp1 * tmp2 * qLeni; \
-	      dQ[cf_cnt+1] = tmp0 * tmp1_y * tmp2 * qLeni; \
-	      dQ[cf_cnt+2] = tmp0 * tmp1 * tmp2_z * qLeni; \
+	      if(!separable) { \
+		dQ[cf_cnt+0] = tmp0_x * tmp1 * tmp2 * qLeni; \
+		dQ[cf_cnt+1] = tmp0 * tmp1_y * tmp2 * qLeni; \
+		dQ[cf_cnt+2] = tmp0 * tmp1 * tmp2_z * qLeni; \
+	      } \
  \
 	      Qmesh[Mesh*(Mesh+2) * i + (Mesh+2) * j + k] += q * tmp0 * tmp1 * tmp2; \
 	      cf_cnt+=3; \
@@ -1309,38 +1593,17 @@ void assign_charge_and_derivatives_real_dynamic(system_t *s, parameters_t *p, da
         } \
     } \
 } \
+ \
+void assign_charge_and_derivatives_real_##cao(system_t *s, parameters_t *p, data_t *d) \
+{ \
+  assign_charge_colored(s, p, d, 0, assign_charge_and_derivatives_real_range_##cao); \
+}
 
-assign_charge_and_derivatives_real_template(1)
-assign_charge_and_derivatives_real_template(2)
-assign_charge_and_derivatives_real_template(3)
-assign_charge_and_derivatives_real_template(4)
-assign_charge_and_derivatives_real_template(5)
-assign_charge_and_derivatives_real_template(6)
-assign_charge_and_derivatives_real_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_charge_and_derivatives_real, )
 
 void assign_charge_and_derivatives_real(system_t *s, parameters_t *p, data_t *d) {
   switch(p->cao) {
-  case 1:
-    assign_charge_and_derivatives_real_1(s, p, d);
-    break;
-  case 2:
-    assign_charge_and_derivatives_real_2(s, p, d);
-    break;
-  case 3:
-    assign_charge_and_derivatives_real_3(s, p, d);
-    break;
-  case 4:
-    assign_charge_and_derivatives_real_4(s, p, d);
-    break;
-  case 5:
-    assign_charge_and_derivatives_real_5(s, p, d);
-    break;
-  case 6:
-    assign_charge_and_derivatives_real_6(s, p, d);
-    break;
-  case 7:
-    assign_charge_and_derivatives_real_7(s, p, d);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_charge_and_derivatives_real, (s, p, d))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -1352,75 +1615,62 @@ void assign_charge_and_derivatives_real(system_t *s, parameters_t *p, data_t *d)
 #define assign_forces_ad_template(cao) void assign_forces_ad_##cao(double force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f, int ii) \
 { \
   int i,i0,i1,i2; \
-  int cf_cnt=0; \
-  int *base; \
-  int j,k,l; \
-  FLOAT_TYPE B; \
+  int cf_cnt; \
+  const int * restrict base; \
+  int j,k; \
   FLOAT_TYPE force_x, force_y, force_z; \
   const int mesh = d->mesh; \
+  const FLOAT_TYPE * restrict Qmesh = d->Qmesh; \
+  const FLOAT_TYPE * restrict dQ = d->dQ[ii]; \
+  const int separable = d->cf_separable; \
+  /* Interlaced forces are averaged over both meshes */ \
+  const FLOAT_TYPE scale = (ii == 1) ? 0.5 : 1.0; \
  \
-  cf_cnt=0; \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt,base,j,k,force_x,force_y,force_z)) \
   for (i=0; i<s->nparticles; i++) { \
     force_x = force_y = force_z = 0.0; \
     base = d->ca_ind[ii] + 3*i; \
-    cf_cnt = 3*i*cao*cao*cao; \
     for (i0=0; i0<cao; i0++) { \
       j = wrap_mesh_index(base[0] + i0, mesh); \
       for (i1=0; i1<cao; i1++) { \
 	k = wrap_mesh_index(base[1] + i1, mesh); \
+	if(separable) { \
+	  const FLOAT_TYPE * restrict w = d->cf[ii] + 3*cao*i; \
+	  const FLOAT_TYPE * restrict wd = dQ + 3*cao*i; \
+	  const FLOAT_TYPE qLeni = s->q[i] / s->length; \
+	  const FLOAT_TYPE sx = qLeni*wd[i0]*w[cao + i1]; \
+	  const FLOAT_TYPE sy = qLeni*w[i0]*wd[cao + i1]; \
+	  const FLOAT_TYPE sz = qLeni*w[i0]*w[cao + i1]; \
+	  CA_OMP(omp simd reduction(+:force_x,force_y,force_z)) \
+	  for (i2=0; i2<cao; i2++) { \
+	    const FLOAT_TYPE B = force_prefac*Qmesh[c_ind(j,k,wrap_mesh_index(base[2] + i2, mesh))+ii]; \
+	    force_x -= B*sx*w[2*cao + i2]; \
+	    force_y -= B*sy*w[2*cao + i2]; \
+	    force_z -= B*sz*wd[2*cao + i2]; \
+	  } \
+	  continue; \
+	} \
+	cf_cnt = 3*(i*cao*cao*cao + cao*(cao*i0 + i1)); \
+	CA_OMP(omp simd reduction(+:force_x,force_y,force_z)) \
 	for (i2=0; i2<cao; i2++) { \
-	  l = wrap_mesh_index(base[2] + i2, mesh); \
- \
-	  B = force_prefac*d->Qmesh[c_ind(j,k,l)+ii]; \
-	  force_x -= B*d->dQ[ii][cf_cnt+0]; \
-	  force_y -= B*d->dQ[ii][cf_cnt+1]; \
-	  force_z -= B*d->dQ[ii][cf_cnt+2]; \
-	  cf_cnt+=3; \
+	  const FLOAT_TYPE B = force_prefac*Qmesh[c_ind(j,k,wrap_mesh_index(base[2] + i2, mesh))+ii]; \
+	  force_x -= B*dQ[cf_cnt+3*i2+0]; \
+	  force_y -= B*dQ[cf_cnt+3*i2+1]; \
+	  force_z -= B*dQ[cf_cnt+3*i2+2]; \
 	} \
       } \
     } \
-    f->f_k->fields[0][i] += force_x; \
-    f->f_k->fields[1][i] += force_y; \
-    f->f_k->fields[2][i] += force_z; \
-    if (ii==1) { \
-      f->f_k->fields[0][i] *= 0.5; \
-      f->f_k->fields[1][i] *= 0.5; \
-      f->f_k->fields[2][i] *= 0.5; \
-    } \
+    f->f_k->fields[0][i] = scale*(f->f_k->fields[0][i] + force_x); \
+    f->f_k->fields[1][i] = scale*(f->f_k->fields[1][i] + force_y); \
+    f->f_k->fields[2][i] = scale*(f->f_k->fields[2][i] + force_z); \
   } \
 } \
 
-assign_forces_ad_template(1)
-assign_forces_ad_template(2)
-assign_forces_ad_template(3)
-assign_forces_ad_template(4)
-assign_forces_ad_template(5)
-assign_forces_ad_template(6)
-assign_forces_ad_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_ad, )
 
 void assign_forces_ad(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f, int ii) {
   switch(p->cao) {
-  case 1:
-    assign_forces_ad_1(prefactor, s, p, d, f, ii);
-    break;
-  case 2:
-    assign_forces_ad_2(prefactor, s, p, d, f, ii);
-    break;
-  case 3:
-    assign_forces_ad_3(prefactor, s, p, d, f, ii);
-    break;
-  case 4:
-    assign_forces_ad_4(prefactor, s, p, d, f, ii);
-    break;
-  case 5:
-    assign_forces_ad_5(prefactor, s, p, d, f, ii);
-    break;
-  case 6:
-    assign_forces_ad_6(prefactor, s, p, d, f, ii);
-    break;
-  case 7:
-    assign_forces_ad_7(prefactor, s, p, d, f, ii);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_ad, (prefactor, s, p, d, f, ii))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -1468,30 +1718,48 @@ void assign_forces_ad_real_dynamic(double force_prefac, system_t *s, parameters_
 #define assign_forces_ad_real_template(cao) void assign_forces_ad_real_##cao(double force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f) \
 { \
   int i,i0,i1,i2; \
-  int cf_cnt=0; \
-  int * restrict base; \
-  int j,k,l; \
-  FLOAT_TYPE B; \
+  int cf_cnt; \
+  const int * restrict base; \
+  int j,k; \
+  int l_ind; \
   FLOAT_TYPE force_x, force_y, force_z; \
   const int mesh = p->mesh; \
-  FLOAT_TYPE * restrict dQ = d->dQ[0]; \
+  const FLOAT_TYPE * restrict Qmesh = d->Qmesh; \
+  const FLOAT_TYPE * restrict dQ = d->dQ[0]; \
+  const int separable = d->cf_separable; \
  \
-  cf_cnt=0; \
+  CA_OMP(omp parallel for private(i0,i1,i2,cf_cnt,base,j,k,l_ind,force_x,force_y,force_z)) \
   for (i=0; i<s->nparticles; i++) { \
     force_x = force_y = force_z = 0.0; \
     base = d->ca_ind[0] + 3*i; \
-    cf_cnt = 3*i*cao * cao *cao; \
     for (i0=0; i0<cao; i0++) { \
       j = wrap_mesh_index(base[0] + i0, mesh); \
       for (i1=0; i1<cao; i1++) { \
 	k = wrap_mesh_index(base[1] + i1, mesh); \
+	l_ind = mesh*(mesh+2) * j + (mesh+2) * k; \
+	if(separable) { \
+	  const FLOAT_TYPE * restrict w = d->cf[0] + 3*cao*i; \
+	  const FLOAT_TYPE * restrict wd = dQ + 3*cao*i; \
+	  const FLOAT_TYPE qLeni = s->q[i] / s->length; \
+	  const FLOAT_TYPE sx = qLeni*wd[i0]*w[cao + i1]; \
+	  const FLOAT_TYPE sy = qLeni*w[i0]*wd[cao + i1]; \
+	  const FLOAT_TYPE sz = qLeni*w[i0]*w[cao + i1]; \
+	  CA_OMP(omp simd reduction(+:force_x,force_y,force_z)) \
+	  for (i2=0; i2<cao; i2++) { \
+	    const FLOAT_TYPE B = force_prefac*Qmesh[l_ind + wrap_mesh_index(base[2] + i2, mesh)]; \
+	    force_x -= B*sx*w[2*cao + i2]; \
+	    force_y -= B*sy*w[2*cao + i2]; \
+	    force_z -= B*sz*wd[2*cao + i2]; \
+	  } \
+	  continue; \
+	} \
+	cf_cnt = 3*(i*cao*cao*cao + cao*(cao*i0 + i1)); \
+	CA_OMP(omp simd reduction(+:force_x,force_y,force_z)) \
 	for (i2=0; i2<cao; i2++) { \
-	  l = wrap_mesh_index(base[2] + i2, mesh); \
-	  B = force_prefac*d->Qmesh[mesh*(mesh+2) * j + (mesh+2) * k + l]; \
-	  force_x -= B*dQ[cf_cnt+0]; \
-	  force_y -= B*dQ[cf_cnt+1]; \
-	  force_z -= B*dQ[cf_cnt+2]; \
-	  cf_cnt+=3; \
+	  const FLOAT_TYPE B = force_prefac*Qmesh[l_ind + wrap_mesh_index(base[2] + i2, mesh)]; \
+	  force_x -= B*dQ[cf_cnt+3*i2+0]; \
+	  force_y -= B*dQ[cf_cnt+3*i2+1]; \
+	  force_z -= B*dQ[cf_cnt+3*i2+2]; \
 	} \
       } \
     } \
@@ -1501,37 +1769,11 @@ void assign_forces_ad_real_dynamic(double force_prefac, system_t *s, parameters_
   } \
 } \
 
-assign_forces_ad_real_template(1)
-assign_forces_ad_real_template(2)
-assign_forces_ad_real_template(3)
-assign_forces_ad_real_template(4)
-assign_forces_ad_real_template(5)
-assign_forces_ad_real_template(6)
-assign_forces_ad_real_template(7)
+BSPLINE_FOR_EACH_CAO(CA_INSTANTIATE, assign_forces_ad_real, )
 
 void assign_forces_ad_real(FLOAT_TYPE prefactor, system_t *s, parameters_t *p, data_t *d, forces_t *f) {
   switch(p->cao) {
-  case 1:
-    assign_forces_ad_real_1(prefactor, s, p, d, f);
-    break;
-  case 2:
-    assign_forces_ad_real_2(prefactor, s, p, d, f);
-    break;
-  case 3:
-    assign_forces_ad_real_3(prefactor, s, p, d, f);
-    break;
-  case 4:
-    assign_forces_ad_real_4(prefactor, s, p, d, f);
-    break;
-  case 5:
-    assign_forces_ad_real_5(prefactor, s, p, d, f);
-    break;
-  case 6:
-    assign_forces_ad_real_6(prefactor, s, p, d, f);
-    break;
-  case 7:
-    assign_forces_ad_real_7(prefactor, s, p, d, f);
-    break;
+  BSPLINE_FOR_EACH_CAO(CA_DISPATCH, assign_forces_ad_real, (prefactor, s, p, d, f))
   default:
     fprintf(stderr, "Charge assinment order %d not known.", p->cao);
     break;
@@ -1708,3 +1950,151 @@ void collect_rms_nocf(system_t *s, parameters_t *p, FLOAT_TYPE *Qmesh, FLOAT_TYP
     } 
   }
 }
+
+/* Incremental charge assignment on the non-interlaced complex mesh.
+   d->Qmesh_inc keeps the real space mesh of the last call, d->pos_inc and
+   d->q_inc the positions and charges the particles were assigned with.
+   Only particles that moved by more than P3M_INC_THRESHOLD mesh spacings
+   in some direction or whose charge changed are removed with their old
+   and assigned with their new values, the others keep their stencil and
+   cache entries. The state is per array slot, so a slot that holds a
+   different particle than in the last call (e.g. after reordering) is
+   updated like a moved particle. */
+
+/* Fraction of moved particles above which the mesh is rebuilt. */
+#define INC_MAX_MOVED_FRACTION 0.25
+/* Number of incremental updates between full rebuilds, bounds the
+   round-off drift of the mesh. */
+#define INC_FULL_INTERVAL 100
+
+#define CA_RANGE(cao, NAME, UNUSED) case cao: return NAME##_range_##cao;
+
+static assign_charge_range_t assign_charge_range(int cao) {
+  switch(cao) {
+  BSPLINE_FOR_EACH_CAO(CA_RANGE, assign_charge, )
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", cao);
+    return NULL;
+  }
+}
+
+static assign_charge_range_t assign_charge_and_derivatives_range(int cao) {
+  switch(cao) {
+  BSPLINE_FOR_EACH_CAO(CA_RANGE, assign_charge_and_derivatives, )
+  default:
+    fprintf(stderr, "Charge assinment order %d not known.", cao);
+    return NULL;
+  }
+}
+
+/* Subtracts the stencils of the particles ids with their stored positions
+   and charges, same arithmetic as in the assignment. */
+static void remove_charge_inc(system_t *s, parameters_t *p, data_t *d, const int *ids, int np) {
+  int n, id, dim, i0, i1, i2, i, j, k, nmp;
+  int base[3];
+  FLOAT_TYPE pos, q, tmp0, tmp1;
+  const FLOAT_TYPE *caf[3];
+  FLOAT_TYPE w[3][BSPLINE_MAX_CAO];
+  const int cao = p->cao;
+  const int *grid = d->grid;
+  const int direct = d->inter->direct;
+  FLOAT_TYPE ** restrict interpol = d->inter->interpol;
+  FLOAT_TYPE * restrict Qmesh = d->Qmesh_inc;
+  const FLOAT_TYPE MI2 = 2.0*(FLOAT_TYPE)MaxInterpol;
+  FLOAT_TYPE Hi[3];
+  const FLOAT_TYPE pos_shift = (FLOAT_TYPE)((cao-1)/2);
+
+  mesh_inverse_spacing(s, d, Hi);
+
+  for (n=0;n<np;n++) {
+    id = ids[n];
+    for (dim=0;dim<3;dim++) {
+      pos = d->pos_inc[3*id + dim]*Hi[dim] - pos_shift;
+      nmp = int_floor(pos + 0.5);
+      base[dim] = wrap_mesh_index( nmp, grid[dim]);
+      if(direct) {
+	caf_bspline_weights(cao, pos - nmp, w[dim]);
+	caf[dim] = w[dim];
+      } else {
+	caf[dim] = interpol[int_floor((pos - nmp + 0.5)*MI2)];
+      }
+    }
+    q = d->q_inc[id];
+    for (i0=0; i0<cao; i0++) {
+      i = wrap_mesh_index(base[0] + i0, grid[0]);
+      tmp0 = q * caf[0][i0];
+      for (i1=0; i1<cao; i1++) {
+	tmp1 = tmp0 * caf[1][i1];
+	j = wrap_mesh_index(base[1] + i1, grid[1]);
+	for (i2=0; i2<cao; i2++) {
+	  k = wrap_mesh_index(base[2] + i2, grid[2]);
+	  Qmesh[c_ind(i,j,k)] -= tmp1 * caf[2][i2];
+	}
+      }
+    }
+  }
+}
+
+static void assign_charge_inc(system_t *s, parameters_t *p, data_t *d, assign_charge_range_t range,
+			      void (*full)(system_t *, parameters_t *, data_t *, int)) {
+  const size_t mesh_size = 2*Mesh_size(d)*sizeof(FLOAT_TYPE);
+  const int max_moved = INC_MAX_MOVED_FRACTION*s->nparticles;
+  int id, dim, n, n_moved = 0;
+  FLOAT_TYPE thr[3];
+  FLOAT_TYPE *Qmesh;
+
+  for (dim=0;dim<3;dim++)
+    thr[dim] = P3M_INC_THRESHOLD*s->box_l[dim]/d->grid[dim];
+
+  if(d->inc_valid && (d->inc_steps < INC_FULL_INTERVAL) && (range != NULL)) {
+    for (id=0;id<s->nparticles;id++) {
+      for (dim=0;dim<3;dim++)
+	if(FLOAT_ABS(s->p->fields[dim][id] - d->pos_inc[3*id + dim]) > thr[dim])
+	  break;
+      if((dim < 3) || (s->q[id] != d->q_inc[id])) {
+	d->inc_ids[n_moved++] = id;
+	if(n_moved > max_moved)
+	  break;
+      }
+    }
+  }
+
+  if(!d->inc_valid || (d->inc_steps >= INC_FULL_INTERVAL) || (range == NULL) || (n_moved > max_moved)) {
+    memset(d->Qmesh, 0, mesh_size);
+    full(s, p, d, 0);
+    memcpy(d->Qmesh_inc, d->Qmesh, mesh_size);
+    for (id=0;id<s->nparticles;id++) {
+      for (dim=0;dim<3;dim++)
+	d->pos_inc[3*id + dim] = s->p->fields[dim][id];
+      d->q_inc[id] = s->q[id];
+    }
+    d->inc_valid = 1;
+    d->inc_steps = 0;
+    return;
+  }
+
+  remove_charge_inc(s, p, d, d->inc_ids, n_moved);
+
+  /* The range functions assign to d->Qmesh */
+  Qmesh = d->Qmesh;
+  d->Qmesh = d->Qmesh_inc;
+  range(s, p, d, 0, d->inc_ids, n_moved);
+  d->Qmesh = Qmesh;
+
+  for (n=0;n<n_moved;n++) {
+    for (dim=0;dim<3;dim++)
+      d->pos_inc[3*d->inc_ids[n] + dim] = s->p->fields[dim][d->inc_ids[n]];
+    d->q_inc[d->inc_ids[n]] = s->q[d->inc_ids[n]];
+  }
+
+  memcpy(d->Qmesh, d->Qmesh_inc, mesh_size);
+  d->inc_steps++;
+}
+
+void assign_charge_incremental(system_t *s, parameters_t *p, data_t *d) {
+  assign_charge_inc(s, p, d, assign_charge_range(p->cao), assign_charge);
+}
+
+void assign_charge_and_derivatives_incremental(system_t *s, parameters_t *p, data_t *d) {
+  assign_charge_inc(s, p, d, assign_charge_and_derivatives_range(p->cao), assign_charge_and_derivatives);
+}
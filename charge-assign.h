@@ -55,6 +55,17 @@ void assign_charge_real_nostor_res(system_t *s, parameters_t *p, data_t *d);
 
 void assign_charge_real_dynamic(system_t *s, parameters_t *p, data_t *d);
 
+void assign_charge_real_float(system_t *s, parameters_t *p, data_t *d);
+void assign_forces_real_float(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f);
+
+void assign_charge_real_padded(system_t *s, parameters_t *p, data_t *d);
+void assign_forces_real_padded(FLOAT_TYPE force_prefac, system_t *s, parameters_t *p, data_t *d, forces_t *f);
+void fold_padded_mesh_real(parameters_t *p, data_t *d);
+void mirror_padded_mesh_real(parameters_t *p, data_t *d);
+
+void assign_charge_incremental(system_t *s, parameters_t *p, data_t *d);
+void assign_charge_and_derivatives_incremental(system_t *s, parameters_t *p, data_t *d);
+
 #ifdef CA_DEBUG
 #define CA_TRACE(A) A
 #else
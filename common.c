@@ -26,6 +26,7 @@
 #include "ewald.h"
 #include "p3m-common.h"
 #include "wtime.h"
+#include "sort.h"
 
 #ifdef __detailed_timings
 double t_charge_assignment[4];
@@ -265,6 +266,63 @@ void Free_vector_array(vector_array_t *v) {
     }
 }
 
+// Checks if the ordered copy in d still matches the particles of s.
+static int ordered_system_valid( system_t *s, data_t *d ) {
+    const system_t *t = d->ordered;
+    int i, j;
+
+    for ( j=0; j<3; j++ )
+      if ( t->box_l[j] != s->box_l[j] )
+        return 0;
+
+    for ( i=0; i<s->nparticles; i++ ) {
+      const int k = d->order[i];
+      if ( ( t->p->x[i] != s->p->x[k] ) || ( t->p->y[i] != s->p->y[k] ) ||
+           ( t->p->z[i] != s->p->z[k] ) || ( t->q[i] != s->q[k] ) )
+        return 0;
+    }
+
+    return 1;
+}
+
+// Computes the k-space forces on a copy of the system that is ordered
+// along a Morton curve over the mesh cells, so that consecutive particles
+// touch neighboring parts of the mesh. Forces are returned in the original order.
+// The copy is kept in d and only sorted again when the particles changed.
+static void Kspace_force_ordered( const method_t *m, system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
+    int i, j;
+    forces_t *ft;
+
+    if ( ( d->ordered != NULL ) && ( d->ordered->nparticles != s->nparticles ) ) {
+      FFTW_FREE( d->order );
+      Free_system( d->ordered );
+      Free_forces( d->ordered_forces );
+      d->ordered = NULL;
+    }
+
+    if ( d->ordered == NULL ) {
+      d->order = (int *)Init_array( s->nparticles, sizeof(int) );
+      morton_order( s, p->mesh, d->order );
+      d->ordered = Init_system_permuted( s, d->order );
+      d->ordered_forces = Init_forces( s->nparticles );
+    } else if ( !ordered_system_valid( s, d ) ) {
+      morton_order( s, p->mesh, d->order );
+      Permute_system( d->ordered, s, d->order );
+    }
+
+    ft = d->ordered_forces;
+    for ( j=0; j<3; j++ )
+      memset ( ft->f_k->fields[j], 0, s->nparticles*sizeof ( FLOAT_TYPE ) );
+
+    d->ordered->energy = s->energy;
+    m->Kspace_force( d->ordered, p, d, ft );
+    s->energy = d->ordered->energy;
+
+    for ( j=0; j<3; j++ )
+      for ( i=0; i<s->nparticles; i++ )
+        f->f_k->fields[j][d->order[i]] += ft->f_k->fields[j][i];
+}
+
 void Calculate_forces ( const method_t *m, system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
 
     int i, j;
@@ -289,7 +347,13 @@ void Calculate_forces ( const method_t *m, system_t *s, parameters_t *p, data_t
 
     if(p->rcut != 0.0) {
       t = wtime();
-      Realteil( s, p, f );
+      if(P3M_VERLET_LISTS && (d != NULL)) {
+	Update_verlet_list( s, p, d, P3M_VERLET_SKIN );
+	Realpart_verlet( s, p, d, f );
+      } else if(s->nparticles >= P3M_LINKED_CELLS_MIN)
+	Realpart_cells( s, p, f );
+      else
+	Realteil( s, p, f );
       t  = wtime() - t;
     }
     /* printf("Realpart %lf sec\n", FLOAT_CAST t); */
@@ -302,7 +366,10 @@ void Calculate_forces ( const method_t *m, system_t *s, parameters_t *p, data_t
     #endif
 
     t = wtime();
-    m->Kspace_force ( s, p, d, f );
+    if ( P3M_REORDER && ( m->flags & METHOD_FLAG_ca ) )
+      Kspace_force_ordered ( m, s, p, d, f );
+    else
+      m->Kspace_force ( s, p, d, f );
     t  = wtime() - t;
 
     #ifdef __VALGRIND_PROFILE_KSPACE_ONLY
@@ -332,9 +399,16 @@ FLOAT_TYPE Calculate_reference_forces ( system_t *s, parameters_t *p ) {
 
     parameters_t op = *p;
 
+    /* The reference real space part is not interpolated */
+    int table = P3M_REALSPACE_TABLE;
+    P3M_REALSPACE_TABLE = -1;
+
     forces_t *f = Init_forces ( s->nparticles );
 
     op.rcut = 0.49 * s->length;
+    for ( int dim = 0; dim < 3; dim++ )
+      if ( 0.49 * s->box_l[dim] < op.rcut )
+        op.rcut = 0.49 * s->box_l[dim];
 
     op.alpha = Ewald_compute_optimal_alpha ( s, &op );
 
@@ -359,6 +433,8 @@ FLOAT_TYPE Calculate_reference_forces ( system_t *s, parameters_t *p ) {
     Free_data(d);
     Free_forces(f);
 
+    P3M_REALSPACE_TABLE = table;
+
     return method_ewald.Error( s, &op );
 }
 
@@ -371,6 +447,37 @@ FLOAT_TYPE distance( system_t *s, int i, int j ) {
   return SQRT(ret);
 }
 
+/* Sets the box lengths, s->length is the longest axis. */
+void Set_box( system_t *s, FLOAT_TYPE lx, FLOAT_TYPE ly, FLOAT_TYPE lz ) {
+  s->box_l[0] = lx;
+  s->box_l[1] = ly;
+  s->box_l[2] = lz;
+
+  s->length = lx;
+  if(ly > s->length)
+    s->length = ly;
+  if(lz > s->length)
+    s->length = lz;
+}
+
+/* Changes the box lengths and scales the positions accordingly. */
+void Resize_box( system_t *s, FLOAT_TYPE lx, FLOAT_TYPE ly, FLOAT_TYPE lz ) {
+  const FLOAT_TYPE l[3] = { lx, ly, lz };
+  int i, dim;
+
+  for(dim=0;dim<3;dim++) {
+    const FLOAT_TYPE scale = l[dim] / s->box_l[dim];
+    for(i=0;i<s->nparticles;i++)
+      s->p->fields[dim][i] *= scale;
+  }
+
+  Set_box(s, lx, ly, lz);
+}
+
+int Box_is_cubic( const system_t *s ) {
+  return (s->box_l[0] == s->box_l[1]) && (s->box_l[1] == s->box_l[2]);
+}
+
 FLOAT_TYPE Min_distance( system_t *s ) {
   int i,j;
   FLOAT_TYPE min =2.0*s->length, d;
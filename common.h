@@ -65,4 +65,8 @@ FLOAT_TYPE Calculate_reference_forces ( system_t *, parameters_t * );
 
 FLOAT_TYPE Min_distance( system_t *s);
 
+void Set_box( system_t *s, FLOAT_TYPE lx, FLOAT_TYPE ly, FLOAT_TYPE lz );
+void Resize_box( system_t *s, FLOAT_TYPE lx, FLOAT_TYPE ly, FLOAT_TYPE lz );
+int Box_is_cubic( const system_t *s );
+
 #endif
@@ -19,159 +19,174 @@
 #include "domain-decomposition.h"
 #include "common.h"
 
-static void init_neighbors(domain_decomposition_t *d, cell_t *c) {
-  celllist_t *i, *last=NULL, *buf;
-  int n[3], m[3], ind=0;
-  
-  buf = (celllist_t *)Init_array( 26, sizeof(celllist_t));
-  c->neighbors = buf;
-
-  for(n[0]=(c->coords[0]-1);n[0]<=(c->coords[0]+1);n[0]++)
-    for(n[1]=(c->coords[1]-1);n[1]<=(c->coords[1]+1);n[1]++)
-      for(n[2]=(c->coords[2]-1);n[2]<=(c->coords[2]+1);n[2]++) {
-	if((n[0]==c->coords[0]) &&
-	   (n[1]==c->coords[1]) &&
-	   (n[2]==c->coords[2]))
+/* Links the n cells in buf into a list and returns its head. */
+static celllist_t *link_cells(celllist_t *buf, int n) {
+  for(int i = 0; i < n; i++) {
+    buf[i].prev = (i > 0) ? buf + i - 1 : NULL;
+    buf[i].next = (i < n - 1) ? buf + i + 1 : NULL;
+  }
+  return (n > 0) ? buf : NULL;
+}
+
+static void init_neighbors(domain_decomposition_t *d, cell_t *c, celllist_t *all, celllist_t *half) {
+  int n[3], m[3], n_all=0, n_half=0;
+  const int *cpd = d->cells_per_direction;
+
+  for(n[0]=-1;n[0]<=1;n[0]++)
+    for(n[1]=-1;n[1]<=1;n[1]++)
+      for(n[2]=-1;n[2]<=1;n[2]++) {
+	if((n[0]==0) && (n[1]==0) && (n[2]==0))
 	  continue;
 
 	for(int i = 0;i<3;i++) {
-	  m[i] = n[i];
+	  m[i] = c->coords[i] + n[i];
 	  if(m[i] < 0)
-	    m[i] += d->cells_per_direction;
-	  if(m[i] >= d->cells_per_direction )
-	    m[i] -= d->cells_per_direction;
+	    m[i] += cpd[i];
+	  if(m[i] >= cpd[i] )
+	    m[i] -= cpd[i];
 	}
 	if((m[0]==c->coords[0]) &&
 	   (m[1]==c->coords[1]) &&
 	   (m[2]==c->coords[2]))
 	  continue;
 
-	i = buf + ind;
-	i->prev = (celllist_t *) last;
-	if(last != NULL)
-	  last->next = (celllist_t *)i;
-	i->c = (cell_t *)  &(d->cells[d->cells_per_direction * d->cells_per_direction * m[0] +
-			  d->cells_per_direction * m[1] + m[2]]);
-	last = i;
-	ind++;
-      }
+	cell_t *nb = &(d->cells[cpd[1] * cpd[2] * m[0] + cpd[2] * m[1] + m[2]]);
 
-  last->next = NULL;
-}
+	all[n_all++].c = nb;
 
-void Free_cell(cell_t *c) {
-  assert( c != NULL);
-  celllist_t *n = c->neighbors;
-  while(n != NULL) {
-    n = n->next;
-    if(n->prev != NULL)
-      FFTW_FREE(n->prev);
-  }
-  Resize_buffered_list(c->__q, 0);
-  FFTW_FREE(c->__q);
+	/* Offset is lexicographically positive */
+	if((n[0] > 0) || ((n[0] == 0) && ((n[1] > 0) || ((n[1] == 0) && (n[2] > 0)))))
+	  half[n_half++].c = nb;
+      }
 
-  Resize_buffered_list(c->__ids, 0);
-  FFTW_FREE(c->__ids);
+  c->neighbors = link_cells(all, n_all);
+  c->half_shell = link_cells(half, n_half);
+}
 
-  Resize_bvector_array( c->p, 0);
-  FFTW_FREE(c->p);
+static void free_particles( domain_decomposition_t *d ) {
+  if(d->capacity == 0)
+    return;
 
-  FFTW_FREE(c);
+  for(int i=0;i<3;i++)
+    FFTW_FREE(d->fields[i]);
+  FFTW_FREE(d->q);
+  FFTW_FREE(d->ids);
+  FFTW_FREE(d->cell_of);
+  d->capacity = 0;
 }
 
 void Free_dd( domain_decomposition_t *dd) {
   assert( dd != NULL );
 
-  for(int i=0;i<dd->total_cells;i++) {
-    Free_cell(&dd->cells[i]);
-  }
+  free_particles(dd);
 
+  FFTW_FREE(dd->neighbor_buf);
+  FFTW_FREE(dd->half_shell_buf);
   FFTW_FREE(dd->cells);
   FFTW_FREE(dd);
 }
 
-domain_decomposition_t *Init_dd( int cells_per_direction, FLOAT_TYPE box ) {
+domain_decomposition_t *Init_dd( const int cells_per_direction[3], const FLOAT_TYPE box[3] ) {
   domain_decomposition_t *d = (domain_decomposition_t *)Init_array( 1, sizeof(domain_decomposition_t) );
   int n[3], ind=0;
 
-  assert(cells_per_direction != 0);
-
-  d->h = box / cells_per_direction;
-  
-  d->total_cells = cells_per_direction * cells_per_direction * cells_per_direction;
-
-  d->cells_per_direction = cells_per_direction;
+  d->total_cells = 1;
+  for(int i=0;i<3;i++) {
+    assert(cells_per_direction[i] > 0);
+    d->cells_per_direction[i] = cells_per_direction[i];
+    d->box[i] = box[i];
+    d->h[i] = box[i] / cells_per_direction[i];
+    d->total_cells *= cells_per_direction[i];
+  }
 
   d->cells = (cell_t *)Init_array( d->total_cells, sizeof(cell_t));
+  d->neighbor_buf = (celllist_t *)Init_array( 26*d->total_cells, sizeof(celllist_t));
+  d->half_shell_buf = (celllist_t *)Init_array( 13*d->total_cells, sizeof(celllist_t));
+
+  d->n_particles = 0;
+  d->capacity = 0;
 
-  for(n[0]=0;n[0]<cells_per_direction;n[0]++)
-    for(n[1]=0;n[1]<cells_per_direction;n[1]++)
-      for(n[2]=0;n[2]<cells_per_direction;n[2]++) {
+  for(n[0]=0;n[0]<cells_per_direction[0];n[0]++)
+    for(n[1]=0;n[1]<cells_per_direction[1];n[1]++)
+      for(n[2]=0;n[2]<cells_per_direction[2];n[2]++) {
 	cell_t *c = &(d->cells[ind++]);
-	c->p = Init_bvector_array(0);
-	c->__q = Init_buffered_list(0);
-	c->q = (FLOAT_TYPE *)c->__q->data;
-	c->__ids = Init_buffered_list(0);
-	c->ids = (int *)c->__ids->data;
-	c->neighbors = NULL;
 	c->n_particles = 0;
-	for(int j=0;j<3;j++)
+	c->offset = 0;
+	for(int j=0;j<3;j++) {
 	  c->coords[j] = n[j];
-
-	init_neighbors(d, c);
+	  c->fields[j] = NULL;
+	}
+	c->q = NULL;
+	c->ids = NULL;
       }
-  return d;
-}
 
-static inline void add_particle_to_cell( cell_t *c, int id, FLOAT_TYPE pos[3], FLOAT_TYPE q) {
-  assert( c != 0 );
-  int old_size = c->n_particles;
-  int new_size = old_size+1;
+  /* All cells have to exist before they can be linked */
+  for(ind=0;ind<d->total_cells;ind++)
+    init_neighbors(d, &d->cells[ind], d->neighbor_buf + 26*ind, d->half_shell_buf + 13*ind);
 
-  Resize_bvector_array( c->p, new_size );
-  Resize_buffered_list(c->__q, new_size*sizeof(FLOAT_TYPE));
-  c->q = (FLOAT_TYPE *)c->__q->data;
-  Resize_buffered_list(c->__ids, new_size*sizeof(int));
-  c->ids = (int *)c->__ids->data;
-
-  for(int i = 0; i<3; i++)
-    c->p->fields[i][old_size] = pos[i];
-
-  c->q[old_size] = q;
-
-  c->n_particles++;     
+  return d;
 }
 
-cell_t *add_particle( domain_decomposition_t *d, int id, FLOAT_TYPE pos[3], FLOAT_TYPE q) {
-  int n[3], ind;
-  cell_t *c;
+static void reserve_particles( domain_decomposition_t *d, int n ) {
+  if(n <= d->capacity)
+    return;
 
-  assert(d != NULL);
+  free_particles(d);
 
   for(int i=0;i<3;i++)
-    n[i] = (int)FLOOR(pos[i] / d->h);
-
-  /* printf("particle %d pos (%lf %lf %lf) cell (%d %d %d) q %lf\n", id, */
-  /* 	 pos[0], pos[1], pos[2], n[0], n[1], n[2], q); */
+    d->fields[i] = (FLOAT_TYPE *)Init_array( n, sizeof(FLOAT_TYPE));
+  d->q = (FLOAT_TYPE *)Init_array( n, sizeof(FLOAT_TYPE));
+  d->ids = (int *)Init_array( n, sizeof(int));
+  d->cell_of = (int *)Init_array( n, sizeof(int));
+  d->capacity = n;
+}
 
-  ind = d->cells_per_direction * d->cells_per_direction * n[0] +
-    d->cells_per_direction * n[1] + n[2];
+/* First pass counts the particles per cell, the prefix sums give the
+   cell offsets, the second pass copies the particles to their place. */
+void Bin_system( domain_decomposition_t *d, system_t *s) {
+  const int *cpd = d->cells_per_direction;
+  const FLOAT_TYPE lengthi[3] = { 1.0/d->box[0], 1.0/d->box[1], 1.0/d->box[2] };
+  const FLOAT_TYPE hi[3] = { 1.0/d->h[0], 1.0/d->h[1], 1.0/d->h[2] };
+  int n[3], c, pos;
 
-  if(ind >= d->total_cells)
-    return NULL;
+  reserve_particles( d, s->nparticles );
+  d->n_particles = s->nparticles;
 
-  c = &(d->cells[ind]);
+  for(c=0;c<d->total_cells;c++)
+    d->cells[c].n_particles = 0;
 
-  add_particle_to_cell( c, id, pos, q);
+  for(int id=0;id<s->nparticles;id++) {
+    for(int j=0;j<3;j++) {
+      /* Fold into the box, rounding can give exactly box[j] */
+      FLOAT_TYPE x = s->p->fields[j][id] - FLOOR(s->p->fields[j][id]*lengthi[j])*d->box[j];
+      n[j] = (int)(x*hi[j]);
+      if(n[j] >= cpd[j])
+	n[j] = cpd[j] - 1;
+    }
+    c = (n[0]*cpd[1] + n[1])*cpd[2] + n[2];
+    d->cell_of[id] = c;
+    d->cells[c].n_particles++;
+  }
 
-  return c;
-}
+  pos = 0;
+  for(c=0;c<d->total_cells;c++) {
+    cell_t *cell = &(d->cells[c]);
+    cell->offset = pos;
+    for(int j=0;j<3;j++)
+      cell->fields[j] = d->fields[j] + pos;
+    cell->q = d->q + pos;
+    cell->ids = d->ids + pos;
+    pos += cell->n_particles;
+    /* Used as fill counter in the second pass */
+    cell->n_particles = 0;
+  }
 
-void add_system( domain_decomposition_t *d, system_t *s) {
-  FLOAT_TYPE pos[3];
   for(int id=0;id<s->nparticles;id++) {
+    cell_t *cell = &(d->cells[d->cell_of[id]]);
+    int k = cell->n_particles++;
     for(int j=0;j<3;j++)
-      pos[j] = s->p->fields[j][id];
-    add_particle( d, id, pos, s->q[id]);
+      cell->fields[j][k] = s->p->fields[j][id] - FLOOR(s->p->fields[j][id]*lengthi[j])*d->box[j];
+    cell->q[k] = s->q[id];
+    cell->ids[k] = id;
   }
 }
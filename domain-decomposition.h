@@ -18,25 +18,21 @@
 
 #include "types.h"
 
-#define ILIST_STEP 100
-
 typedef struct celllist_t celllist_t;
 
-typedef struct {
-  int real_size;
-  int used_size;
-  int *data;
-} intlist_t;
-
+/* A cell is a view into the particle arrays of the decomposition,
+   its particles are contiguous there. */
 typedef struct {
   int n_particles;
-  bvector_array_t *p;
-  bvector_array_t *v;
+  // index of the first particle in the arrays of the decomposition
+  int offset;
+  FLOAT_TYPE *fields[3];
   FLOAT_TYPE *q;
-  buffered_list_t *__q;
   int *ids;
-  buffered_list_t *__ids;
   celllist_t *neighbors;
+  /* The 13 neighbors in positive direction, each pair of neighboring
+     cells is in the half shell of exactly one of them. */
+  celllist_t *half_shell;
   int coords[3];
 } cell_t;
 
@@ -47,15 +43,30 @@ struct celllist_t {
 };
 
 typedef struct {
-  int cells_per_direction;
+  int cells_per_direction[3];
   int total_cells;
   cell_t *cells;
-  FLOAT_TYPE h;
+  FLOAT_TYPE h[3];
+  FLOAT_TYPE box[3];
+  // Storage of the neighbor lists of all cells
+  celllist_t *neighbor_buf;
+  celllist_t *half_shell_buf;
+  // Particles sorted by cell, positions folded into the box
+  int n_particles;
+  int capacity;
+  FLOAT_TYPE *fields[3];
+  FLOAT_TYPE *q;
+  int *ids;
+  // Cell index of each particle by id
+  int *cell_of;
 } domain_decomposition_t;
 
-domain_decomposition_t *Init_dd( int cells_per_direction, FLOAT_TYPE box );
+/* Periodic cells, at least three per direction for the neighbor lists
+   to be free of duplicates. */
+domain_decomposition_t *Init_dd( const int cells_per_direction[3], const FLOAT_TYPE box[3] );
 void Free_dd( domain_decomposition_t *dd);
-cell_t *add_particle( domain_decomposition_t *d, int id, FLOAT_TYPE pos[3], FLOAT_TYPE q);
-void add_system( domain_decomposition_t *d, system_t *s);
+/* Sorts the particles of s into the cells (counting sort, O(N)), can
+   be called again whenever the particles moved. */
+void Bin_system( domain_decomposition_t *d, system_t *s);
 
 #endif
@@ -19,11 +19,18 @@
 #include <stdio.h>
 #include <math.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "common.h"
 #include "p3m-common.h"
 
 #include "ewald.h"
 
+/* G_hat is a cubic mesh of size d->mesh, independent of d->grid */
+#define ewald_ind(A,B,C) ((A)*d->mesh*d->mesh + (B)*d->mesh + (C))
+
 /*----------------------------------------------------------------------*/
 /* CONSTANTS */
 /*----------------------------------------------------------------------*/
@@ -48,7 +55,7 @@
 // Method declaration
 
 const method_t method_ewald = { METHOD_EWALD, "Ewald summation.", "ewald",
-				METHOD_FLAG_G_hat, 
+				METHOD_FLAG_G_hat | METHOD_FLAG_noncubic, 
 				&Ewald_init, &Ewald_compute_influence_function, &Ewald_k_space, &Ewald_estimate_error, &Ewald_error_k };
 
 static FLOAT_TYPE compute_error_estimate_k(system_t *s, parameters_t *p, FLOAT_TYPE alpha);
@@ -72,9 +79,10 @@ FLOAT_TYPE Ewald_self_energy( system_t *s, parameters_t *p ) {
 /*----------------------------------------------------------------------*/
 /* Precomputes the influence function 
 
-     2.0/L^2 * exp(-(PI*n/(alpha*L))^2)/n^2 
+     2.0/V * exp(-(PI*k/alpha)^2)/k^2,  k_i = n_i/L_i
 
-   as a function of lattice vector n (NOT k=2*PI*n/L). 
+   as a function of lattice vector n (NOT k=2*PI*n/L). Only vectors
+   with |k| <= kmax/L, L the longest box axis, are used.
    This is stored in the array
 
      Ghat[Maxkmax+1][Maxkmax+1][Maxkmax+1]
@@ -84,28 +92,44 @@ FLOAT_TYPE Ewald_self_energy( system_t *s, parameters_t *p ) {
 void Ewald_compute_influence_function(system_t *s, parameters_t *p, data_t *d)
 {
   
-  int    nx,ny,nz;
-  FLOAT_TYPE n_sqr,fak1,fak2;
+  int    nx,ny,nz,dim;
+  FLOAT_TYPE k_sqr,fak1,fak2;
   const int kmax = p->mesh - 1;
-  const int kmax2 = kmax*kmax;
+  const FLOAT_TYPE k2max = SQR(kmax/s->length);
+  /* The Gaussian factorizes, e[dim][n] = exp(-fak2 (n/L_dim)^2) */
+  FLOAT_TYPE *e[3], *k2[3];
   
-  fak1 = 2.0/SQR(s->length);
-  fak2 = SQR(PI/(p->alpha*s->length));
+  fak1 = 2.0/(s->box_l[0]*s->box_l[1]*s->box_l[2]);
+  fak2 = SQR(PI/p->alpha);
+
+  for (dim=0; dim < 3; dim++) {
+    e[dim] = (FLOAT_TYPE *)Init_array(kmax+1, sizeof(FLOAT_TYPE));
+    k2[dim] = (FLOAT_TYPE *)Init_array(kmax+1, sizeof(FLOAT_TYPE));
+    for (nx=0; nx <= kmax; nx++) {
+      k2[dim][nx] = SQR(nx/s->box_l[dim]);
+      e[dim][nx] = EXP(-fak2*k2[dim][nx]);
+    }
+  }
 
 #ifdef _OPENMP
-#pragma omp parallel for collapse(2) private(n_sqr)
+#pragma omp parallel for collapse(3) private(k_sqr) schedule(static)
 #endif 
   for (nx=0; nx <= kmax; nx++)
     for (ny=0; ny <= kmax; ny++)
       for (nz=0; nz <= kmax; nz++) {
-	n_sqr = SQR(nx) + SQR(ny) + SQR(nz);
-	if ((nx==0 && ny==0 && nz==0) || (n_sqr > kmax2)) {
-  //  printf("%d %d %d, kmax %d, kmax2 %d\n", nx, ny, nz, kmax, kmax2);
-	  d->G_hat[r_ind(nx,ny,nz)] = 0.0;
+	k_sqr = k2[0][nx] + k2[1][ny] + k2[2][nz];
+	/* Tolerance keeps |n| = kmax of a cubic box inside the cutoff */
+	if ((nx==0 && ny==0 && nz==0) || (k_sqr > k2max*(1.0 + 1e-12))) {
+	  d->G_hat[ewald_ind(nx,ny,nz)] = 0.0;
         } else {
-	  d->G_hat[r_ind(nx,ny,nz)] = fak1/n_sqr * EXP(-fak2*n_sqr);
+	  d->G_hat[ewald_ind(nx,ny,nz)] = fak1/k_sqr * e[0][nx]*e[1][ny]*e[2][nz];
 	}
       }
+
+  for (dim=0; dim < 3; dim++) {
+    Free_array(e[dim]);
+    Free_array(k2[dim]);
+  }
 }  
 
 data_t *Ewald_init(system_t *s, parameters_t *p)
@@ -119,56 +143,187 @@ data_t *Ewald_init(system_t *s, parameters_t *p)
   return d;
 }
 
+/* k-space part with recursive structure factors.
+
+   The k-vectors are the half space nx > 0, or nx = 0 and ny > 0, or
+   nx = ny = 0 and nz > 0 of the vectors with non-zero influence
+   function, -k contributes the complex conjugate. They are grouped in
+   rows of consecutive nz. Per particle the factors exp(2 pi i n x/L)
+   are computed for all n of an axis by recurrence, the phase of a
+   k-vector is then one complex product per k within a row.
+
+   The structure factor S(k) = sum_j q_j exp(2 pi i k r_j) is summed
+   over the particles in per thread arrays. In the same parallel region
+   the arrays are reduced, and then the forces are computed. */
+
+typedef struct {
+  int nx, ny, nz0, nz1;
+  /* Offset of the row in the k-vector arrays */
+  int c;
+} ewald_row_t;
+
+/* exp(2 pi i n x/L) for n = -kmax..kmax, stored at n+kmax. */
+inline static void ewald_phases(FLOAT_TYPE x, FLOAT_TYPE Leni, int kmax, FLOAT_TYPE *re, FLOAT_TYPE *im) {
+  const FLOAT_TYPE c = COS(2.0*PI*x*Leni), sn = SIN(2.0*PI*x*Leni);
+  int n;
+
+  re[kmax] = 1.0;
+  im[kmax] = 0.0;
+  for (n=1; n<=kmax; n++) {
+    re[kmax+n] = re[kmax+n-1]*c - im[kmax+n-1]*sn;
+    im[kmax+n] = re[kmax+n-1]*sn + im[kmax+n-1]*c;
+    re[kmax-n] = re[kmax+n];
+    im[kmax-n] = -im[kmax+n];
+  }
+}
+
 void Ewald_k_space(system_t *s, parameters_t *p, data_t *d, forces_t *f)
 {
-  int    i;
-  int    nx, ny, nz;
-  FLOAT_TYPE kr, energy=0.0;
-  FLOAT_TYPE rhohat_re=0, rhohat_im=0, ghat=0;
-  FLOAT_TYPE force_factor;
-  FLOAT_TYPE Leni = 1.0/s->length;
+  const FLOAT_TYPE Leni[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
   const int kmax = p->mesh;
-  const int kmax2 = kmax*kmax;
-  
-  for (nx=-kmax; nx<=kmax; nx++)
-    for (ny=-kmax; ny<=kmax; ny++)
-      for (nz=-kmax; nz<=kmax; nz++)
-	if (nx*nx + ny*ny + nz*nz <= kmax2) {
-	  /* compute rhohat */
-	  rhohat_re = 0.0;
-	  rhohat_im = 0.0;
-          ghat = d->G_hat[r_ind(abs(nx), abs(ny), abs(nz))];          
-#ifdef _OPENMP          
-#pragma omp parallel for private(kr) reduction( + : rhohat_re ) reduction( + : rhohat_im )
+  const int nk1 = 2*kmax+1;
+  int nx, ny, nz, nrows = 0, nk = 0, nthreads = 1, r, c, t;
+  ewald_row_t *rows;
+  FLOAT_TYPE *ghat, *S, *W, energy = 0.0;
+
+  rows = (ewald_row_t *)Init_array((kmax+1)*nk1, sizeof(ewald_row_t));
+
+  for (nx=0; nx<=kmax; nx++)
+    for (ny=(nx == 0) ? 0 : -kmax; ny<=kmax; ny++) {
+      /* G_hat is non-zero on a contiguous range of nz */
+      for (nz=kmax; (nz >= 0) && (d->G_hat[ewald_ind(nx, abs(ny), nz)] == 0.0); nz--)
+	;
+      rows[nrows].nx = nx;
+      rows[nrows].ny = ny;
+      rows[nrows].nz0 = ((nx == 0) && (ny == 0)) ? 1 : -nz;
+      rows[nrows].nz1 = nz;
+      rows[nrows].c = nk;
+      if (rows[nrows].nz1 >= rows[nrows].nz0) {
+	nk += rows[nrows].nz1 - rows[nrows].nz0 + 1;
+	nrows++;
+      }
+    }
+
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+
+  ghat = (FLOAT_TYPE *)Init_array(nk, sizeof(FLOAT_TYPE));
+  /* Per thread structure factors, real parts then imaginary parts */
+  S = (FLOAT_TYPE *)Init_array(2*nk*nthreads, sizeof(FLOAT_TYPE));
+  W = (FLOAT_TYPE *)Init_array(2*nk, sizeof(FLOAT_TYPE));
+
+  for (r=0; r<nrows; r++)
+    for (nz=rows[r].nz0, c=rows[r].c; nz<=rows[r].nz1; nz++, c++)
+      ghat[c] = d->G_hat[ewald_ind(rows[r].nx, abs(rows[r].ny), abs(nz))];
+
+#ifdef _OPENMP
+#pragma omp parallel private(r, c, t, nz)
 #endif
-	  for (i=0; i<s->nparticles; i++) {
-            kr = 2.0*PI*Leni*(nx*(s->p->x[i]) + ny*(s->p->y[i]) + nz*(s->p->z[i]));
-	    rhohat_re += s->q[i] * COS(kr);
-	    rhohat_im += s->q[i] * -SIN(kr);
-          }
+  {
+    FLOAT_TYPE ex_re[nk1], ex_im[nk1], ey_re[nk1], ey_im[nk1], ez_re[nk1], ez_im[nk1];
+    int i, tid = 0;
 #ifdef _OPENMP
-#pragma omp barrier
+    tid = omp_get_thread_num();
+#endif
+    FLOAT_TYPE * restrict S_re = S + 2*nk*tid;
+    FLOAT_TYPE * restrict S_im = S_re + nk;
 
-#pragma omp parallel for private(kr, force_factor)
+    for (c=0; c<nk; c++)
+      S_re[c] = S_im[c] = 0.0;
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
 #endif
-	  for (i=0; i<s->nparticles; i++) {
-	    kr = 2.0*PI*Leni*(nx*(s->p->x[i]) + ny*(s->p->y[i]) + nz*(s->p->z[i]));
-	     
-            force_factor = s->q[i] * ghat 
-              * (rhohat_re*SIN(kr) + rhohat_im*COS(kr));
-
-            f->f_k->x[i] += nx * force_factor;
-            f->f_k->y[i] += ny * force_factor;
-            f->f_k->z[i] += nz * force_factor;
-	  }
+    for (i=0; i<s->nparticles; i++) {
+      ewald_phases(s->p->x[i], Leni[0], kmax, ex_re, ex_im);
+      ewald_phases(s->p->y[i], Leni[1], kmax, ey_re, ey_im);
+      ewald_phases(s->p->z[i], Leni[2], kmax, ez_re, ez_im);
+
+      for (r=0; r<nrows; r++) {
+	const ewald_row_t *row = rows + r;
+	const FLOAT_TYPE a_re = ex_re[kmax+row->nx], a_im = ex_im[kmax+row->nx];
+	const FLOAT_TYPE b_re = ey_re[kmax+row->ny], b_im = ey_im[kmax+row->ny];
+	const FLOAT_TYPE qxy_re = s->q[i]*(a_re*b_re - a_im*b_im);
+	const FLOAT_TYPE qxy_im = s->q[i]*(a_re*b_im + a_im*b_re);
+	const FLOAT_TYPE * restrict zr = ez_re + kmax + row->nz0;
+	const FLOAT_TYPE * restrict zi = ez_im + kmax + row->nz0;
+	FLOAT_TYPE * restrict sr = S_re + row->c;
+	FLOAT_TYPE * restrict si = S_im + row->c;
+	const int n = row->nz1 - row->nz0 + 1;
+
+	for (t=0; t<n; t++) {
+	  sr[t] += qxy_re*zr[t] - qxy_im*zi[t];
+	  si[t] += qxy_re*zi[t] + qxy_im*zr[t];
 	}
+      }
+    }
+
+    /* Reduction of the thread arrays, W = 2 ghat conj(S) for the
+       forces of k and -k */
 #ifdef _OPENMP
-#pragma omp barrier
+#pragma omp for schedule(static) reduction(+:energy)
 #endif
-  /* compute energy */
-  energy += ghat*(SQR(rhohat_re) + SQR(rhohat_im));
+    for (c=0; c<nk; c++) {
+      FLOAT_TYPE re = 0.0, im = 0.0;
+      for (t=0; t<nthreads; t++) {
+	re += S[2*nk*t + c];
+	im += S[2*nk*t + nk + c];
+      }
+      energy += 2.0*ghat[c]*(SQR(re) + SQR(im));
+      W[c] = 2.0*ghat[c]*re;
+      W[nk + c] = -2.0*ghat[c]*im;
+    }
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (i=0; i<s->nparticles; i++) {
+      FLOAT_TYPE fx = 0.0, fy = 0.0, fz = 0.0;
+
+      ewald_phases(s->p->x[i], Leni[0], kmax, ex_re, ex_im);
+      ewald_phases(s->p->y[i], Leni[1], kmax, ey_re, ey_im);
+      ewald_phases(s->p->z[i], Leni[2], kmax, ez_re, ez_im);
+
+      for (r=0; r<nrows; r++) {
+	const ewald_row_t *row = rows + r;
+	const FLOAT_TYPE a_re = ex_re[kmax+row->nx], a_im = ex_im[kmax+row->nx];
+	const FLOAT_TYPE b_re = ey_re[kmax+row->ny], b_im = ey_im[kmax+row->ny];
+	const FLOAT_TYPE xy_re = a_re*b_re - a_im*b_im;
+	const FLOAT_TYPE xy_im = a_re*b_im + a_im*b_re;
+	const FLOAT_TYPE * restrict zr = ez_re + kmax + row->nz0;
+	const FLOAT_TYPE * restrict zi = ez_im + kmax + row->nz0;
+	const FLOAT_TYPE * restrict wr = W + row->c;
+	const FLOAT_TYPE * restrict wi = W + nk + row->c;
+	const int n = row->nz1 - row->nz0 + 1;
+	/* Im(exp(i k r) W) summed over the row and weighted with nz */
+	FLOAT_TYPE sum = 0.0, sum_z = 0.0;
+
+	for (t=0; t<n; t++) {
+	  const FLOAT_TYPE ph_re = xy_re*zr[t] - xy_im*zi[t];
+	  const FLOAT_TYPE ph_im = xy_re*zi[t] + xy_im*zr[t];
+	  const FLOAT_TYPE v = ph_re*wi[t] + ph_im*wr[t];
+	  sum += v;
+	  sum_z += (row->nz0 + t)*v;
+	}
+
+	fx += row->nx*sum;
+	fy += row->ny*sum;
+	fz += sum_z;
+      }
+
+      f->f_k->x[i] += s->q[i]*Leni[0]*fx;
+      f->f_k->y[i] += s->q[i]*Leni[1]*fy;
+      f->f_k->z[i] += s->q[i]*Leni[2]*fz;
+    }
+  }
+
+  Free_array(rows);
+  Free_array(ghat);
+  Free_array(S);
+  Free_array(W);
 
-  s->energy +=(0.5*s->length /(2.0*PI)) * energy;
+  s->energy +=(0.5 /(2.0*PI)) * energy;
   s->energy += Ewald_self_energy(s, p);
 }
 
@@ -176,7 +331,7 @@ FLOAT_TYPE compute_error_estimate_r(system_t *s, parameters_t *p, FLOAT_TYPE alp
   FLOAT_TYPE res;
   FLOAT_TYPE rmax2 = p->rcut*p->rcut;
   /* Kolafa-Perram, eq. 16 */
-  res = s->q2*SQRT(p->rcut/(2.0*s->length*s->length*s->length)) * exp(-SQR(alpha)*rmax2) / (SQR(alpha)*rmax2);
+  res = s->q2*SQRT(p->rcut/(2.0*s->box_l[0]*s->box_l[1]*s->box_l[2])) * exp(-SQR(alpha)*rmax2) / (SQR(alpha)*rmax2);
   
   return res;
 }
@@ -36,7 +36,7 @@ system_t *generate_seperated_dipole(int size, FLOAT_TYPE box) {
   gsl_rng *rng = gsl_rng_alloc(gsl_rng_default);
 
   s = Init_system(2*n_dipoles);
-  s->length = box;
+  Set_box(s, box, box, box);
   s->q2 = 0.0;
 
   /* Generate randome position for the first particle of the dipole x,
@@ -84,7 +84,7 @@ system_t *generate_madelung(int size, FLOAT_TYPE box) {
   printf("generate_madelung: box %lf, size %d, per_row %d, a %lf, off %lf\n", box, size, per_row, a, off);
 
   s = Init_system(size);
-  s->length = box;
+  Set_box(s, box, box, box);
   s->q2 = 0.0;
 
   for(i=0; i<per_row; i++)
@@ -109,7 +109,7 @@ system_t *generate_inner_box(int size, FLOAT_TYPE box) {
   gsl_rng *rng = gsl_rng_alloc(gsl_rng_default);
 
   s = Init_system(size);
-  s->length = box;
+  Set_box(s, box, box, box);
   s->q2 = 0.0;
 
   for(i=0;i<size;i++) {
@@ -131,7 +131,7 @@ system_t *generate_slab(int size, FLOAT_TYPE box) {
   gsl_rng *rng = gsl_rng_alloc(gsl_rng_default);
 
   s = Init_system(size);
-  s->length = box;
+  Set_box(s, box, box, box);
   s->q2 = 0.0;
 
   for(i=0;i<size;i++) {
@@ -152,7 +152,7 @@ system_t *generate_random_system(int size, FLOAT_TYPE box, FLOAT_TYPE max_charge
   gsl_rng *rng = gsl_rng_alloc(gsl_rng_default);
   
   s = Init_system(size);
-  s->length = box;
+  Set_box(s, box, box, box);
   s->q2 = 0.0;
 
   for(i=0;i<size;i++) {
@@ -177,7 +177,7 @@ system_t *generate_gaussian_system(int size, FLOAT_TYPE box, FLOAT_TYPE max_char
   FLOAT_TYPE x;
 
   s = Init_system(size);
-  s->length = box;
+  Set_box(s, box, box, box);
   s->q2 = 0.0;
 
   for(i=0;i<size;i++) {
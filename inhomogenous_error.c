@@ -15,6 +15,7 @@
 
 #include "types.h"
 #include "common.h"
+#include "wisdom.h"
 #include <stdio.h>
 #include <math.h>
 #include <fftw3.h>
@@ -53,7 +54,7 @@ FLOAT_TYPE inhomo_error(system_t *s, parameters_t *p, int bins) {
   /* } */
   /* fclose(debug_output); */
 
-  forward_plan = FFTW_PLAN_DFT_3D(bins, bins, bins, (FFTW_COMPLEX *)rho_mesh,(FFTW_COMPLEX *)rho_mesh, FFTW_FORWARD, FFTW_PATIENT);
+  forward_plan = Wisdom_plan_dft_3d(bins, bins, bins, (FFTW_COMPLEX *)rho_mesh,(FFTW_COMPLEX *)rho_mesh, FFTW_FORWARD);
 
   FFTW_EXECUTE(forward_plan);
 
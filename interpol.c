@@ -59,14 +59,33 @@ interpolation_t *Init_interpolation(int ip, int derivatives)
 	  ret->interpol_d[i+MaxInterpol][j] = i_fct.U_d(j, x, ip+1);
       }
   ret->U_hat = i_fct.U_hat;
+  ret->cao = ip+1;
+  ret->direct = 0;
+  return ret;
+}
+
+/* Interpolation without tables, the charge assignment
+   evaluates the B-spline weights directly. */
+interpolation_t *Init_interpolation_direct(int ip)
+{
+  interpolation_t *ret;
+  ret = (interpolation_t *)Init_array( 1, sizeof(interpolation_t));
+
+  ret->interpol = NULL;
+  ret->interpol_d = NULL;
+  ret->U_hat = ip_bspline.U_hat;
+  ret->cao = ip+1;
+  ret->direct = 1;
   return ret;
 }
 
 //@TODO: remove memleak
 void Free_interpolation(interpolation_t *i) {
-  for( int j = 0; j < (2*MaxInterpol+1); j++)
-    FFTW_FREE(i->interpol[j]);
-  FFTW_FREE(i->interpol);
+  if(i->interpol != NULL) {
+    for( int j = 0; j < (2*MaxInterpol+1); j++)
+      FFTW_FREE(i->interpol[j]);
+    FFTW_FREE(i->interpol);
+  }
   if(i->interpol_d != NULL) {
     for( int j = 0; j < (2*MaxInterpol+1); j++)
       FFTW_FREE(i->interpol_d[j]);
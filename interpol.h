@@ -35,6 +35,7 @@ typedef struct {
 } interpolation_function_t;
 
 interpolation_t *Init_interpolation(int, int);
+interpolation_t *Init_interpolation_direct(int);
 void Free_interpolation(interpolation_t *i);
 
 #endif
@@ -106,7 +106,8 @@ system_t *Read_system(parameters_t *p, char *filename)
     int i;
 
     double buf[4];
-    FLOAT_TYPE Length;
+    FLOAT_TYPE Length[3];
+    char line[256];
     int n;
 
     int ret_val = 0;
@@ -125,8 +126,13 @@ system_t *Read_system(parameters_t *p, char *filename)
 
     //read system parameters
     ret_val += fscanf(fp,"# Teilchenzahl: %d\n",&n);
-    ret_val += fscanf(fp,"# Len: %lf\n",buf);
-    Length = buf[0];
+    ret_val += fscanf(fp,"# Len: %lf",buf);
+    Length[0] = Length[1] = Length[2] = buf[0];
+    /* Non-cubic boxes have the three box lengths on this line */
+    if((fgets(line, sizeof(line), fp) != NULL) && (sscanf(line, "%lf %lf", buf + 1, buf + 2) == 2)) {
+      Length[1] = buf[1];
+      Length[2] = buf[2];
+    }
 
     if(ret_val != 2) {
       fprintf(stderr, "Error while reading file '%s'\n", filename);
@@ -134,7 +140,7 @@ system_t *Read_system(parameters_t *p, char *filename)
     }
     
     s = Init_system(n);
-    s->length = Length;
+    Set_box(s, Length[0], Length[1], Length[2]);
 
     s->q2 = 0.0;
     /* Teilchenkoordinaten und -ladungen: */
@@ -215,7 +221,10 @@ void Write_system(system_t *s, char *filename)
 
     //read system parameters
     fprintf(fp,"# Teilchenzahl: %d\n", s->nparticles);
-    fprintf(fp,"# Len: %lf\n", FLOAT_CAST  s->length);
+    if(Box_is_cubic(s))
+      fprintf(fp,"# Len: %lf\n", FLOAT_CAST  s->length);
+    else
+      fprintf(fp,"# Len: %lf %lf %lf\n", FLOAT_CAST s->box_l[0], FLOAT_CAST s->box_l[1], FLOAT_CAST s->box_l[2]);
 
     /* Teilchenkoordinaten und -ladungen: */
     for (i=0; i<s->nparticles; i++) {
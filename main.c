@@ -25,6 +25,7 @@
 #include "types.h"
 
 #include "p3m-common.h"
+#include "wisdom.h"
 
 #include "parameters.h"
 
@@ -35,8 +36,14 @@
 #include "p3m-ad.h"
 #include "p3m-ad-i.h"
 #include "p3m-ik-real.h"
+#include "p3m-ik-real-packed.h"
 #include "p3m-ad-real.h"
 
+#ifdef P3M_MPI
+#include <mpi.h>
+#include "p3m-ik-mpi.h"
+#endif
+
 #include "ewald.h"
 
 #include "interpol.h"
@@ -102,7 +109,7 @@ int main ( int argc, char **argv ) {
     forces_t *forces, *forces_ewald;
     char *pos_file = NULL, *force_file = NULL, *out_file = NULL, *ref_out = NULL, *sys_out = NULL, *rdf_file = NULL, *vtf_file = NULL, *cdf_file = NULL;
     error_t error;
-    FLOAT_TYPE length, prec;
+    FLOAT_TYPE length, box_y, box_z, prec;
     int npart;
     FLOAT_TYPE charge;
     int form_factor;
@@ -113,6 +120,7 @@ int main ( int argc, char **argv ) {
     int inhomo_error_cao = 5;
     int inhomo_mc = 0;
     char *inhomo_output = NULL;
+    char *fftw_rigor = NULL;
 
     FLOAT_TYPE error_k=0.0, ewald_error_k_est, estimate=0.0, error_k_est = 0;
     int i,j, calc_k_error, calc_est;
@@ -125,6 +133,17 @@ int main ( int argc, char **argv ) {
 
     cmd_parameters_t params = { NULL, 0, NULL, 0 };
 
+#ifdef P3M_MPI
+    int rank;
+
+    /* All ranks run the whole program on the same system, only the
+       first one reports. */
+    MPI_Init( &argc, &argv );
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+    if( ( rank != 0 ) && ( freopen( "/dev/null", "w", stdout ) == NULL ) )
+      fprintf( stderr, "Rank %d could not silence stdout.\n", rank );
+#endif
+
     add_param( "rcut", ARG_TYPE_FLOAT, ARG_REQUIRED, &(parameters.rcut), &params );
     add_param( "alphamin", ARG_TYPE_FLOAT, ARG_OPTIONAL, &alphamin, &params );
     add_param( "alphamax", ARG_TYPE_FLOAT, ARG_OPTIONAL, &alphamax, &params );
@@ -138,10 +157,25 @@ int main ( int argc, char **argv ) {
     add_param( "method", ARG_TYPE_INT, ARG_REQUIRED, &methodnr, &params );
     add_param( "mc", ARG_TYPE_INT, ARG_OPTIONAL, &P3M_BRILLOUIN, &params );
     add_param( "mc_est", ARG_TYPE_INT, ARG_OPTIONAL, &P3M_BRILLOUIN_TUNING, &params );
+    add_param( "ca_direct", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "reorder", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "padded_mesh", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "ca_separable", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "mesh_float", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "incremental", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "alpha_sweep", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
+    add_param( "inc_threshold", ARG_TYPE_FLOAT, ARG_OPTIONAL, &P3M_INC_THRESHOLD, &params );
+    add_param( "linked_cells_min", ARG_TYPE_INT, ARG_OPTIONAL, &P3M_LINKED_CELLS_MIN, &params );
+    add_param( "verlet_skin", ARG_TYPE_FLOAT, ARG_OPTIONAL, &P3M_VERLET_SKIN, &params );
+    add_param( "realspace_table", ARG_TYPE_INT, ARG_OPTIONAL, &P3M_REALSPACE_TABLE, &params );
+    add_param( "wisdom", ARG_TYPE_STRING, ARG_OPTIONAL, &P3M_WISDOM_DIR, &params );
+    add_param( "fftw_rigor", ARG_TYPE_STRING, ARG_OPTIONAL, &fftw_rigor, &params );
     add_param( "no_estimate", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
     add_param( "outfile", ARG_TYPE_STRING, ARG_OPTIONAL, &out_file, &params );
     add_param( "particles", ARG_TYPE_INT, ARG_OPTIONAL, &npart, &params );
     add_param( "box", ARG_TYPE_FLOAT, ARG_OPTIONAL, &length, &params );
+    add_param( "box_y", ARG_TYPE_FLOAT, ARG_OPTIONAL, &box_y, &params );
+    add_param( "box_z", ARG_TYPE_FLOAT, ARG_OPTIONAL, &box_z, &params );
     add_param( "tune", ARG_TYPE_NONE, ARG_OPTIONAL, NULL, &params );
     add_param( "prec", ARG_TYPE_FLOAT, ARG_OPTIONAL, &prec, &params );
     add_param( "reference_out", ARG_TYPE_STRING, ARG_OPTIONAL, &ref_out, &params );
@@ -179,6 +213,20 @@ int main ( int argc, char **argv ) {
     if(param_isset("no_estimate", params) == 1)
       calc_est = 1;
 
+    P3M_CA_DIRECT = param_isset("ca_direct", params);
+    P3M_REORDER = param_isset("reorder", params);
+    P3M_PADDED_MESH = param_isset("padded_mesh", params);
+    P3M_CA_SEPARABLE = param_isset("ca_separable", params);
+    P3M_MESH_FLOAT = param_isset("mesh_float", params);
+    P3M_INCREMENTAL = param_isset("incremental", params);
+    P3M_ALPHA_SWEEP = param_isset("alpha_sweep", params);
+    P3M_VERLET_LISTS = param_isset("verlet_lists", params);
+
+    if(param_isset("fftw_rigor", params) && !Wisdom_set_rigor(fftw_rigor)) {
+      puts("fftw_rigor has to be one of estimate, measure, patient or exhaustive.");
+      exit(1);
+    }
+
     parameters.cao3 = parameters.cao*parameters.cao*parameters.cao;
     parameters.ip = parameters.cao - 1;
     parameters.alpha = 0.0;
@@ -221,6 +269,14 @@ int main ( int argc, char **argv ) {
       puts("Done.");
     }
 
+    /* Non-cubic box, box is the x length then */
+    if( param_isset("box_y", params) || param_isset("box_z", params)) {
+      Resize_box( system, system->box_l[0],
+		  param_isset("box_y", params) ? box_y : system->box_l[1],
+		  param_isset("box_z", params) ? box_z : system->box_l[2] );
+      printf("Box %lf x %lf x %lf\n", FLOAT_CAST system->box_l[0], FLOAT_CAST system->box_l[1], FLOAT_CAST system->box_l[2]);
+    }
+
     /* inhomo_error(system, NULL, 100); */
 
     if( param_isset("vtf_file", params) == 1) 
@@ -337,6 +393,14 @@ int main ( int argc, char **argv ) {
 #ifdef P3M_AD_R_H
     else if ( methodnr == method_p3m_ad_r.method_id )
         method = method_p3m_ad_r;
+#endif
+#ifdef P3M_IK_REAL_PACKED_H
+    else if ( methodnr == method_p3m_ik_r_p.method_id )
+        method = method_p3m_ik_r_p;
+#endif
+#ifdef P3M_IK_MPI_H
+    else if ( methodnr == method_p3m_ik_mpi.method_id )
+        method = method_p3m_ik_mpi;
 #endif
     else {
         fprintf ( stderr, "Method %d not know.", methodnr );
@@ -348,8 +412,18 @@ int main ( int argc, char **argv ) {
         exit ( -1 );
     }
 
+    if ( !Box_is_cubic ( system ) && !( method.flags & METHOD_FLAG_noncubic ) ) {
+        fprintf ( stderr, "Method '%s' only supports cubic boxes.\n", method.method_name );
+        exit ( 126 );
+    }
+
     fprintf ( stderr, "Using %s.\n", method.method_name );
 
+#ifdef P3M_MPI
+    if( rank != 0 )
+      fout = fopen ( "/dev/null", "w" );
+    else
+#endif
     if(param_isset("outfile", params) == 1) {
       fout = fopen ( out_file, "w" );      
     } else {
@@ -384,6 +458,13 @@ int main ( int argc, char **argv ) {
 	Calculate_forces ( &method, system, &parameters, data, forces ); /* Hockney/Eastwood */
 
 	walltime = wtime() - walltime;
+
+#ifdef P3M_IK_MPI_H
+	/* The ranks only have the forces of their particles, collect them
+	   on rank 0 for the error calculation. */
+	if ( method.method_id == METHOD_P3M_ik_mpi )
+	  Gather_forces_ik_mpi ( system, data, forces );
+#endif
       }
       error_k =0.0;
       if(calc_k_error == 1) {
@@ -441,6 +522,10 @@ int main ( int argc, char **argv ) {
 	
 	FLOAT_TYPE rs_error = Realspace_error( system, &parameters );
 
+	FLOAT_TYPE table_error = Realspace_table_error( system, &parameters );
+	if(table_error > 0.0)
+	  printf ( "# realspace table error %e\n", FLOAT_CAST table_error );
+
 	/* printf("Q_uncorr %e, Q_corr %e, Q_nonfluc %e\n", Q_uncorr, Q_corr, Q_nonfluc); */
 
 	printf ( "%8lf\t%8e\t%8e\t %8e %8e\t %8e sec\t %8e %8e\n", FLOAT_CAST parameters.alpha, FLOAT_CAST (error.f / SQRT(system->nparticles)) , FLOAT_CAST estimate,
@@ -465,6 +550,17 @@ int main ( int argc, char **argv ) {
     }
     fclose ( fout );
 
+    /* Before MPI_Finalize, the distributed methods free communicators */
+    Free_data ( data );
+    Free_data ( data_ewald );
+    Free_aliasing_tables();
+    Free_pair_table();
+    Free_realspace_dd();
+
+#ifdef P3M_MPI
+    MPI_Finalize();
+#endif
+
     return 0;
 }
 
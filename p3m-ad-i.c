@@ -27,6 +27,7 @@
 #include "charge-assign.h"
 
 #include "common.h"
+#include "wisdom.h"
 
 #include "realpart.h"
 
@@ -59,9 +60,9 @@ data_t *Init_ad_i ( system_t *s, parameters_t *p ) {
     d->forward_plans = 1;
     d->backward_plans = 1;
 
-    d->forward_plan[0] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD, FFTW_PATIENT );
+    d->forward_plan[0] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD );
 
-    d->backward_plan[0] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Qmesh ), ( FFTW_COMPLEX * ) ( d->Qmesh ), FFTW_BACKWARD, FFTW_PATIENT );
+    d->backward_plan[0] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Qmesh ), ( FFTW_COMPLEX * ) ( d->Qmesh ), FFTW_BACKWARD );
 
     return d;
 }
@@ -70,83 +71,56 @@ data_t *Init_ad_i ( system_t *s, parameters_t *p ) {
 void Aliasing_sums_ad_i(int NX, int NY, int NZ, system_t *s, parameters_t *p, data_t *d,
 				 FLOAT_TYPE *Zaehler, FLOAT_TYPE *Nenner1, FLOAT_TYPE *Nenner2, FLOAT_TYPE *Nenner3, FLOAT_TYPE *Nenner4)
 {
-  FLOAT_TYPE S1,S2,S3;
-  FLOAT_TYPE fak1,fak2,zwi;
-  int    MX,MY,MZ;
-  FLOAT_TYPE NMX,NMY,NMZ;
-  FLOAT_TYPE NM2;
-  FLOAT_TYPE expo, TE;
-  FLOAT_TYPE Leni = 1.0/s->length;  
-
-  int Mesh = p->mesh;
-
-  fak1 = 1.0/(FLOAT_TYPE)Mesh;
-  fak2 = SQR( PI/ p->alpha );
-
-  *Zaehler = *Nenner1 = *Nenner2 = *Nenner3 = *Nenner4 = 0.0;
-
-  for (MX = -P3M_BRILLOUIN; MX <= P3M_BRILLOUIN; MX++) {
-    NMX = d->nshift[NX] + Mesh*MX;
-    S1   = my_power(sinc(fak1*NMX), 2*p->cao); 
-    for (MY = -P3M_BRILLOUIN; MY <= P3M_BRILLOUIN; MY++) {
-      NMY = d->nshift[NY] + Mesh*MY;
-      S2   = S1*my_power(sinc(fak1*NMY), 2*p->cao);
-      for (MZ = -P3M_BRILLOUIN; MZ <= P3M_BRILLOUIN; MZ++) {
-	NMZ = d->nshift[NZ] + Mesh*MZ;
-	S3   = S2*my_power(sinc(fak1*NMZ), 2*p->cao);
+  const aliasing_table_t *t;
+  const int nm = 2*d->alias[0]->mc+1;
+  const int n[3] = { d->nshift_axis[0][NX], d->nshift_axis[1][NY], d->nshift_axis[2][NZ] };
+  const FLOAT_TYPE *u;
+  FLOAT_TYPE k[3][nm], e[3][nm];
+  /* per axis sums of u, u k^2, u e and the sums with alternating sign */
+  FLOAT_TYPE U[3], UK[3], UE[3], V[3], VK[3];
+  FLOAT_TYPE sign;
+  int i, m;
+
+  /* All sums factorize over the axes, the sign (-1)^(MX+MY+MZ) too. */
+  for (i = 0; i < 3; i++) {
+    t = d->alias[i];
+    Aliasing_factors(p, t, s->box_l[i], n[i], k[i], e[i]);
+    u = t->sinc2 + Aliasing_row(t, n[i]);
+    U[i] = UK[i] = UE[i] = V[i] = VK[i] = 0.0;
+    for (m = 0; m < nm; m++) {
+      sign = ((m - t->mc) % 2 == 0) ? 1.0 : -1.0;
+      U[i] += u[m];
+      UK[i] += u[m]*SQR(k[i][m]);
+      UE[i] += u[m]*e[i][m];
+      V[i] += sign*u[m];
+      VK[i] += sign*u[m]*SQR(k[i][m]);
+    }
+  }
 
-	NM2 = SQR(NMX*Leni) + SQR(NMY*Leni) + SQR(NMZ*Leni);
+  *Nenner1 = U[0]*U[1]*U[2];
+  *Nenner2 = UK[0]*U[1]*U[2] + U[0]*UK[1]*U[2] + U[0]*U[1]*UK[2];
+  *Nenner3 = V[0]*V[1]*V[2];
+  *Nenner4 = VK[0]*V[1]*V[2] + V[0]*VK[1]*V[2] + V[0]*V[1]*VK[2];
+  *Zaehler = UE[0]*UE[1]*UE[2];
+}
 
-	*Nenner1 += S3;
-	*Nenner2 += S3 * NM2;
+/* Influence function at one mesh point */
+static FLOAT_TYPE influence_function_ad_i( system_t *s, parameters_t *p, data_t *d, int NX, int NY, int NZ )
+{
+  FLOAT_TYPE Zaehler=0.0,Nenner1=0.0, Nenner2=0.0, Nenner3=0.0, Nenner4=0.0;
 
-        if(((MX + MY + MZ) % 2) == 0) {
-	  *Nenner3 += S3;
-	  *Nenner4 += S3 * NM2;
-	} else {
-	  *Nenner3 -= S3;
-	  *Nenner4 -= S3 * NM2;
-	}
+  if ((NX==0) && (NY==0) && (NZ==0))
+    return 0.0;
 
-	expo = fak2*NM2;
-	TE = exp(-expo);
-	zwi  = S3 * TE;
-        *Zaehler += zwi;
+  Aliasing_sums_ad_i( NX, NY, NZ, s, p, d, &Zaehler, &Nenner1, &Nenner2, &Nenner3, &Nenner4);
 
-      }
-    }
-  }
+  return Zaehler / ( 0.5 * PI * (Nenner1 * Nenner2 + Nenner3 * Nenner4 ));
 }
 
 void Influence_function_ad_i( system_t *s, parameters_t *p, data_t *d )
 {
-  int    NX,NY,NZ;
-  FLOAT_TYPE Zaehler=0.0,Nenner1=0.0, Nenner2=0.0, Nenner3=0.0, Nenner4=0.0;
-  int ind = 0;
-  int Mesh= d->mesh;
-
-#ifdef _OPENMP
-#pragma omp parallel for private(NZ, ind, Zaehler, Nenner1, Nenner2, Nenner3, Nenner4) collapse(3)
-#endif
-  for (NX=0; NX<Mesh; NX++)
-    {
-      for (NY=0; NY<Mesh; NY++)
-	{
-	  for (NZ=0; NZ<Mesh; NZ++)
-	    {
-              ind = r_ind(NX,NY,NZ);
-
-	      if ((NX==0) && (NY==0) && (NZ==0))
-		d->G_hat[ind]=0.0;
-	      else
-		{
-		  Aliasing_sums_ad_i( NX, NY, NZ, s, p, d, &Zaehler, &Nenner1, &Nenner2, &Nenner3, &Nenner4);
-                   
-		  d->G_hat[ind] = Zaehler / ( 0.5 * PI * (Nenner1 * Nenner2 + Nenner3 * Nenner4 ));
-		}
-	    }
-	}
-    }
+  Set_aliasing_tables(d, p->cao, NULL);
+  Influence_function_symmetric( s, p, d, &influence_function_ad_i );
 }
 
 
@@ -160,20 +134,26 @@ void P3M_ad_i( system_t *s, parameters_t *p, data_t *d, forces_t *f )
   int Mesh = p->mesh;
   FLOAT_TYPE Leni = 1.0 / s->length;
 
-  /* Set Qmesh to zero */
-  memset(d->Qmesh, 0, 2*Mesh*Mesh*Mesh * sizeof(FLOAT_TYPE));
+  if ( Charge_mesh_cache_load ( d ) ) {
+    TIMING_START_G
+  } else {
+    /* Set Qmesh to zero */
+    memset(d->Qmesh, 0, 2*Mesh*Mesh*Mesh * sizeof(FLOAT_TYPE));
+
+    TIMING_START_C
 
-  TIMING_START_C
+    /* chargeassignment */
+    assign_charge_and_derivatives( s, p, d, 0);
+    assign_charge_and_derivatives( s, p, d, 1);
 
-  /* chargeassignment */
-  assign_charge_and_derivatives( s, p, d, 0);
-  assign_charge_and_derivatives( s, p, d, 1);
+    TIMING_STOP_C
+    TIMING_START_G
 
-  TIMING_STOP_C
-  TIMING_START_G
+    /* Forward Fast Fourier Transform */
+    forward_fft(d);
 
-  /* Forward Fast Fourier Transform */
-  forward_fft(d);
+    Charge_mesh_cache_store ( d );
+  }
 
   for (i=0; i<Mesh; i++)
     for (j=0; j<Mesh; j++)
@@ -203,50 +183,57 @@ void P3M_ad_i( system_t *s, parameters_t *p, data_t *d, forces_t *f )
 }
 
 void P3M_tune_aliasing_sums_AD_interlaced(int nx, int ny, int nz, 
-					  system_t *s, parameters_t *p,
+					  system_t *s, parameters_t *p, const aliasing_table_t *t,
 					  FLOAT_TYPE *alias1, FLOAT_TYPE *alias2, FLOAT_TYPE *alias3,FLOAT_TYPE *alias4,
 					  FLOAT_TYPE *alias5,FLOAT_TYPE *alias6)
 {
-
+  const int nm = 2*t->mc+1;
+  const FLOAT_TYPE *nmx = t->nm + Aliasing_row(t, nx);
+  const FLOAT_TYPE *nmy = t->nm + Aliasing_row(t, ny);
+  const FLOAT_TYPE *nmz = t->nm + Aliasing_row(t, nz);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
+  FLOAT_TYPE k[nm], ex[nm], ey[nm], ez[nm];
+  FLOAT_TYPE S2, E2, N2, U2, ex3, nm2;
+  FLOAT_TYPE a1 = 0.0, a2 = 0.0, a3 = 0.0, a4 = 0.0, a5 = 0.0, a6 = 0.0;
   int    mx,my,mz;
-  FLOAT_TYPE nmx,nmy,nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
-
-  FLOAT_TYPE ex,ex2,nm2,U2,factor1;
 
-  int mesh = p->mesh;
-  FLOAT_TYPE mesh_i = 1.0/mesh;
-
-  factor1 = SQR(PI / ( p->alpha * s->length ) );
-
-  *alias1 = *alias2 = *alias3 = *alias4 = *alias5 = *alias6 = 0.0;
-  for (mx=-P3M_BRILLOUIN_TUNING; mx<=P3M_BRILLOUIN_TUNING; mx++) {
-    fnmx = mesh_i * (nmx = nx + mx*mesh);
-    for (my=-P3M_BRILLOUIN_TUNING; my<=P3M_BRILLOUIN_TUNING; my++) {
-      fnmy = mesh_i * (nmy = ny + my*mesh);
-      for (mz=-P3M_BRILLOUIN_TUNING; mz<=P3M_BRILLOUIN_TUNING; mz++) {
-	fnmz = mesh_i * (nmz = nz + mz*mesh);
-	
-	nm2 = SQR(nmx) + SQR(nmy) + SQR(nmz);
-	ex = exp(-factor1*nm2);
-	ex2 = SQR( ex );
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
-
-	*alias1 += ex2 / nm2;
-	*alias2 += U2 * ex;
-	*alias3 += U2 * nm2;
-	*alias4 += U2;
-	
-        if (((mx+my+mz)%2)==0) {					//even term
-	   *alias5 += U2 * nm2;
-	   *alias6 += U2;
+  Aliasing_factors(p, t, s->length, nx, k, ex);
+  Aliasing_factors(p, t, s->length, ny, k, ey);
+  Aliasing_factors(p, t, s->length, nz, k, ez);
+
+  for (mx = 0; mx < nm; mx++) {
+    for (my = 0; my < nm; my++) {
+      S2 = ux[mx]*uy[my];
+      E2 = ex[mx]*ey[my];
+      N2 = SQR(nmx[mx]) + SQR(nmy[my]);
+      for (mz = 0; mz < nm; mz++) {
+	nm2 = N2 + SQR(nmz[mz]);
+	ex3 = E2*ez[mz];
+	U2 = S2*uz[mz];
+
+	a1 += SQR(ex3) / nm2;
+	a2 += U2 * ex3;
+	a3 += U2 * nm2;
+	a4 += U2;
+
+        if (((mx+my+mz+3*t->mc)%2)==0) {			//even term
+	   a5 += U2 * nm2;
+	   a6 += U2;
 	 } else {						//odd term: minus sign!
-	   *alias5 -= U2 * nm2;
-	   *alias6 -= U2;
+	   a5 -= U2 * nm2;
+	   a6 -= U2;
 	 }
       }
     }
   }
+  *alias1 = a1;
+  *alias2 = a2;
+  *alias3 = a3;
+  *alias4 = a4;
+  *alias5 = a5;
+  *alias6 = a6;
 }
 
 FLOAT_TYPE p3m_k_space_error_ad_i( system_t *s, parameters_t *p )
@@ -261,6 +248,7 @@ FLOAT_TYPE p3m_k_space_error_ad_i( system_t *s, parameters_t *p )
   // he_q = p3m_find_error(p->alpha*s->length, mesh, p->cao, 3);
 
   if(1) {
+    const aliasing_table_t *t = Aliasing_table(mesh, p->cao, P3M_BRILLOUIN_TUNING, NULL);
 
 #ifdef _OPENMP
 #pragma omp parallel for private(ny,nz,alias1, alias2, alias3, alias4,alias5, alias6) reduction(+ : he_q)
@@ -269,7 +257,7 @@ FLOAT_TYPE p3m_k_space_error_ad_i( system_t *s, parameters_t *p )
       for (ny=-mesh/2; ny<mesh/2; ny++) {
 	for (nz=-mesh/2; nz<mesh/2; nz++) {
 	  if((nx!=0) && (ny!=0) && (nz!=0)) {
-	    P3M_tune_aliasing_sums_AD_interlaced(nx,ny,nz,s,p,&alias1,&alias2,&alias3,&alias4,&alias5,&alias6);
+	    P3M_tune_aliasing_sums_AD_interlaced(nx,ny,nz,s,p,t,&alias1,&alias2,&alias3,&alias4,&alias5,&alias6);
 	    he_q += (alias1  -  SQR(alias2) / (0.5*(alias3*alias4 + alias5*alias6)));
 	  }
 	}
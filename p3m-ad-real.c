@@ -25,6 +25,7 @@
 #include "charge-assign.h"
 #include "p3m-ad-real.h"
 #include "common.h"
+#include "wisdom.h"
 #include "p3m-ad-self-forces.h"
 
 #include "p3m-ad.h"
@@ -37,7 +38,7 @@
 
 
 const method_t method_p3m_ad_r = { METHOD_P3M_ad_r, "P3M with analytic differentiation, not intelaced, real input.", "p3m-ad-r",
-				 METHOD_FLAG_P3M | METHOD_FLAG_ad | METHOD_FLAG_self_force_correction, 
+				 METHOD_FLAG_P3M | METHOD_FLAG_ad | METHOD_FLAG_self_force_correction | METHOD_FLAG_r2c,
 				 &Init_ad_r, &Influence_function_berechnen_ad, &P3M_ad_r, &Error_ad, &p3m_k_space_error_ad };
 
 static void forward_fft( data_t *d );
@@ -59,9 +60,9 @@ data_t *Init_ad_r ( system_t *s, parameters_t *p ) {
     d->forward_plans = 1;
     d->backward_plans = 1;
 
-    d->forward_plan[0] = FFTW_PLAN_DFT_R2C_3D ( mesh, mesh, mesh, d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_PATIENT );
+    d->forward_plan[0] = Wisdom_plan_dft_r2c_3d ( mesh, mesh, mesh, d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh );
 
-    d->backward_plan[0] = FFTW_PLAN_DFT_C2R_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Qmesh ),  d->Qmesh,  FFTW_PATIENT );
+    d->backward_plan[0] = Wisdom_plan_dft_c2r_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Qmesh ),  d->Qmesh );
 
     return d;
 }
@@ -70,35 +71,38 @@ void P3M_ad_r( system_t *s, parameters_t *p, data_t *d, forces_t *f )
 {
   
   /* Loop counters */
-  int i, j, k, c_index; 
+  int i;
   /* Helper variables */
   FLOAT_TYPE T1;
   FLOAT_TYPE Leni = 1.0/s->length;
   int Mesh = p->mesh;
   
-  memset(d->Qmesh, 0, 2*Mesh*Mesh*Mesh * sizeof(FLOAT_TYPE));
+  if ( Charge_mesh_cache_load ( d ) ) {
+    TIMING_START_G
+  } else {
+    memset(d->Qmesh, 0, 2*Mesh*Mesh*Mesh * sizeof(FLOAT_TYPE));
 
-  TIMING_START_C
+    TIMING_START_C
   
-  /* chargeassignment */
-  assign_charge_and_derivatives_real( s, p, d);
+    /* chargeassignment */
+    assign_charge_and_derivatives_real( s, p, d);
 
-  TIMING_STOP_C
-  TIMING_START_G
+    TIMING_STOP_C
+    TIMING_START_G
   
-  /* Forward Fast Fourier Transform */
-  forward_fft(d);
-
-  for (i=0; i<Mesh; i++)
-    for (j=0; j<Mesh; j++)
-      for (k=0; k<(Mesh/2+1); k++)
-	{
-          c_index = 2*(Mesh*(Mesh/2+1) * i + (Mesh/2+1)*j + k);
-
-	  T1 = d->G_hat[r_ind(i,j,k)];
-	  d->Qmesh[c_index] *= T1;
-	  d->Qmesh[c_index+1] *= T1;
-	}
+    /* Forward Fast Fourier Transform */
+    forward_fft(d);
+
+    Charge_mesh_cache_store ( d );
+  }
+
+  /* G_hat has the layout of the half spectrum */
+  for (i=0; i<Mesh*Mesh*(Mesh/2+1); i++)
+    {
+      T1 = d->G_hat[i];
+      d->Qmesh[2*i] *= T1;
+      d->Qmesh[2*i+1] *= T1;
+    }
 
   /* Backward FFT */
   backward_fft(d);
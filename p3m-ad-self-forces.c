@@ -19,6 +19,8 @@
 #include "p3m-ad-self-forces.h"
 
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 /* This is an implementation of equation (9) of
    V. Ballenegger et al., Computer Physics Communications 182(2011)
@@ -31,51 +33,46 @@ FLOAT_TYPE P3M_k_space_calc_self_force( system_t *s, parameters_t *p, data_t *d,
 					int m1, int m2, int m3, int dir)
 { 
   int nx, ny, nz;
-  int mx, my, mz;
-  //  int[3] n;
+  int mx, dim;
   int mesh = p->mesh;
-  int true_nx,true_ny,true_nz;
+  const int shift[3] = { m1, m2, m3 };
   FLOAT_TYPE theSumOverK = 0.0, mesh_i = 1./mesh;
-  FLOAT_TYPE U,U_shiftx;
+  FLOAT_TYPE G_hat, true_n;
   int P3M_BRILLOUIN_LOCAL = P3M_SELF_BRILLOUIN;
-  FLOAT_TYPE G_hat;
+  /* The sum over the images factorizes over the axes,
+     W[dim][n] = sum_m U(n + m mesh) U(n + (m + shift[dim]) mesh)
+     with the one dimensional window U. */
+  FLOAT_TYPE *W = (FLOAT_TYPE *)Init_array(3*mesh, sizeof(FLOAT_TYPE));
 
   SF_TRACE(puts("P3M_k_space_calc_self_force()"));
 
+  for(dim=0; dim<3; dim++)
+    for(nx=0; nx<mesh; nx++) {
+      true_n = d->nshift[nx];
+      for (mx=-P3M_BRILLOUIN_LOCAL; mx<=P3M_BRILLOUIN_LOCAL; mx++)
+	W[dim*mesh + nx] += pow(sinc(mesh_i * (true_n + mx*mesh)), p->cao) *
+	  pow(sinc(mesh_i * (true_n + (mx+shift[dim])*mesh)), p->cao);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(G_hat) reduction( + : theSumOverK ) collapse(3) schedule(static)
+#endif
   for(nx=0; nx<mesh; nx++) 
     for(ny=0; ny<mesh; ny++) 
       for(nz=0; nz<mesh; nz++) {
-	G_hat = d->G_hat[r_ind(nx, ny, nz)];
+	G_hat = d->G_hat[g_ind(nx, ny, nz)];
 	if(G_hat == 0.0)
 	  continue;
-	true_nx = d->nshift[nx];
-	true_ny = d->nshift[ny];
-	true_nz = d->nshift[nz];
-	//	printf("n[] = (%d %d %d), true_n[] = (%d %d %d)\n", nx, ny, nz, true_nx, true_ny, true_nz);
-	#ifdef _OPENMP
-#pragma omp parallel for private(U, U_shiftx) reduction( + : theSumOverK ) collapse(3)
-#endif
-	for (mx=-P3M_BRILLOUIN_LOCAL; mx<=P3M_BRILLOUIN_LOCAL; mx++) {
-	  for (my=-P3M_BRILLOUIN_LOCAL; my<=P3M_BRILLOUIN_LOCAL; my++) {
-	    for (mz=-P3M_BRILLOUIN_LOCAL; mz<=P3M_BRILLOUIN_LOCAL; mz++) {
-	      U = pow(sinc(mesh_i * (true_nx + mx*mesh))*sinc(mesh_i * (true_ny  + my*mesh))*sinc(mesh_i * (true_nz + mz*mesh)), p->cao);
-	      U_shiftx = pow(sinc(mesh_i * (true_nx + (mx+m1)*mesh))*sinc(mesh_i * (true_ny + (my+m2)*mesh))*sinc(mesh_i * (true_nz + (mz+m3)*mesh)), p->cao);
-
-	      theSumOverK += G_hat * U * U_shiftx;
-
-	      /* printf("%d %d %d: U %e U_shiftx %e G_hat() %e\n theSumOverK %e\n", nx, ny, nz, FLOAT_CAST U, U_shiftx, FLOAT_CAST d->G_hat[c_ind( nx, ny, nz)],  FLOAT_CAST theSumOverK); */
-	      if(isnan(theSumOverK)) {
-		printf("%d %d %d is nan\n", m1, m2, m3);
-		exit(0);
-	      }
-	    }
-	  }
-	}
-#ifdef _OPENMP
-#pragma omp barrier
-#endif
+	theSumOverK += G_hat * W[nx] * W[mesh + ny] * W[2*mesh + nz];
       }
- 
+
+  Free_array(W);
+
+  if(isnan(theSumOverK)) {
+    printf("%d %d %d is nan\n", m1, m2, m3);
+    exit(0);
+  }
+
   switch(dir) {
   case 0:
     return (PI*m1*p->mesh) / SQR(SQR(s->length)) * theSumOverK;
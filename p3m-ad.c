@@ -25,6 +25,7 @@
 #include "charge-assign.h"
 #include "p3m-ad.h"
 #include "common.h"
+#include "wisdom.h"
 #include "p3m-ad-self-forces.h"
 
 #include "realpart.h"
@@ -59,9 +60,12 @@ data_t *Init_ad ( system_t *s, parameters_t *p ) {
     d->forward_plans = 1;
     d->backward_plans = 1;
 
-    d->forward_plan[0] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD, FFTW_PATIENT );
+    d->forward_plan[0] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD );
 
-    d->backward_plan[0] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Qmesh ), ( FFTW_COMPLEX * ) ( d->Qmesh ), FFTW_BACKWARD, FFTW_PATIENT );
+    d->backward_plan[0] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Qmesh ), ( FFTW_COMPLEX * ) ( d->Qmesh ), FFTW_BACKWARD );
+
+    if ( P3M_INCREMENTAL )
+      Init_charge_incremental ( s, d );
 
     return d;
 }
@@ -69,87 +73,58 @@ data_t *Init_ad ( system_t *s, parameters_t *p ) {
 void Aliasing_sums_ad(int NX, int NY, int NZ, system_t *s, parameters_t *p, data_t *d,
 		      FLOAT_TYPE *Zaehler, FLOAT_TYPE *Nenner1, FLOAT_TYPE *Nenner2)
 {
-  FLOAT_TYPE S1,S2,S3;
-  FLOAT_TYPE fak1,fak2,zwi;
-  int    MX,MY,MZ;
-  FLOAT_TYPE NMX,NMY,NMZ;
-  FLOAT_TYPE NM2;
-  FLOAT_TYPE expo, TE;
-  int Mesh = p->mesh;
-  FLOAT_TYPE Len = s->length;
-  FLOAT_TYPE Leni = 1.0/Len;
-
-  fak1 = 1.0/(FLOAT_TYPE)Mesh;
-  fak2 = SQR(PI/p->alpha);
-
-  *Zaehler = *Nenner1 = *Nenner2 = 0.0;
+  const int nm = 2*d->alias[0]->mc+1;
+  const int n[3] = { d->nshift_axis[0][NX], d->nshift_axis[1][NY], d->nshift_axis[2][NZ] };
+  const FLOAT_TYPE *u;
+  FLOAT_TYPE k[3][nm], e[3][nm];
+  /* per axis sums of u, u k^2 and u e */
+  FLOAT_TYPE U[3], UK[3], UE[3];
+  int i, m;
+
+  /* All three sums factorize over the axes. */
+  for (i = 0; i < 3; i++) {
+    Aliasing_factors(p, d->alias[i], s->box_l[i], n[i], k[i], e[i]);
+    u = d->alias[i]->sinc2 + Aliasing_row(d->alias[i], n[i]);
+    U[i] = UK[i] = UE[i] = 0.0;
+    for (m = 0; m < nm; m++) {
+      U[i] += u[m];
+      UK[i] += u[m]*SQR(k[i][m]);
+      UE[i] += u[m]*e[i][m];
+    }
+  }
 
-  for (MX = -P3M_BRILLOUIN; MX <= P3M_BRILLOUIN; MX++) {
-    NMX = d->nshift[NX] + Mesh*MX;
-    S1   = my_power(sinc(fak1*NMX), 2*p->cao); 
-    for (MY = -P3M_BRILLOUIN; MY <= P3M_BRILLOUIN; MY++) {
-      NMY = d->nshift[NY] + Mesh*MY;
-      S2   = S1*my_power(sinc(fak1*NMY), 2*p->cao);
-      for (MZ = -P3M_BRILLOUIN; MZ <= P3M_BRILLOUIN; MZ++) {
-	NMZ = d->nshift[NZ] + Mesh*MZ;
-	S3   = S2*my_power(sinc(fak1*NMZ), 2*p->cao);
+  *Nenner1 = U[0]*U[1]*U[2];
+  *Nenner2 = UK[0]*U[1]*U[2] + U[0]*UK[1]*U[2] + U[0]*U[1]*UK[2];
+  *Zaehler = UE[0]*UE[1]*UE[2];
+}
 
-	NM2 = SQR(NMX*Leni) + SQR(NMY*Leni) + SQR(NMZ*Leni);
+/* Influence function at one mesh point */
+static FLOAT_TYPE influence_function_ad( system_t *s, parameters_t *p, data_t *d, int NX, int NY, int NZ )
+{
+  FLOAT_TYPE Zaehler=0.0,Nenner1=0.0, Nenner2=0.0;
+  FLOAT_TYPE G;
 
-	*Nenner1 += S3;
-	*Nenner2 += S3 * NM2;
+  if ((NX==0) && (NY==0) && (NZ==0))
+    return 0.0;
 
-	expo = fak2*NM2;
-	TE = EXP(-expo);
-	zwi  = S3 * TE;
-        *Zaehler += zwi;
-      }
-    }
-  }
+  Aliasing_sums_ad(NX,NY,NZ,s,p,d,&Zaehler,&Nenner1, &Nenner2);
+  G = Zaehler / ( PI * Nenner1 * Nenner2 );
+  assert(!isnan(G));
+  return G;
 }
 
 void Influence_function_berechnen_ad( system_t *s, parameters_t *p, data_t *d )
 {
-
-  int    NX,NY,NZ;
-  FLOAT_TYPE Zaehler=0.0,Nenner1=0.0, Nenner2=0.0;
-
-  int ind = 0;
   int Mesh = p->mesh;
 
   if(p->alpha == 0.0) {
-    memset(d->G_hat, 0, Mesh*Mesh*Mesh*sizeof(FLOAT_TYPE));
+    memset(d->G_hat, 0, Mesh*Mesh*d->G_hat_nz*sizeof(FLOAT_TYPE));
     return;
   }
-  /* bei Zahlen >= Mesh/2 wird noch Mesh abgezogen! */
-#ifdef _OPENMP
-#pragma omp parallel for private(ind, Zaehler, Nenner1, Nenner2) collapse(3)
-#endif
-  for (NX=0; NX<Mesh; NX++)
-    {
-      for (NY=0; NY<Mesh; NY++)
-	{
-	  for (NZ=0; NZ<Mesh; NZ++)
-	    {
-              ind = r_ind(NX,NY,NZ);
-
-	      if ((NX==0) && (NY==0) && (NZ==0))
-	 	d->G_hat[ind]=0.0;
-              /* else if ((NX%(Mesh/2) == 0) && (NY%(Mesh/2) == 0) && (NZ%(Mesh/2) == 0)) */
-              /*   d->G_hat[ind]=0.0; */
-	      else
-		{
-		  Aliasing_sums_ad(NX,NY,NZ,s,p,d,&Zaehler,&Nenner1, &Nenner2);
-		  d->G_hat[ind] = Zaehler / ( PI * Nenner1 * Nenner2 );
-		}
-	      assert(!isnan(d->G_hat[ind]));
-	    }
-	}
-    }
-  #ifdef _OPENMP
-  #pragma omp barrier
-  #endif
-  
+
+  Set_aliasing_tables(d, p->cao, NULL);
+  Influence_function_symmetric( s, p, d, &influence_function_ad );
+
   #ifdef P3M_AD_SELF_FORCES
   Init_self_forces( s, p, d);
   #else
@@ -168,18 +143,27 @@ void P3M_ad( system_t *s, parameters_t *p, data_t *d, forces_t *f )
   FLOAT_TYPE Leni = 1.0/s->length;
   int Mesh = p->mesh;
   
-  memset(d->Qmesh, 0, 2*Mesh*Mesh*Mesh * sizeof(FLOAT_TYPE));
-
-  TIMING_START_C
+  if ( Charge_mesh_cache_load ( d ) ) {
+    TIMING_START_G
+  } else {
+    TIMING_START_C
   
-  /* chargeassignment */
-  assign_charge_and_derivatives( s, p, d, 0);
+    /* chargeassignment */
+    if(d->Qmesh_inc != NULL) {
+      assign_charge_and_derivatives_incremental( s, p, d );
+    } else {
+      memset(d->Qmesh, 0, 2*Mesh*Mesh*Mesh * sizeof(FLOAT_TYPE));
+      assign_charge_and_derivatives( s, p, d, 0);
+    }
 
-  TIMING_STOP_C
-  TIMING_START_G
+    TIMING_STOP_C
+    TIMING_START_G
   
-  /* Forward Fast Fourier Transform */
-  forward_fft(d);
+    /* Forward Fast Fourier Transform */
+    forward_fft(d);
+
+    Charge_mesh_cache_store ( d );
+  }
 
   for (i=0; i<Mesh; i++)
     for (j=0; j<Mesh; j++)
@@ -225,22 +209,21 @@ void P3M_ad( system_t *s, parameters_t *p, data_t *d, forces_t *f )
 FLOAT_TYPE A_ad(int nx, int ny, int nz, system_t *s, parameters_t *p) {
   int mx, my, mz;
   int nmx, nmy, nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
   FLOAT_TYPE km2;
   FLOAT_TYPE U2, U2m = 0.0, U2km = 0.0;
-  FLOAT_TYPE mesh_i = 1.0/p->mesh;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN, NULL);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
 
   for (mx = -P3M_BRILLOUIN; mx <= P3M_BRILLOUIN; mx++) {
     nmx = nx + p->mesh*mx;
-    fnmx = nmx * mesh_i;
     for (my = -P3M_BRILLOUIN; my <= P3M_BRILLOUIN; my++) {
       nmy = ny + p->mesh*my;
-      fnmy = nmy * mesh_i;
       for (mz = -P3M_BRILLOUIN; mz <= P3M_BRILLOUIN; mz++) {
 	nmz = nz + p->mesh*mz;
-	fnmz = nmz * mesh_i;
 
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
+	U2 = ux[mx+t->mc]*uy[my+t->mc]*uz[mz+t->mc];
 	km2 = SQR(2.0*PI/s->length) * ( SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz ) );	
 
 	U2m += U2;
@@ -255,25 +238,24 @@ FLOAT_TYPE A_ad(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 FLOAT_TYPE B_ad(int nx, int ny, int nz, system_t *s, parameters_t *p) {
   int mx, my, mz;
   int nmx, nmy, nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
   FLOAT_TYPE km2;
   FLOAT_TYPE ret = 0.0;
   FLOAT_TYPE U2;
-  FLOAT_TYPE mesh_i = 1.0/p->mesh;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN, NULL);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
 
   for (mx = -P3M_BRILLOUIN; mx <= P3M_BRILLOUIN; mx++) {
     nmx = nx + p->mesh*mx;
-    fnmx = nmx * mesh_i;
     for (my = -P3M_BRILLOUIN; my <= P3M_BRILLOUIN; my++) {
       nmy = ny + p->mesh*my;
-      fnmy = nmy * mesh_i;
       for (mz = -P3M_BRILLOUIN; mz <= P3M_BRILLOUIN; mz++) {
 	nmz = nz + p->mesh*mz;
-	fnmz = nmz * mesh_i;
 
 	km2 = SQR(2.0*PI/s->length) * ( SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz ) );	
 
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
+	U2 = ux[mx+t->mc]*uy[my+t->mc]*uz[mz+t->mc];
 
 	ret += U2 * 4.0 * PI * EXP(- km2 / ( 4.0 * SQR(p->alpha)));
       }
@@ -286,24 +268,23 @@ FLOAT_TYPE B_ad(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 FLOAT_TYPE A_ad_dip(int nx, int ny, int nz, system_t *s, parameters_t *p) {
   int mx, my, mz;
   int nmx, nmy, nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
   FLOAT_TYPE km2;
   FLOAT_TYPE U2, U2m = 0.0, U2km = 0.0;
-  FLOAT_TYPE mesh_i = 1.0/p->mesh;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN, NULL);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
   FLOAT_TYPE d = 1.0;
   FLOAT_TYPE sin_term = 0.0, kmd;
 
   for (mx = -P3M_BRILLOUIN; mx <= P3M_BRILLOUIN; mx++) {
     nmx = nx + p->mesh*mx;
-    fnmx = nmx * mesh_i;
     for (my = -P3M_BRILLOUIN; my <= P3M_BRILLOUIN; my++) {
       nmy = ny + p->mesh*my;
-      fnmy = nmy * mesh_i;
       for (mz = -P3M_BRILLOUIN; mz <= P3M_BRILLOUIN; mz++) {
 	nmz = nz + p->mesh*mz;
-	fnmz = nmz * mesh_i;
 
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
+	U2 = ux[mx+t->mc]*uy[my+t->mc]*uz[mz+t->mc];
 	km2 = SQR(2.0*PI/s->length) * ( SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz ) );	
 	kmd = SQRT(km2)*d;
 
@@ -323,23 +304,22 @@ FLOAT_TYPE A_ad_dip(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 FLOAT_TYPE A_ad_water(int nx, int ny, int nz, system_t *s, parameters_t *p) {
   int mx, my, mz;
   int nmx, nmy, nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
   FLOAT_TYPE km2;
   FLOAT_TYPE U2, U2m = 0.0, U2km = 0.0;
-  FLOAT_TYPE mesh_i = 1.0/p->mesh;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN, NULL);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
   FLOAT_TYPE sin_term = 0.0, kmdHO, kmdHH;
 
   for (mx = -P3M_BRILLOUIN; mx <= P3M_BRILLOUIN; mx++) {
     nmx = nx + p->mesh*mx;
-    fnmx = nmx * mesh_i;
     for (my = -P3M_BRILLOUIN; my <= P3M_BRILLOUIN; my++) {
       nmy = ny + p->mesh*my;
-      fnmy = nmy * mesh_i;
       for (mz = -P3M_BRILLOUIN; mz <= P3M_BRILLOUIN; mz++) {
 	nmz = nz + p->mesh*mz;
-	fnmz = nmz * mesh_i;
 
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
+	U2 = ux[mx+t->mc]*uy[my+t->mc]*uz[mz+t->mc];
 	km2 = SQR(2.0*PI/s->length) * ( SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz ) );	
 	/* sin_term = 1.0; */
 
@@ -360,23 +340,22 @@ FLOAT_TYPE A_ad_water(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 FLOAT_TYPE B_ad_water(int nx, int ny, int nz, system_t *s, parameters_t *p) {
   int mx, my, mz;
   int nmx, nmy, nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
   FLOAT_TYPE km2;
   FLOAT_TYPE ret = 0.0;
   FLOAT_TYPE U2;
-  FLOAT_TYPE mesh_i = 1.0/p->mesh;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN, NULL);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
   FLOAT_TYPE sin_term = 0.0, kmdHH, kmdHO;
   FLOAT_TYPE P3M_BRILLOUIN_LOCAL = P3M_BRILLOUIN;
 
   for (mx = -P3M_BRILLOUIN_LOCAL; mx <= P3M_BRILLOUIN_LOCAL; mx++) {
     nmx = nx + p->mesh*mx;
-    fnmx = nmx * mesh_i;
     for (my = -P3M_BRILLOUIN_LOCAL; my <= P3M_BRILLOUIN_LOCAL; my++) {
       nmy = ny + p->mesh*my;
-      fnmy = nmy * mesh_i;
       for (mz = -P3M_BRILLOUIN_LOCAL; mz <= P3M_BRILLOUIN_LOCAL; mz++) {
 	nmz = nz + p->mesh*mz;
-	fnmz = nmz * mesh_i;
 
 	km2 = SQR(2.0*PI/s->length) * ( SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz ) );	
 
@@ -384,7 +363,7 @@ FLOAT_TYPE B_ad_water(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 	kmdHH = 1.63 * SQRT(km2);
 	sin_term = -0.67*SIN(kmdHO)/kmdHO + 0.34 * SIN(kmdHH)/kmdHH;
 
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
+	U2 = ux[mx+t->mc]*uy[my+t->mc]*uz[mz+t->mc];
 
 	ret += U2 * 4.0 * PI * EXP(- km2 / ( 4.0 * SQR(p->alpha))) * sin_term;
       }
@@ -398,29 +377,28 @@ FLOAT_TYPE B_ad_water(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 FLOAT_TYPE B_ad_dip(int nx, int ny, int nz, system_t *s, parameters_t *p) {
   int mx, my, mz;
   int nmx, nmy, nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
   FLOAT_TYPE km2;
   FLOAT_TYPE ret = 0.0;
   FLOAT_TYPE U2;
-  FLOAT_TYPE mesh_i = 1.0/p->mesh;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN, NULL);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
   FLOAT_TYPE d = 1.0;
   FLOAT_TYPE sin_term = 0.0, kmd;
   FLOAT_TYPE P3M_BRILLOUIN_LOCAL = P3M_BRILLOUIN;
 
   for (mx = -P3M_BRILLOUIN_LOCAL; mx <= P3M_BRILLOUIN_LOCAL; mx++) {
     nmx = nx + p->mesh*mx;
-    fnmx = nmx * mesh_i;
     for (my = -P3M_BRILLOUIN_LOCAL; my <= P3M_BRILLOUIN_LOCAL; my++) {
       nmy = ny + p->mesh*my;
-      fnmy = nmy * mesh_i;
       for (mz = -P3M_BRILLOUIN_LOCAL; mz <= P3M_BRILLOUIN_LOCAL; mz++) {
 	nmz = nz + p->mesh*mz;
-	fnmz = nmz * mesh_i;
 
 	km2 = SQR(2.0*PI/s->length) * ( SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz ) );	
 	kmd = SQRT(km2)*d;
 
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
+	U2 = ux[mx+t->mc]*uy[my+t->mc]*uz[mz+t->mc];
 
         sin_term =  1.0 * SIN(kmd) / kmd;
 
@@ -434,42 +412,46 @@ FLOAT_TYPE B_ad_dip(int nx, int ny, int nz, system_t *s, parameters_t *p) {
 
 
 void p3m_tune_aliasing_sums_ad(int nx, int ny, int nz, 
-			       system_t *s, parameters_t *p,
+			       system_t *s, parameters_t *p, const aliasing_table_t *t,
 			       FLOAT_TYPE *alias1, FLOAT_TYPE *alias2, FLOAT_TYPE *alias3,FLOAT_TYPE *alias4)
 {
-
+  const int nm = 2*t->mc+1;
+  const FLOAT_TYPE *nmx = t->nm + Aliasing_row(t, nx);
+  const FLOAT_TYPE *nmy = t->nm + Aliasing_row(t, ny);
+  const FLOAT_TYPE *nmz = t->nm + Aliasing_row(t, nz);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
+  FLOAT_TYPE k[nm], ex[nm], ey[nm], ez[nm];
+  FLOAT_TYPE S2, E2, N2, U2, ex3, nm2;
+  FLOAT_TYPE a1 = 0.0, a2 = 0.0, a3 = 0.0, a4 = 0.0;
   int    mx,my,mz;
-  FLOAT_TYPE nmx,nmy,nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
-
-  FLOAT_TYPE ex,ex2,nm2,U2,factor1;
-
-  FLOAT_TYPE mesh_i = 1.0 / p->mesh;
-
-  factor1 = SQR ( PI / ( p->alpha*s->length ) );
 
-  *alias1 = *alias2 = *alias3 = *alias4 = 0.0;
-
-  for (mx=-P3M_BRILLOUIN_TUNING; mx<=P3M_BRILLOUIN_TUNING; mx++) {
-    fnmx = mesh_i * (nmx = nx + mx*p->mesh);
-    for (my=-P3M_BRILLOUIN_TUNING; my<=P3M_BRILLOUIN_TUNING; my++) {
-      fnmy = mesh_i * (nmy = ny + my*p->mesh);
-      for (mz=-P3M_BRILLOUIN_TUNING; mz<=P3M_BRILLOUIN_TUNING; mz++) {
-	fnmz = mesh_i * (nmz = nz + mz*p->mesh);
-	
-	nm2 = SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz );
-        ex = EXP(-factor1*nm2);
-	ex2 = SQR( ex );
-	
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
-	
-	*alias1 += ex2 / nm2;
-	*alias2 += U2 * ex;
-	*alias3 += U2 * nm2;
-	*alias4 += U2;
+  Aliasing_factors(p, t, s->length, nx, k, ex);
+  Aliasing_factors(p, t, s->length, ny, k, ey);
+  Aliasing_factors(p, t, s->length, nz, k, ez);
+
+  for (mx = 0; mx < nm; mx++) {
+    for (my = 0; my < nm; my++) {
+      S2 = ux[mx]*uy[my];
+      E2 = ex[mx]*ey[my];
+      N2 = SQR(nmx[mx]) + SQR(nmy[my]);
+      for (mz = 0; mz < nm; mz++) {
+	nm2 = N2 + SQR(nmz[mz]);
+	ex3 = E2*ez[mz];
+	U2 = S2*uz[mz];
+
+	a1 += SQR(ex3) / nm2;
+	a2 += U2 * ex3;
+	a3 += U2 * nm2;
+	a4 += U2;
       }
     }
   }
+  *alias1 = a1;
+  *alias2 = a2;
+  *alias3 = a3;
+  *alias4 = a4;
 }
 
 FLOAT_TYPE p3m_k_space_error_ad( system_t *s, parameters_t *p )
@@ -479,13 +461,14 @@ FLOAT_TYPE p3m_k_space_error_ad( system_t *s, parameters_t *p )
   FLOAT_TYPE box_size = s->length;
   FLOAT_TYPE he_q = -1;
   FLOAT_TYPE alias1, alias2, alias3, alias4;
+  const aliasing_table_t *t = Aliasing_table(p->mesh, p->cao, P3M_BRILLOUIN_TUNING, NULL);
 
   he_q = 0.0;
   for (nx=-mesh/2; nx<mesh/2; nx++) {
     for (ny=-mesh/2; ny<mesh/2; ny++) {
       for (nz=-mesh/2; nz<mesh/2; nz++) {
 	if((nx!=0) && (ny!=0) && (nz!=0)) {
-	  p3m_tune_aliasing_sums_ad(nx,ny,nz, s, p, &alias1,&alias2,&alias3,&alias4);	//alias4 = cs
+	  p3m_tune_aliasing_sums_ad(nx,ny,nz, s, p, t, &alias1,&alias2,&alias3,&alias4);	//alias4 = cs
 	  if( (alias3 == 0.0) || (alias4 == 0.0) )
 	    continue;
 	  he_q += alias1  -  (SQR(alias2) / (alias3*alias4));
@@ -21,10 +21,12 @@
 #include <assert.h>
 
 #include "p3m-common.h"
+#include "wisdom.h"
 #include "charge-assign.h"
 
 #include "common.h"
 #include "interpol.h"
+#include "realpart.h"
 
 #include "p3m-ad-self-forces.h"
 
@@ -32,6 +34,35 @@
 
 int P3M_BRILLOUIN = 1;
 int P3M_BRILLOUIN_TUNING = 1;
+/* Evaluate the assignment weights directly instead of using the interpolation tables. */
+int P3M_CA_DIRECT = 0;
+/* Reorder the particles along a space-filling curve before the mesh operations. */
+int P3M_REORDER = 0;
+/* Use ghost-padded meshes for charge assignment if the method supports it. */
+int P3M_PADDED_MESH = 0;
+/* Cache only the one-dimensional assignment weights per particle. */
+int P3M_CA_SEPARABLE = 0;
+/* Use single precision meshes and ffts if the method supports it. */
+int P3M_MESH_FLOAT = 0;
+/* Incremental charge assignment, only particles that moved more than
+   P3M_INC_THRESHOLD mesh spacings are reassigned. */
+int P3M_INCREMENTAL = 0;
+FLOAT_TYPE P3M_INC_THRESHOLD = 0.0;
+/* Keep the transformed charge mesh between calls with the same
+   configuration, e.g. in an alpha sweep. */
+int P3M_ALPHA_SWEEP = 0;
+/* Minimal number of particles for the linked cell real space part,
+   smaller systems use the direct O(N^2) sum. */
+int P3M_LINKED_CELLS_MIN = 1000;
+/* Use Verlet lists for the real space part, they are kept in data_t and
+   rebuilt if a particle moved more than half the skin. */
+int P3M_VERLET_LISTS = 0;
+FLOAT_TYPE P3M_VERLET_SKIN = 0.3;
+/* Number of intervals of the tabulated real space kernel for all real
+   space paths. 0 tabulates only in the vectorized cell and Verlet
+   kernels, which have no vector erfc and exp, and evaluates the pair
+   functions directly elsewhere. Negative values never tabulate. */
+int P3M_REALSPACE_TABLE = 0;
 
 #define FREE_TRACE(A) 
 
@@ -77,35 +108,138 @@ FLOAT_TYPE sinc(FLOAT_TYPE d)
 FLOAT_TYPE analytic_cotangent_sum(int n, FLOAT_TYPE mesh_i, int cao)
 {
     FLOAT_TYPE c, res=0.0;
+    int j;
     c = SQR(COS(PI*mesh_i*(FLOAT_TYPE)n));
 
-    switch (cao) {
-    case 1 :
-        res = 1;
-        break;
-    case 2 :
-        res = (1.0+c*2.0)/3.0;
-        break;
-    case 3 :
-        res = (2.0+c*(11.0+c*2.0))/15.0;
-        break;
-    case 4 :
-        res = (17.0+c*(180.0+c*(114.0+c*4.0)))/315.0;
-        break;
-    case 5 :
-        res = (62.0+c*(1072.0+c*(1452.0+c*(247.0+c*2.0))))/2835.0;
-        break;
-    case 6 :
-        res = (1382.0+c*(35396.0+c*(83021.0+c*(34096.0+c*(2026.0+c*4.0)))))/155925.0;
-        break;
-    case 7 :
-        res = (21844.0+c*(776661.0+c*(2801040.0+c*(2123860.0+c*(349500.0+c*(8166.0+c*4.0))))))/6081075.0;
-        break;
-    }
+    if((cao < 1) || (cao > BSPLINE_MAX_CAO))
+      return res;
+
+    for(j=cao-1;j>=0;j--)
+      res = res*c + bspline_alias_coef[cao][j];
 
     return res;
 }
 
+/* Cache of the aliasing tables, they only depend on (mesh, cao, mc)
+   and the window, so influence functions and error estimates for the
+   same mesh share them. Entries live until Free_aliasing_tables(). */
+static aliasing_table_t *aliasing_tables = NULL;
+
+static aliasing_table_t *Build_aliasing_table(int mesh, int cao, int mc, FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE)) {
+  aliasing_table_t *t = (aliasing_table_t *)Init_array(1, sizeof(aliasing_table_t));
+  const int nm = 2*mc+1;
+  const FLOAT_TYPE mesh_i = 1.0/(FLOAT_TYPE)mesh;
+  int n, m;
+
+  t->mesh = mesh;
+  t->cao = cao;
+  t->mc = mc;
+  t->U_hat = U_hat;
+  t->nm = (FLOAT_TYPE *)Init_array(mesh*nm, sizeof(FLOAT_TYPE));
+  t->sinc2 = (FLOAT_TYPE *)Init_array(mesh*nm, sizeof(FLOAT_TYPE));
+  t->u2 = (U_hat == NULL) ? t->sinc2 : (FLOAT_TYPE *)Init_array(mesh*nm, sizeof(FLOAT_TYPE));
+
+  for(n = -mesh/2; n < mesh - mesh/2; n++)
+    for(m = 0; m < nm; m++) {
+      int i = (n + mesh/2)*nm + m;
+      t->nm[i] = n + mesh*(m - mc);
+      t->sinc2[i] = my_power(sinc(mesh_i*t->nm[i]), 2*cao);
+      if(U_hat != NULL)
+	t->u2[i] = SQR(U_hat(cao, mesh_i*t->nm[i]));
+    }
+
+  return t;
+}
+
+const aliasing_table_t *Aliasing_table(int mesh, int cao, int mc, FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE)) {
+  aliasing_table_t *t;
+
+#ifdef _OPENMP
+#pragma omp critical (aliasing_tables)
+#endif
+  {
+    for(t = aliasing_tables; t != NULL; t = t->next)
+      if((t->mesh == mesh) && (t->cao == cao) && (t->mc == mc) && (t->U_hat == U_hat))
+	break;
+
+    if(t == NULL) {
+      t = Build_aliasing_table(mesh, cao, mc, U_hat);
+      t->next = aliasing_tables;
+      aliasing_tables = t;
+    }
+  }
+
+  return t;
+}
+
+void Free_aliasing_tables(void) {
+  aliasing_table_t *t;
+
+  while(aliasing_tables != NULL) {
+    t = aliasing_tables;
+    aliasing_tables = t->next;
+    if(t->u2 != t->sinc2)
+      Free_array(t->u2);
+    Free_array(t->sinc2);
+    Free_array(t->nm);
+    Free_array(t);
+  }
+}
+
+/* Per axis factors of the aliasing sums at the shifted mesh index n,
+   for m = -mc..mc stored at m+mc: k = (n + m*mesh)/length and
+   e = exp(-(pi k/alpha)^2). Together with the window factors from
+   the table, the product over the three axes gives the summands. */
+void Aliasing_factors(const parameters_t *p, const aliasing_table_t *t, FLOAT_TYPE length, int n,
+		      FLOAT_TYPE *k, FLOAT_TYPE *e) {
+    const FLOAT_TYPE fak2 = SQR(PI/p->alpha);
+    const FLOAT_TYPE Leni = 1.0/length;
+    const FLOAT_TYPE *nm = t->nm + Aliasing_row(t, n);
+    int m;
+
+    for(m = 0; m <= 2*t->mc; m++) {
+      k[m] = nm[m]*Leni;
+      e[m] = EXP(-fak2*SQR(k[m]));
+    }
+}
+
+
+/* Mesh points per axis for the box of s. The mesh spacing is kept
+   isotropic with p->mesh points along the longest axis, axes shorter
+   than that get the next even number of points. */
+void Mesh_grid(const system_t *s, const parameters_t *p, int grid[3]) {
+    int dim;
+
+    for(dim = 0; dim < 3; dim++) {
+      if(s->box_l[dim] == s->length)
+        grid[dim] = p->mesh;
+      else
+        grid[dim] = 2*(int)ceil(0.5*p->mesh*s->box_l[dim]/s->length);
+      if(grid[dim] < p->cao)
+        grid[dim] = p->cao + (p->cao % 2);
+    }
+}
+
+void Set_aliasing_tables(data_t *d, int cao, FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE)) {
+    int dim;
+
+    for(dim = 0; dim < 3; dim++)
+      d->alias[dim] = Aliasing_table(d->grid[dim], cao, P3M_BRILLOUIN, U_hat);
+}
+
+/* Points the per axis views to consecutive parts of a, or all to a
+   for a cubic mesh. */
+static void Init_axis_views(data_t *d, FLOAT_TYPE *a, FLOAT_TYPE **views) {
+    int dim;
+
+    for(dim = 0; dim < 3; dim++)
+      views[dim] = Mesh_is_cubic(d) ? a : a + ((dim > 0) ? d->grid[0] : 0) + ((dim > 1) ? d->grid[1] : 0);
+}
+
+/* Number of entries of the per axis arrays nshift and Dn. */
+static int Axis_points(const data_t *d) {
+    return Mesh_is_cubic(d) ? d->grid[0] : d->grid[0] + d->grid[1] + d->grid[2];
+}
 
 void Init_differential_operator(data_t *d)
 {
@@ -115,18 +249,22 @@ void Init_differential_operator(data_t *d)
        d.h. der Faktor  i*2*PI/L fehlt hier!
     */
 
-    int    i;
-    FLOAT_TYPE dMesh=(FLOAT_TYPE)d->mesh;
+    int    i, dim;
+    FLOAT_TYPE dMesh;
     FLOAT_TYPE dn;
 
-    for (i=0; i<d->mesh; i++)
+    for (dim=0; dim<3; dim++)
     {
-        dn    = (FLOAT_TYPE)i;
-        dn   -= ROUND(dn/dMesh)*dMesh;
-        d->Dn[i] = dn;
-    }
+        dMesh = (FLOAT_TYPE)d->grid[dim];
+        for (i=0; i<d->grid[dim]; i++)
+        {
+            dn    = (FLOAT_TYPE)i;
+            dn   -= ROUND(dn/dMesh)*dMesh;
+            d->Dn_axis[dim][i] = dn;
+        }
 
-    d->Dn[d->mesh/2] = 0.0;
+        d->Dn_axis[dim][d->grid[dim]/2] = 0.0;
+    }
 
 }
 
@@ -134,45 +272,99 @@ void Init_nshift(data_t *d)
 {
     /* Verschiebt die Meshpunkte um Mesh/2 */
 
-    int    i;
-    FLOAT_TYPE dMesh=(FLOAT_TYPE)d->mesh;
+    int    i, dim;
+    FLOAT_TYPE dMesh;
 
-    for (i=0; i<d->mesh; i++)
-        d->nshift[i] = i - ROUND(i/dMesh)*dMesh;
+    for (dim=0; dim<3; dim++)
+    {
+        dMesh = (FLOAT_TYPE)d->grid[dim];
+        for (i=0; i<d->grid[dim]; i++)
+            d->nshift_axis[dim][i] = i - ROUND(i/dMesh)*dMesh;
+    }
 
 }
 
 data_t *Init_data(const method_t *m, system_t *s, parameters_t *p) {
-    int mesh3 = p->mesh*p->mesh*p->mesh;
+    int mesh3;
     data_t *d = (data_t *)Init_array(1, sizeof(data_t));
+    /* The method allocates its single precision meshes itself */
+    const int mesh_float = P3M_MESH_FLOAT && (m->flags & METHOD_FLAG_mesh_float);
 
     d->mesh = p->mesh;
+    d->method_data = NULL;
+    d->free_method_data = m->Free;
+
+    /* Mesh methods for non-cubic boxes use per axis meshes */
+    if ( (m->flags & METHOD_FLAG_noncubic) && (m->flags & METHOD_FLAG_Qmesh) )
+      Mesh_grid(s, p, d->grid);
+    else
+      d->grid[0] = d->grid[1] = d->grid[2] = p->mesh;
+
+    mesh3 = Mesh_size(d);
     
-    if ( m->flags & METHOD_FLAG_Qmesh)
+    if ( (m->flags & METHOD_FLAG_Qmesh) && !mesh_float )
       d->Qmesh = (FLOAT_TYPE *)Init_array(2*mesh3, sizeof(FLOAT_TYPE));
     else
       d->Qmesh = NULL;
 
     if ( m->flags & METHOD_FLAG_ik ) {
-        d->Fmesh = Init_vector_array(2*mesh3);
-        d->Dn = (FLOAT_TYPE *)Init_array(d->mesh, sizeof(FLOAT_TYPE));
+        d->Fmesh = mesh_float ? NULL : Init_vector_array(2*mesh3);
+        d->Dn = (FLOAT_TYPE *)Init_array(Axis_points(d), sizeof(FLOAT_TYPE));
+        Init_axis_views(d, d->Dn, d->Dn_axis);
         Init_differential_operator(d);
     }
     else {
         d->Fmesh = NULL;
         d->Dn = NULL;
+        for(int l = 0; l < 3; l++)
+          d->Dn_axis[l] = NULL;
     }
 
+    for(int l = 0; l < 3; l++)
+      d->alias[l] = NULL;
+
+    d->Qmesh_pad = NULL;
+    d->Fmesh_pad = NULL;
+
+    d->Qmesh_f = NULL;
+    d->G_hat_f = NULL;
+    for(int l = 0; l < 3; l++)
+      d->Fmesh_f[l] = NULL;
+
+    d->Qmesh_inc = NULL;
+    d->pos_inc = NULL;
+    d->q_inc = NULL;
+    d->inc_ids = NULL;
+    d->inc_valid = 0;
+    d->inc_steps = 0;
+
+    d->verlet_list = NULL;
+
+    d->order = NULL;
+    d->ordered = NULL;
+    d->ordered_forces = NULL;
+
+    if( P3M_ALPHA_SWEEP && !p->tuning && (m->flags & METHOD_FLAG_Qmesh) && !mesh_float )
+      d->Qmesh_hat = (FLOAT_TYPE *)Init_array(2*mesh3, sizeof(FLOAT_TYPE));
+    else
+      d->Qmesh_hat = NULL;
+    d->Qmesh_hat_valid = 0;
+
     d->nshift = NULL;
+    for(int l = 0; l < 3; l++)
+      d->nshift_axis[l] = NULL;
 
     if ( m->flags & METHOD_FLAG_nshift ) {
-      d->nshift = (FLOAT_TYPE *)Init_array(d->mesh, sizeof(FLOAT_TYPE));
+      d->nshift = (FLOAT_TYPE *)Init_array(Axis_points(d), sizeof(FLOAT_TYPE));
+      Init_axis_views(d, d->nshift, d->nshift_axis);
       Init_nshift(d);
     }
 
     d->dQ[0] = NULL;
     d->dQ[1] = NULL;
 
+    d->cf_separable = P3M_CA_SEPARABLE;
+
     if( m->flags & METHOD_FLAG_self_force_correction)
       d->self_force_corrections = (FLOAT_TYPE *)Init_array(my_power(1+2*P3M_SELF_BRILLOUIN, 3), 3*sizeof(FLOAT_TYPE));
 
@@ -181,7 +373,7 @@ data_t *Init_data(const method_t *m, system_t *s, parameters_t *p) {
       int max = ( m->flags & METHOD_FLAG_interlaced) ? 2 : 1;
 
         for (i = 0; i < max; i++) {
-	  d->dQ[i] = (FLOAT_TYPE *)Init_array( 3*s->nparticles*p->cao3, sizeof(FLOAT_TYPE) );
+	  d->dQ[i] = (FLOAT_TYPE *)Init_array( 3*s->nparticles*(d->cf_separable ? p->cao : p->cao3), sizeof(FLOAT_TYPE) );
         }
     }
 
@@ -192,15 +384,17 @@ data_t *Init_data(const method_t *m, system_t *s, parameters_t *p) {
       d->ca_ind[1] = NULL;
       
       for (i = 0; i < max; i++) {
-	d->cf[i] = (FLOAT_TYPE *)Init_array( p->cao3 * s->nparticles, sizeof(FLOAT_TYPE));
+	d->cf[i] = (FLOAT_TYPE *)Init_array( (d->cf_separable ? 3*p->cao : p->cao3) * s->nparticles, sizeof(FLOAT_TYPE));
 	d->ca_ind[i] = (int *)Init_array( 3*s->nparticles, sizeof(int));
       }
 	
-      if( !p->tuning )
+      if( P3M_CA_DIRECT )
+	d->inter = Init_interpolation_direct( p->ip );
+      else if( !p->tuning )
 	d->inter = Init_interpolation( p->ip, m->flags & METHOD_FLAG_ad );
       else {
 	if(dummy_inter == NULL)
-	  dummy_inter = Init_interpolation( 6, 1 );
+	  dummy_inter = Init_interpolation( BSPLINE_MAX_CAO-1, 1 );
 	d->inter = dummy_inter;
       }
     }
@@ -212,12 +406,18 @@ data_t *Init_data(const method_t *m, system_t *s, parameters_t *p) {
       d->inter = NULL;
     }
 
+    d->G_hat_nz = (m->flags & METHOD_FLAG_r2c) ? d->grid[2]/2+1 : d->grid[2];
+
     if ( m->flags & METHOD_FLAG_G_hat) {
-      if( !p->tuning) {
-	d->G_hat = (FLOAT_TYPE *)Init_array(mesh3, sizeof(FLOAT_TYPE));
+      if( mesh_float && !p->tuning) {
+        /* Only the single precision copy is kept, see the method's Init */
+        d->G_hat = NULL;
+      } else if( !p->tuning) {
+	d->G_hat = (FLOAT_TYPE *)Init_array(d->grid[0]*d->grid[1]*d->G_hat_nz, sizeof(FLOAT_TYPE));
         m->Influence_function( s, p, d );   
       } else {
 	dummy_g_realloc(d->mesh);
+	assert(Mesh_is_cubic(d));
 	d->G_hat = dummy_g;
       }
     }
@@ -231,12 +431,113 @@ data_t *Init_data(const method_t *m, system_t *s, parameters_t *p) {
     return d;
 }
 
+/* Buffers for the incremental charge assignment on the complex mesh. */
+void Init_charge_incremental(system_t *s, data_t *d) {
+    d->Qmesh_inc = (FLOAT_TYPE *)Init_array(2*Mesh_size(d), sizeof(FLOAT_TYPE));
+    d->pos_inc = (FLOAT_TYPE *)Init_array(3*s->nparticles, sizeof(FLOAT_TYPE));
+    d->q_inc = (FLOAT_TYPE *)Init_array(s->nparticles, sizeof(FLOAT_TYPE));
+    d->inc_ids = (int *)Init_array(s->nparticles, sizeof(int));
+    d->inc_valid = 0;
+    d->inc_steps = 0;
+}
+
+/* Cache of the forward transformed charge mesh. The k-space
+   functions skip charge assignment and forward fft if it is valid,
+   the caller has to invalidate it when the particles change. */
+int Charge_mesh_cache_load(data_t *d) {
+    if((d->Qmesh_hat == NULL) || !d->Qmesh_hat_valid)
+      return 0;
+
+    memcpy(d->Qmesh, d->Qmesh_hat, 2*Mesh_size(d)*sizeof(FLOAT_TYPE));
+    return 1;
+}
+
+void Charge_mesh_cache_store(data_t *d) {
+    if(d->Qmesh_hat == NULL)
+      return;
+
+    memcpy(d->Qmesh_hat, d->Qmesh, 2*Mesh_size(d)*sizeof(FLOAT_TYPE));
+    d->Qmesh_hat_valid = 1;
+}
+
+void Charge_mesh_cache_invalidate(data_t *d) {
+    d->Qmesh_hat_valid = 0;
+}
+
+/* Fills G_hat from an influence function kernel that is invariant
+   under permutations and reflections of the mesh indices, which holds
+   for cubic box and mesh. The kernel is only evaluated on the wedge
+   NX <= NY <= NZ <= mesh/2, about 1/48 of the mesh, and the values are
+   copied to the other points of the orbit. */
+
+void Influence_function_symmetric(system_t *s, parameters_t *p, data_t *d, influence_kernel_t G) {
+    const int Mesh = d->mesh;
+    const int h = Mesh/2;
+    int NX, NY, NZ, i, n_wedge = 0;
+    int *wedge;
+
+    /* No permutation symmetry unless box and mesh are cubic, evaluate everywhere */
+    if(!Mesh_is_cubic(d) || !Box_is_cubic(s)) {
+#ifdef _OPENMP
+#pragma omp parallel for private(NY, NZ) collapse(3)
+#endif
+      for (NX = 0; NX < d->grid[0]; NX++)
+        for (NY = 0; NY < d->grid[1]; NY++)
+          for (NZ = 0; NZ < d->G_hat_nz; NZ++)
+            d->G_hat[g_ind(NX, NY, NZ)] = G(s, p, d, NX, NY, NZ);
+      return;
+    }
+
+    /* Flat list of the wedge points for a static distribution */
+    wedge = (int *)Init_array(3*(h+1)*(h+1)*(h+1), sizeof(int));
+
+    for (NX = 0; NX <= h; NX++)
+      for (NY = NX; NY <= h; NY++)
+        for (NZ = NY; NZ <= h; NZ++) {
+          wedge[3*n_wedge] = NX;
+          wedge[3*n_wedge+1] = NY;
+          wedge[3*n_wedge+2] = NZ;
+          n_wedge++;
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (i = 0; i < n_wedge; i++)
+      d->G_hat[g_ind(wedge[3*i], wedge[3*i+1], wedge[3*i+2])] = G(s, p, d, wedge[3*i], wedge[3*i+1], wedge[3*i+2]);
+
+    Free_array(wedge);
+
+#ifdef _OPENMP
+#pragma omp parallel for private(NY, NZ) collapse(3)
+#endif
+    for (NX = 0; NX < Mesh; NX++)
+      for (NY = 0; NY < Mesh; NY++)
+        for (NZ = 0; NZ < d->G_hat_nz; NZ++) {
+          /* Reflect into [0, mesh/2] and sort */
+          int a = (NX <= h) ? NX : Mesh - NX;
+          int b = (NY <= h) ? NY : Mesh - NY;
+          int c = (NZ <= h) ? NZ : Mesh - NZ;
+          int t;
+
+          if (a > b) { t = a; a = b; b = t; }
+          if (b > c) { t = b; b = c; c = t; }
+          if (a > b) { t = a; a = b; b = t; }
+
+          if ((a != NX) || (b != NY) || (c != NZ))
+            d->G_hat[g_ind(NX, NY, NZ)] = d->G_hat[g_ind(a, b, c)];
+        }
+}
+
 void Free_data(data_t *d) {
     int i;
 
     if( d == NULL )
       return;
 
+    if ((d->method_data != NULL) && (d->free_method_data != NULL))
+      d->free_method_data(d->method_data);
+
     FREE_TRACE(puts("Free_data(); Free ghat.");)
       // Free G_hat only if it's not the dummy influence function.
       if ((d->G_hat != NULL) && (d->G_hat != dummy_g))
@@ -250,6 +551,30 @@ void Free_data(data_t *d) {
     if(d->Fmesh != NULL)
       Free_vector_array(d->Fmesh);
 
+    if(d->Qmesh_pad != NULL)
+      FFTW_FREE(d->Qmesh_pad);
+
+    if(d->Fmesh_pad != NULL)
+      Free_vector_array(d->Fmesh_pad);
+
+    if(d->Qmesh_hat != NULL)
+      FFTW_FREE(d->Qmesh_hat);
+
+    if(d->Qmesh_inc != NULL) {
+      FFTW_FREE(d->Qmesh_inc);
+      FFTW_FREE(d->pos_inc);
+      FFTW_FREE(d->q_inc);
+      FFTW_FREE(d->inc_ids);
+    }
+
+    Free_verlet_list(d->verlet_list);
+
+    if(d->ordered != NULL) {
+      FFTW_FREE(d->order);
+      Free_system(d->ordered);
+      Free_forces(d->ordered_forces);
+    }
+
     FREE_TRACE(puts("Free dshift.");)
     if (d->nshift != NULL)
         FFTW_FREE(d->nshift);
@@ -282,6 +607,16 @@ void Free_data(data_t *d) {
       FFTW_DESTROY_PLAN(d->backward_plan[i]);
     }
 
+    if(d->Qmesh_f != NULL) {
+      fftwf_destroy_plan(d->forward_plan_f);
+      fftwf_free(d->Qmesh_f);
+      for(i=0; i<3; i++) {
+        fftwf_destroy_plan(d->backward_plan_f[i]);
+        fftwf_free(d->Fmesh_f[i]);
+      }
+      fftwf_free(d->G_hat_f);
+    }
+
     FFTW_FREE(d);
 
 }
@@ -401,7 +736,7 @@ FLOAT_TYPE B(int nx, int ny, int nz, FLOAT_TYPE l, FLOAT_TYPE alpha, int m, int
 
 FLOAT_TYPE *Error_map(system_t *s, forces_t *f, forces_t *f_ref, int mesh, int cao) {
   system_t *s2 = Init_system(s->nparticles);
-  s2->length = s->length;
+  Set_box(s2, s->box_l[0], s->box_l[1], s->box_l[2]);
 
   parameters_t param;
   param.mesh = mesh;
@@ -443,17 +778,17 @@ FLOAT_TYPE Generic_error_estimate_inhomo(system_t *s, parameters_t *p, int unifo
   FLOAT_TYPE *Kernel[4];
   // puts("Plan FFT.");
   // printf("Mesh size %d, Mesh %p\n", mesh, Qmesh);
-  FFTW_PLAN forward_plan = FFTW_PLAN_DFT_3D(mesh, mesh, mesh, (FFTW_COMPLEX*) Qmesh, (FFTW_COMPLEX*) Kmesh, FFTW_FORWARD, FFTW_MEASURE);
-  FFTW_PLAN backward_plan = FFTW_PLAN_DFT_3D(mesh, mesh, mesh, (FFTW_COMPLEX*) Kmesh, (FFTW_COMPLEX*)Kmesh, FFTW_BACKWARD, FFTW_MEASURE);
+  FFTW_PLAN forward_plan = Wisdom_plan_dft_3d(mesh, mesh, mesh, (FFTW_COMPLEX*) Qmesh, (FFTW_COMPLEX*) Kmesh, FFTW_FORWARD);
+  FFTW_PLAN backward_plan = Wisdom_plan_dft_3d(mesh, mesh, mesh, (FFTW_COMPLEX*) Kmesh, (FFTW_COMPLEX*)Kmesh, FFTW_BACKWARD);
   FFTW_PLAN kernel_backward_plan[3];
   FFTW_PLAN kernel_forward_plan;
   for(int i = 0; i < 4; i++) {
     Kernel[i] = (FLOAT_TYPE *)Init_array( 2*mesh*mesh*mesh, sizeof(FLOAT_TYPE));
     
     if(i < 3)
-      kernel_backward_plan[i] = FFTW_PLAN_DFT_3D(mesh, mesh, mesh, (FFTW_COMPLEX *) Kernel[i], (FFTW_COMPLEX *) Kernel[i],FFTW_BACKWARD, FFTW_MEASURE);
+      kernel_backward_plan[i] = Wisdom_plan_dft_3d(mesh, mesh, mesh, (FFTW_COMPLEX *) Kernel[i], (FFTW_COMPLEX *) Kernel[i], FFTW_BACKWARD);
     else
-      kernel_forward_plan = FFTW_PLAN_DFT_3D(mesh, mesh, mesh,(FFTW_COMPLEX *) Kernel[i], (FFTW_COMPLEX *) Kernel[i],FFTW_FORWARD, FFTW_MEASURE);
+      kernel_forward_plan = Wisdom_plan_dft_3d(mesh, mesh, mesh,(FFTW_COMPLEX *) Kernel[i], (FFTW_COMPLEX *) Kernel[i], FFTW_FORWARD);
 
     memset(Kernel[i], 0, 2*mesh*mesh*mesh*sizeof(FLOAT_TYPE));
   }
@@ -734,7 +1069,7 @@ FLOAT_TYPE Generic_error_estimate(R3_to_R A, R3_to_R B, R3_to_R C, system_t *s,
     for (ny=-d->mesh/2; ny<d->mesh/2; ny++) {
       for (nz=-d->mesh/2; nz<d->mesh/2; nz++) {
 	if((nx!=0) || (ny!=0) || (nz!=0)) {
-	  ind = r_ind(NTRANS(nx), NTRANS(ny), NTRANS(nz));
+	  ind = g_ind(NTRANS(nx), NTRANS(ny), NTRANS(nz));
 	  G_hat = d->G_hat[ind];
 
 	  a = A(nx,ny,nz,s,p);
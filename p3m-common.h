@@ -21,16 +21,59 @@
 
 extern int P3M_BRILLOUIN_TUNING;
 extern int P3M_BRILLOUIN;
-
-#define r_ind(A,B,C) ((A)*d->mesh*d->mesh + (B)*d->mesh + (C))
-#define c_ind(A,B,C) (2*d->mesh*d->mesh*(A)+2*d->mesh*(B)+2*(C))
+extern int P3M_CA_DIRECT;
+extern int P3M_REORDER;
+extern int P3M_PADDED_MESH;
+extern int P3M_CA_SEPARABLE;
+extern int P3M_MESH_FLOAT;
+extern int P3M_INCREMENTAL;
+extern FLOAT_TYPE P3M_INC_THRESHOLD;
+extern int P3M_ALPHA_SWEEP;
+extern int P3M_LINKED_CELLS_MIN;
+extern int P3M_VERLET_LISTS;
+extern FLOAT_TYPE P3M_VERLET_SKIN;
+extern int P3M_REALSPACE_TABLE;
+
+#define r_ind(A,B,C) (((A)*d->grid[1] + (B))*d->grid[2] + (C))
+#define c_ind(A,B,C) (2*r_ind(A,B,C))
+/* Index of (A,B,C) in G_hat. Planes beyond G_hat_nz are not stored
+   and follow from G(-k) = G(k). */
+#define g_ind(A,B,C) (((C) < d->G_hat_nz) ?				\
+		      (d->grid[1]*(A) + (B))*d->G_hat_nz + (C) :		\
+		      (d->grid[1]*((d->grid[0]-(A))%d->grid[0]) + (d->grid[1]-(B))%d->grid[1])*d->G_hat_nz + d->grid[2]-(C))
+
+/* Number of mesh points of d. */
+static inline int Mesh_size(const data_t *d) {
+  return d->grid[0]*d->grid[1]*d->grid[2];
+}
+
+static inline int Mesh_is_cubic(const data_t *d) {
+  return (d->grid[0] == d->grid[1]) && (d->grid[1] == d->grid[2]);
+}
 
 FLOAT_TYPE sinc(FLOAT_TYPE);
 FLOAT_TYPE analytic_cotangent_sum(int n, FLOAT_TYPE mesh_i, int cao);
+const aliasing_table_t *Aliasing_table(int mesh, int cao, int mc, FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE));
+void Free_aliasing_tables(void);
+void Aliasing_factors(const parameters_t *, const aliasing_table_t *, FLOAT_TYPE length, int n,
+		      FLOAT_TYPE *k, FLOAT_TYPE *e);
+
+/* Offset of the row of the shifted mesh index n in an aliasing table. */
+static inline int Aliasing_row(const aliasing_table_t *t, int n) {
+  return (n + t->mesh/2)*(2*t->mc + 1);
+}
+
+void Mesh_grid(const system_t *, const parameters_t *, int grid[3]);
+void Set_aliasing_tables(data_t *, int cao, FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE));
 
 void Init_differential_operator( data_t * );
 void Init_nshift(data_t *);
 data_t *Init_data(const method_t *, system_t *s, parameters_t *); 
+void Init_charge_incremental(system_t *, data_t *);
+int Charge_mesh_cache_load(data_t *);
+void Charge_mesh_cache_store(data_t *);
+void Charge_mesh_cache_invalidate(data_t *);
+void Influence_function_symmetric(system_t *, parameters_t *, data_t *, influence_kernel_t);
 void Free_data(data_t *);
 
 FLOAT_TYPE C_ewald(int nx, int ny, int nz, system_t *s, parameters_t *p);
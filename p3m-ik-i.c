@@ -24,6 +24,7 @@
 #include "types.h"
 #include "common.h"
 #include "p3m-common.h"
+#include "wisdom.h"
 #include "charge-assign.h"
 #include "p3m-ik-i.h"
 
@@ -66,10 +67,10 @@ data_t *Init_ik_i ( system_t *s, parameters_t *p ) {
     d->forward_plans = 1;
     d->backward_plans = 3;
 
-    d->forward_plan[0] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD, FFTW_PATIENT );
+    d->forward_plan[0] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD );
 
     for ( l=0;l<3;l++ ) {
-        d->backward_plan[l] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), FFTW_BACKWARD, FFTW_PATIENT );
+        d->backward_plan[l] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), FFTW_BACKWARD );
     }
     return d;
 }
@@ -77,92 +78,82 @@ data_t *Init_ik_i ( system_t *s, parameters_t *p ) {
 
 void Aliasing_sums_ik_i( system_t *s, parameters_t *p, data_t *d, int NX, int NY, int NZ,
                          FLOAT_TYPE *Zaehler, FLOAT_TYPE *Nenner1, FLOAT_TYPE *Nenner2)  {
-  FLOAT_TYPE S1,S2,S3;
-  FLOAT_TYPE fak1,fak2,zwi;
+  const aliasing_table_t *const *t = d->alias;
+  const int mc = t[0]->mc, nm = 2*mc+1;
+  const int nx = d->nshift_axis[0][NX], ny = d->nshift_axis[1][NY], nz = d->nshift_axis[2][NZ];
+  const FLOAT_TYPE *ux = t[0]->sinc2 + Aliasing_row( t[0], nx );
+  const FLOAT_TYPE *uy = t[1]->sinc2 + Aliasing_row( t[1], ny );
+  const FLOAT_TYPE *uz = t[2]->sinc2 + Aliasing_row( t[2], nz );
+  FLOAT_TYPE kx[nm], ky[nm], kz[nm], ex[nm], ey[nm], ez[nm];
+  FLOAT_TYPE S2, S3, E2, K2, zwi, sign2;
+  FLOAT_TYPE zx = 0.0, zy = 0.0, zz = 0.0, n1 = 0.0, n2 = 0.0;
   int    MX,MY,MZ;
-  FLOAT_TYPE NMX,NMY,NMZ;
-  FLOAT_TYPE NM2;
-  
-  FLOAT_TYPE expo, TE;
-  int Mesh = d->mesh;
-  
-  FLOAT_TYPE Leni = 1.0/s->length;
-  fak1 = 1.0/(FLOAT_TYPE)Mesh;
-  fak2 = SQR(PI/p->alpha);
-  
-  Zaehler[0] = Zaehler[1] = Zaehler[2] = *Nenner1 = *Nenner2 = 0.0;
-  
-  for ( MX = -P3M_BRILLOUIN; MX <= P3M_BRILLOUIN; MX++ ) {
-    NMX = d->nshift[NX] + Mesh*MX;
-    S1  = my_power( sinc(fak1*NMX), 2*p->cao );
-    for ( MY = -P3M_BRILLOUIN; MY <= P3M_BRILLOUIN; MY++ ) {
-      NMY = d->nshift[NY] + Mesh*MY;
-      S2   = S1 * my_power( sinc(fak1*NMY), 2*p->cao );
-      for ( MZ = -P3M_BRILLOUIN; MZ <= P3M_BRILLOUIN; MZ++ ) {
-	NMZ = d->nshift[NZ] + Mesh*MZ;
-	S3  = S2*my_power( sinc(fak1*NMZ), 2*p->cao );
-	
-	NM2 = SQR ( NMX*Leni ) + SQR ( NMY*Leni ) + SQR ( NMZ*Leni );
-	*Nenner1 += S3;
-	
-	expo = fak2*NM2;
-	TE = EXP ( -expo );
-	zwi  = S3 * TE/NM2;
-	Zaehler[0] += NMX*zwi*Leni;
-	Zaehler[1] += NMY*zwi*Leni;
-	Zaehler[2] += NMZ*zwi*Leni;
-	
-	if (((MX+MY+MZ)%2)==0)                                       //even term
-	  *Nenner2 += S3;
-	else                                                //odd term: minus sign!
-	  *Nenner2 -= S3;
+
+  Aliasing_factors( p, t[0], s->box_l[0], nx, kx, ex );
+  Aliasing_factors( p, t[1], s->box_l[1], ny, ky, ey );
+  Aliasing_factors( p, t[2], s->box_l[2], nz, kz, ez );
+
+  for ( MX = 0; MX < nm; MX++ ) {
+    for ( MY = 0; MY < nm; MY++ ) {
+      S2 = ux[MX]*uy[MY];
+      E2 = ex[MX]*ey[MY];
+      K2 = SQR ( kx[MX] ) + SQR ( ky[MY] );
+      /* sign of the term with MZ = -mc, odd terms are negative */
+      sign2 = ((MX + MY + 3*mc) % 2 == 0) ? 1.0 : -1.0;
+      for ( MZ = 0; MZ < nm; MZ++ ) {
+	S3 = S2*uz[MZ];
+	n1 += S3;
+	n2 += ( MZ % 2 == 0 ) ? sign2*S3 : -sign2*S3;
+
+	zwi = S3 * E2*ez[MZ] / ( K2 + SQR ( kz[MZ] ) );
+	zx += kx[MX]*zwi;
+	zy += ky[MY]*zwi;
+	zz += kz[MZ]*zwi;
       }
     }
   }
+
+  Zaehler[0] = zx;
+  Zaehler[1] = zy;
+  Zaehler[2] = zz;
+  *Nenner1 = n1;
+  *Nenner2 = n2;
 }
 
 
 
-void Influence_ik_i( system_t *s, parameters_t *p, data_t *d )
+/* Influence function at one mesh point */
+static FLOAT_TYPE influence_function_ik_i( system_t *s, parameters_t *p, data_t *d, int NX, int NY, int NZ )
 {
-    int    NX,NY,NZ;
     FLOAT_TYPE Dnx,Dny,Dnz;
     FLOAT_TYPE Zaehler[3]={0.0,0.0,0.0},Nenner1=0.0, Nenner2=0.0;
     FLOAT_TYPE zwi;
 
-    int ind = 0;
     int Mesh = p->mesh;
     FLOAT_TYPE Leni = 1.0/s->length;
 
-    for (NX=0; NX<Mesh; NX++)
-    {
-        for (NY=0; NY<Mesh; NY++)
-        {
-            for (NZ=0; NZ<Mesh; NZ++)
-            {
-                ind = r_ind( NX, NY, NZ );
+    if ((NX==0) && (NY==0) && (NZ==0))
+        return 0.0;
+    if ((NX%(Mesh/2) == 0) && (NY%(Mesh/2) == 0) && (NZ%(Mesh/2) == 0))
+        return 0.0;
 
-                if ((NX==0) && (NY==0) && (NZ==0))
-                    d->G_hat[ind]=0.0;
-                else if ((NX%(Mesh/2) == 0) && (NY%(Mesh/2) == 0) && (NZ%(Mesh/2) == 0))
-                    d->G_hat[ind]=0.0;
-                else
-                {
-                    Aliasing_sums_ik_i( s, p, d, NX, NY, NZ, Zaehler, &Nenner1,  &Nenner2);
+    Aliasing_sums_ik_i( s, p, d, NX, NY, NZ, Zaehler, &Nenner1,  &Nenner2);
 
-                    Dnx = d->Dn[NX];
-                    Dny = d->Dn[NY];
-                    Dnz = d->Dn[NZ];
+    Dnx = d->Dn[NX];
+    Dny = d->Dn[NY];
+    Dnz = d->Dn[NZ];
 
-                    zwi  = Dnx*Zaehler[0]*Leni + Dny*Zaehler[1]*Leni + Dnz*Zaehler[2]*Leni;
-                    zwi /= ( SQR(Dnx*Leni) + SQR(Dny*Leni) + SQR(Dnz*Leni) );
-                    zwi /= 0.5*(SQR(Nenner1) + SQR(Nenner2));
+    zwi  = Dnx*Zaehler[0]*Leni + Dny*Zaehler[1]*Leni + Dnz*Zaehler[2]*Leni;
+    zwi /= ( SQR(Dnx*Leni) + SQR(Dny*Leni) + SQR(Dnz*Leni) );
+    zwi /= 0.5*(SQR(Nenner1) + SQR(Nenner2));
 
-                    d->G_hat[ind] = 2.0 * zwi / PI;
-                }
-            }
-        }
-    }
+    return 2.0 * zwi / PI;
+}
+
+void Influence_ik_i( system_t *s, parameters_t *p, data_t *d )
+{
+    Set_aliasing_tables( d, p->cao, NULL );
+    Influence_function_symmetric( s, p, d, &influence_function_ik_i );
 }
 
 
@@ -181,23 +172,29 @@ void P3M_ik_i( system_t *s, parameters_t *p, data_t *d, forces_t *f )
 
     int c_index;
 
-    /* Initialisieren von Qmesh */
-    memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
+    if ( Charge_mesh_cache_load ( d ) ) {
+      TIMING_START_G
+    } else {
+      /* Initialisieren von Qmesh */
+      memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
+
+      TIMING_START_C
 
-    TIMING_START_C
+      /* chargeassignment */
+      assign_charge( s, p, d, 0 );
+      assign_charge( s, p, d, 1 );
 
-    /* chargeassignment */
-    assign_charge( s, p, d, 0 );
-    assign_charge( s, p, d, 1 );
+      TIMING_STOP_C
 
-    TIMING_STOP_C
+      /* assign_charge_interlacing( s, p, d ); */
 
-  /* assign_charge_interlacing( s, p, d ); */
+      TIMING_START_G
 
-    TIMING_START_G
+      /* Durchfuehren der Fourier-Hin-Transformationen: */
+      forward_fft(d);
 
-    /* Durchfuehren der Fourier-Hin-Transformationen: */
-    forward_fft(d);
+      Charge_mesh_cache_store ( d );
+    }
 
     for (i=0; i<Mesh; i++)
         for (j=0; j<Mesh; j++)
@@ -247,47 +244,48 @@ void P3M_ik_i( system_t *s, parameters_t *p, data_t *d, forces_t *f )
 
 
 void p3m_tune_aliasing_sums_ik_i (int nx, int ny, int nz, 
-					   system_t *s, parameters_t *p, 
+					   system_t *s, parameters_t *p, const aliasing_table_t *t,
 				  FLOAT_TYPE *alias1, FLOAT_TYPE *alias2, FLOAT_TYPE *alias3, FLOAT_TYPE *alias4)
 {
-
+  const int nm = 2*t->mc+1;
+  const FLOAT_TYPE *nmx = t->nm + Aliasing_row(t, nx);
+  const FLOAT_TYPE *nmy = t->nm + Aliasing_row(t, ny);
+  const FLOAT_TYPE *nmz = t->nm + Aliasing_row(t, nz);
+  const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row(t, nx);
+  const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row(t, ny);
+  const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row(t, nz);
+  FLOAT_TYPE k[nm], ex[nm], ey[nm], ez[nm];
+  FLOAT_TYPE S2, E2, N2, D2, U2, ex3, nm2;
+  FLOAT_TYPE a1 = 0.0, a2 = 0.0, a3 = 0.0, a4 = 0.0;
   int    mx,my,mz;
-  FLOAT_TYPE nmx,nmy,nmz;
-  FLOAT_TYPE fnmx,fnmy,fnmz;
 
-  FLOAT_TYPE ex,ex2,nm2,U2,factor1;
-  int mesh = p->mesh;
-  FLOAT_TYPE mesh_i = 1.0 / mesh;
-
-  factor1 = SQR(PI / ( p->alpha * s->length ) );
-
-  *alias1 = *alias2 = *alias3 = *alias4 = 0.0;
-  for (mx=-P3M_BRILLOUIN_TUNING; mx<=P3M_BRILLOUIN_TUNING; mx++) {
-    fnmx = mesh_i * (nmx = nx + mx*mesh);
-    for (my=-P3M_BRILLOUIN_TUNING; my<=P3M_BRILLOUIN_TUNING; my++) {
-      fnmy = mesh_i * (nmy = ny + my*mesh);
-      for (mz=-P3M_BRILLOUIN_TUNING; mz<=P3M_BRILLOUIN_TUNING; mz++) {
-
-	fnmz = mesh_i * (nmz = nz + mz*mesh);
-	
-	nm2 = SQR(nmx) + SQR(nmy) + SQR(nmz);
-	ex = EXP(-factor1*nm2);
-	ex2 = SQR( ex );
-	
-	U2 = my_power(sinc(fnmx)*sinc(fnmy)*sinc(fnmz), 2*p->cao);
-	
-	*alias1 += ex2 / nm2;
-	*alias2 +=  U2 * ex * (nx*nmx + ny*nmy + nz*nmz) / nm2;
-	*alias3 += U2;
-
-       if (((mx+my+mz)%2)==0) {		//consider only even terms!
-	 *alias4 += U2;
-       } else {
-	 *alias4 -= U2;
-       }
+  Aliasing_factors(p, t, s->length, nx, k, ex);
+  Aliasing_factors(p, t, s->length, ny, k, ey);
+  Aliasing_factors(p, t, s->length, nz, k, ez);
+
+  for (mx = 0; mx < nm; mx++) {
+    for (my = 0; my < nm; my++) {
+      S2 = ux[mx]*uy[my];
+      E2 = ex[mx]*ey[my];
+      N2 = SQR(nmx[mx]) + SQR(nmy[my]);
+      D2 = nx*nmx[mx] + ny*nmy[my];
+      for (mz = 0; mz < nm; mz++) {
+	nm2 = N2 + SQR(nmz[mz]);
+	ex3 = E2*ez[mz];
+	U2 = S2*uz[mz];
+
+	a1 += SQR(ex3) / nm2;
+	a2 += U2 * ex3 * (D2 + nz*nmz[mz]) / nm2;
+	a3 += U2;
+	/* consider only even terms! */
+	a4 += (((mx+my+mz+3*t->mc)%2)==0) ? U2 : -U2;
       }
     }
   }
+  *alias1 = a1;
+  *alias2 = a2;
+  *alias3 = a3;
+  *alias4 = a4;
 }
 
 
@@ -301,6 +299,7 @@ FLOAT_TYPE p3m_k_space_error_ik_i ( system_t *s, parameters_t *p ) {
   he_q = p3m_find_error(p->alpha*s->length, mesh, p->cao, 1);
 
   if(he_q < 0) {
+    const aliasing_table_t *t = Aliasing_table(mesh, p->cao, P3M_BRILLOUIN_TUNING, NULL);
     he_q = 0.0;
     for ( nx=-mesh/2; nx<mesh/2; nx++ ) {
       for ( ny=-mesh/2; ny<mesh/2; ny++ ) {
@@ -308,7 +307,7 @@ FLOAT_TYPE p3m_k_space_error_ik_i ( system_t *s, parameters_t *p ) {
 	  if ( ( nx!=0 ) || ( ny!=0 ) || ( nz!=0 ) ) {
 	    n2 = SQR ( nx ) + SQR ( ny ) + SQR ( nz );
 
-	    p3m_tune_aliasing_sums_ik_i ( nx,ny,nz, s, p, &alias1,&alias2,&alias3, &alias4 );
+	    p3m_tune_aliasing_sums_ik_i ( nx,ny,nz, s, p, t, &alias1,&alias2,&alias3, &alias4 );
 	    he_q +=  alias1  -  SQR ( alias2 ) / (0.5*n2*(SQR(alias3)+SQR(alias4)) );
 	  }
 	}
@@ -0,0 +1,827 @@
+/**    Copyright (C) 2011,2012,2013,2014 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fftw3.h>
+#include <mpi.h>
+
+// General typ definitions
+#include "types.h"
+#include "common.h"
+#include "p3m-common.h"
+#include "wisdom.h"
+#include "interpol.h"
+#include "window-functions.h"
+
+#include "p3m-ik.h"
+#include "p3m-ik-mpi.h"
+
+/* P3M with ik differentiation distributed over all MPI ranks.
+
+   The ranks form a periodic 2d process grid P0 x P1. The mesh is
+   split into pencils that are complete along one axis:
+
+     stage X  [y / P0][z / P1][x]   charge assignment and forces
+     stage Y  [x / P0][z / P1][y]
+     stage Z  [x / P0][y / P1][z]   influence function and convolution
+
+   The 3d FFT is done as 1d FFTs along the complete axis with an
+   all-to-all transpose within the rows (X <-> Y) and columns
+   (Y <-> Z) of the process grid between them.
+
+   A particle belongs to the rank whose stage X pencil holds the first
+   point of its stencil. The charge is assigned to a local real mesh
+   that has cao-1 ghost planes on the high side in y and z, which are
+   folded onto the neighbors after the assignment. For the force
+   interpolation the ghost planes are filled from the neighbors again.
+   Every rank needs at least cao-1 planes in y and z for this.
+
+   Every rank only stores its own particles, with their global ids.
+   Before each force calculation the particles whose stencil moved into
+   another pencil are sent to the owner of that pencil. The forces are
+   returned for the rank's particles only. */
+
+#if defined(SINGLE_PREC)
+#define MPI_FLOAT_TYPE MPI_FLOAT
+#elif defined(LONG_DOUBLE_PREC)
+#define MPI_FLOAT_TYPE MPI_LONG_DOUBLE
+#else
+#define MPI_FLOAT_TYPE MPI_DOUBLE
+#endif
+
+// declaration of the method
+
+/* Only nshift comes from Init_data, the distributed meshes are allocated here. */
+const method_t method_p3m_ik_mpi = { METHOD_P3M_ik_mpi, "P3M with ik differentiation, not intelaced, distributed over MPI ranks.", "p3m-ik-mpi",
+                                     METHOD_FLAG_nshift,
+                                     &Init_ik_mpi, &Influence_function_ik_mpi, &P3M_ik_mpi, &Error_ik, &Error_ik_k,
+                                     &Free_ik_mpi,
+                                   };
+
+/* All-to-all transpose of one pencil stage into the next within a
+   row or column of the process grid. The source is [n0][n1][K] with K
+   complete, the destination gets K split over the P ranks and the
+   dimension gd (0 or 1) of the source, which is split over the ranks,
+   complete as its last dimension G. */
+typedef struct {
+  MPI_Comm comm;
+  int P, me, gd, n_other, K, G;
+  int *kstart, *gstart;
+  int *scount, *sdispl, *rcount, *rdispl;
+} transpose_t;
+
+typedef struct {
+  MPI_Comm cart, comm[2];
+  int dims[2], coords[2];
+  /* Ranks below and above in y (0) and z (1) */
+  int low[2], high[2];
+  /* Pencil sizes and offsets, y and z in stage X, x in stage Y and Z,
+     y in stage Z. */
+  int ny0, y0, nz1, z1, nx0, x0, ny1, y1;
+  /* Ghost planes and padded size of the real meshes */
+  int g, py, pz;
+  transpose_t t[2];
+  FFTW_COMPLEX *mx, *my, *mq, *mf, *sbuf, *rbuf;
+  FLOAT_TYPE *qpad, *fpad[3], *hs, *hr;
+  /* Cart rank of the process grid coordinates (cy, cz) at cy*dims[1] + cz */
+  int nprocs, *rank_of;
+  /* Particles of this rank, positions, charges and global ids, the
+     stencil start and weights of the charge assignment and the forces
+     f[3*i + dim]. The arrays have room for capacity particles. */
+  int nlocal, capacity;
+  FLOAT_TYPE *pos[3], *q;
+  int *gid, *base;
+  FLOAT_TYPE *w, *f;
+  /* Per rank counts and displacements of the migration */
+  int *scount, *sdispl, *rcount, *rdispl;
+} ik_mpi_t;
+
+static int block_start(int n, int P, int r) {
+  return (int)(((long)r*n)/P);
+}
+
+static int block_size(int n, int P, int r) {
+  return block_start(n, P, r+1) - block_start(n, P, r);
+}
+
+/* The r with block_start(n, P, r) <= i < block_start(n, P, r+1). */
+static int block_of(int n, int P, int i) {
+  int r = (int)(((long)i*P)/n);
+
+  while(block_start(n, P, r+1) <= i)
+    r++;
+  while(block_start(n, P, r) > i)
+    r--;
+
+  return r;
+}
+
+static void Init_transpose(transpose_t *t, MPI_Comm comm, int gd, int n_other, int K, int G) {
+  int r, ng;
+
+  t->comm = comm;
+  MPI_Comm_size(comm, &t->P);
+  MPI_Comm_rank(comm, &t->me);
+  t->gd = gd;
+  t->n_other = n_other;
+  t->K = K;
+  t->G = G;
+
+  t->kstart = Init_array(t->P+1, sizeof(int));
+  t->gstart = Init_array(t->P+1, sizeof(int));
+  t->scount = Init_array(t->P, sizeof(int));
+  t->sdispl = Init_array(t->P, sizeof(int));
+  t->rcount = Init_array(t->P, sizeof(int));
+  t->rdispl = Init_array(t->P, sizeof(int));
+
+  for(r = 0; r <= t->P; r++) {
+    t->kstart[r] = block_start(K, t->P, r);
+    t->gstart[r] = block_start(G, t->P, r);
+  }
+
+  ng = block_size(G, t->P, t->me);
+
+  /* Counts in FLOAT_TYPE, two per complex value */
+  for(r = 0; r < t->P; r++) {
+    t->scount[r] = 2*ng*n_other*block_size(K, t->P, r);
+    t->rcount[r] = 2*block_size(G, t->P, r)*n_other*block_size(K, t->P, t->me);
+    t->sdispl[r] = (r > 0) ? t->sdispl[r-1] + t->scount[r-1] : 0;
+    t->rdispl[r] = (r > 0) ? t->rdispl[r-1] + t->rcount[r-1] : 0;
+  }
+}
+
+static void Free_transpose(transpose_t *t) {
+  Free_array(t->kstart);
+  Free_array(t->gstart);
+  Free_array(t->scount);
+  Free_array(t->sdispl);
+  Free_array(t->rcount);
+  Free_array(t->rdispl);
+}
+
+inline static void copy_complex(FFTW_COMPLEX *a, FFTW_COMPLEX *buf, int to_buf) {
+  if(to_buf) {
+    (*buf)[0] = (*a)[0];
+    (*buf)[1] = (*a)[1];
+  } else {
+    (*a)[0] = (*buf)[0];
+    (*a)[1] = (*buf)[1];
+  }
+}
+
+/* Copies the source pencil from or to the send order, which is by
+   destination rank. */
+static void pack_source(const transpose_t *t, FFTW_COMPLEX *src, FFTW_COMPLEX *buf, int to_buf) {
+  const int ng = block_size(t->G, t->P, t->me);
+  const int n0 = (t->gd == 0) ? ng : t->n_other;
+  const int n1 = (t->gd == 0) ? t->n_other : ng;
+  int r, i, j, k, c = 0;
+
+  for(r = 0; r < t->P; r++)
+    for(i = 0; i < n0; i++)
+      for(j = 0; j < n1; j++) {
+        FFTW_COMPLEX *line = src + (i*n1 + j)*t->K;
+        for(k = t->kstart[r]; k < t->kstart[r+1]; k++)
+          copy_complex(line + k, buf + c++, to_buf);
+      }
+}
+
+/* Copies the destination pencil from or to the receive order, which
+   is by source rank. */
+static void pack_destination(const transpose_t *t, FFTW_COMPLEX *dst, FFTW_COMPLEX *buf, int to_buf) {
+  const int nk = block_size(t->K, t->P, t->me);
+  int r, i, j, k, c = 0;
+
+  for(r = 0; r < t->P; r++) {
+    const int ng = block_size(t->G, t->P, r);
+    const int n0 = (t->gd == 0) ? ng : t->n_other;
+    const int n1 = (t->gd == 0) ? t->n_other : ng;
+
+    for(i = 0; i < n0; i++)
+      for(j = 0; j < n1; j++)
+        for(k = 0; k < nk; k++) {
+          const int ind = (t->gd == 0) ? (k*t->n_other + j)*t->G + t->gstart[r] + i : (i*nk + k)*t->G + t->gstart[r] + j;
+          copy_complex(dst + ind, buf + c++, to_buf);
+        }
+  }
+}
+
+static void transpose(const transpose_t *t, FFTW_COMPLEX *src, FFTW_COMPLEX *dst, FFTW_COMPLEX *sbuf, FFTW_COMPLEX *rbuf) {
+  pack_source(t, src, sbuf, 1);
+  MPI_Alltoallv(sbuf, t->scount, t->sdispl, MPI_FLOAT_TYPE, rbuf, t->rcount, t->rdispl, MPI_FLOAT_TYPE, t->comm);
+  pack_destination(t, dst, rbuf, 0);
+}
+
+static void transpose_back(const transpose_t *t, FFTW_COMPLEX *src, FFTW_COMPLEX *dst, FFTW_COMPLEX *sbuf, FFTW_COMPLEX *rbuf) {
+  pack_destination(t, dst, sbuf, 1);
+  MPI_Alltoallv(sbuf, t->rcount, t->rdispl, MPI_FLOAT_TYPE, rbuf, t->scount, t->sdispl, MPI_FLOAT_TYPE, t->comm);
+  pack_source(t, src, rbuf, 0);
+}
+
+/* Adds the ghost planes of the charge mesh to the neighbors, first
+   the complete y planes including the z ghosts, then the z planes. */
+static void fold_ghosts(ik_mpi_t *m, int M) {
+  const int slab = m->g*m->pz*M;
+  FLOAT_TYPE *q = m->qpad;
+  int y, z, i, c;
+
+  MPI_Sendrecv(q + m->ny0*m->pz*M, slab, MPI_FLOAT_TYPE, m->high[0], 0,
+               m->hr, slab, MPI_FLOAT_TYPE, m->low[0], 0, m->cart, MPI_STATUS_IGNORE);
+  for(i = 0; i < slab; i++)
+    q[i] += m->hr[i];
+
+  for(y = 0, c = 0; y < m->ny0; y++)
+    for(z = m->nz1; z < m->pz; z++, c += M)
+      memcpy(m->hs + c, q + (y*m->pz + z)*M, M*sizeof(FLOAT_TYPE));
+
+  MPI_Sendrecv(m->hs, c, MPI_FLOAT_TYPE, m->high[1], 1,
+               m->hr, c, MPI_FLOAT_TYPE, m->low[1], 1, m->cart, MPI_STATUS_IGNORE);
+
+  for(y = 0, c = 0; y < m->ny0; y++)
+    for(z = 0; z < m->g; z++)
+      for(i = 0; i < M; i++)
+        q[(y*m->pz + z)*M + i] += m->hr[c++];
+}
+
+/* Reverse of fold_ghosts, copies the neighbors' first planes into the
+   ghost planes of a force mesh. */
+static void fill_ghosts(ik_mpi_t *m, int M, FLOAT_TYPE *fm) {
+  int y, z, c;
+
+  for(y = 0, c = 0; y < m->ny0; y++)
+    for(z = 0; z < m->g; z++, c += M)
+      memcpy(m->hs + c, fm + (y*m->pz + z)*M, M*sizeof(FLOAT_TYPE));
+
+  MPI_Sendrecv(m->hs, c, MPI_FLOAT_TYPE, m->low[1], 2,
+               m->hr, c, MPI_FLOAT_TYPE, m->high[1], 2, m->cart, MPI_STATUS_IGNORE);
+
+  for(y = 0, c = 0; y < m->ny0; y++)
+    for(z = m->nz1; z < m->pz; z++, c += M)
+      memcpy(fm + (y*m->pz + z)*M, m->hr + c, M*sizeof(FLOAT_TYPE));
+
+  MPI_Sendrecv(fm, m->g*m->pz*M, MPI_FLOAT_TYPE, m->low[0], 3,
+               fm + m->ny0*m->pz*M, m->g*m->pz*M, MPI_FLOAT_TYPE, m->high[0], 3, m->cart, MPI_STATUS_IGNORE);
+}
+
+data_t *Init_ik_mpi ( system_t *s, parameters_t *p ) {
+  int periods[2] = { 1, 1 }, remain[2];
+  int nprocs, l, M, n;
+  ik_mpi_t *m;
+  data_t *d = Init_data ( &method_p3m_ik_mpi, s, p );
+
+  M = d->grid[0];
+
+  d->Dn = Init_array ( M, sizeof ( FLOAT_TYPE ) );
+  for ( l = 0; l < 3; l++ )
+    d->Dn_axis[l] = d->Dn;
+  Init_differential_operator ( d );
+
+  d->inter = P3M_CA_DIRECT ? Init_interpolation_direct ( p->ip ) : Init_interpolation ( p->ip, 0 );
+
+  m = Init_array ( 1, sizeof ( ik_mpi_t ) );
+  d->method_data = m;
+
+  MPI_Comm_size ( MPI_COMM_WORLD, &nprocs );
+  m->dims[0] = m->dims[1] = 0;
+  MPI_Dims_create ( nprocs, 2, m->dims );
+  MPI_Cart_create ( MPI_COMM_WORLD, 2, m->dims, periods, 0, &m->cart );
+  MPI_Comm_rank ( m->cart, &n );
+  MPI_Cart_coords ( m->cart, n, 2, m->coords );
+
+  for ( l = 0; l < 2; l++ ) {
+    remain[l] = 1;
+    remain[1-l] = 0;
+    MPI_Cart_sub ( m->cart, remain, &m->comm[l] );
+    MPI_Cart_shift ( m->cart, l, 1, &m->low[l], &m->high[l] );
+  }
+
+  m->g = p->cao - 1;
+
+  if ( ( M / m->dims[0] < m->g ) || ( M / m->dims[1] < m->g ) || ( M < m->dims[0] ) || ( M < m->dims[1] ) ) {
+    fprintf ( stderr, "Mesh %d is too small for %d x %d ranks with cao %d.\n", M, m->dims[0], m->dims[1], p->cao );
+    MPI_Abort ( MPI_COMM_WORLD, 1 );
+  }
+
+  m->y0 = block_start ( M, m->dims[0], m->coords[0] );
+  m->ny0 = block_size ( M, m->dims[0], m->coords[0] );
+  m->z1 = block_start ( M, m->dims[1], m->coords[1] );
+  m->nz1 = block_size ( M, m->dims[1], m->coords[1] );
+  m->x0 = block_start ( M, m->dims[0], m->coords[0] );
+  m->nx0 = block_size ( M, m->dims[0], m->coords[0] );
+  m->y1 = block_start ( M, m->dims[1], m->coords[1] );
+  m->ny1 = block_size ( M, m->dims[1], m->coords[1] );
+
+  m->py = m->ny0 + m->g;
+  m->pz = m->nz1 + m->g;
+
+  Init_transpose ( &m->t[0], m->comm[0], 0, m->nz1, M, M );
+  Init_transpose ( &m->t[1], m->comm[1], 1, m->nx0, M, M );
+
+  /* The pencils of the three stages have about the same size */
+  n = m->ny0*m->nz1;
+  if ( m->nx0*m->nz1 > n )
+    n = m->nx0*m->nz1;
+  if ( m->nx0*m->ny1 > n )
+    n = m->nx0*m->ny1;
+  n *= M;
+
+  m->mx = Init_array ( n, sizeof ( FFTW_COMPLEX ) );
+  m->my = Init_array ( n, sizeof ( FFTW_COMPLEX ) );
+  m->mq = Init_array ( n, sizeof ( FFTW_COMPLEX ) );
+  m->mf = Init_array ( n, sizeof ( FFTW_COMPLEX ) );
+  m->sbuf = Init_array ( n, sizeof ( FFTW_COMPLEX ) );
+  m->rbuf = Init_array ( n, sizeof ( FFTW_COMPLEX ) );
+
+  m->qpad = Init_array ( m->py*m->pz*M, sizeof ( FLOAT_TYPE ) );
+  for ( l = 0; l < 3; l++ )
+    m->fpad[l] = Init_array ( m->py*m->pz*M, sizeof ( FLOAT_TYPE ) );
+  /* Halo buffers for the y slab and the packed z planes */
+  n = m->g*M*( ( m->py > m->pz ) ? m->py : m->pz );
+  m->hs = Init_array ( n, sizeof ( FLOAT_TYPE ) );
+  m->hr = Init_array ( n, sizeof ( FLOAT_TYPE ) );
+
+  m->nprocs = nprocs;
+  m->rank_of = Init_array ( nprocs, sizeof ( int ) );
+  for ( l = 0; l < nprocs; l++ ) {
+    const int c[2] = { l / m->dims[1], l % m->dims[1] };
+    MPI_Cart_rank ( m->cart, c, &m->rank_of[l] );
+  }
+  m->scount = Init_array ( nprocs, sizeof ( int ) );
+  m->sdispl = Init_array ( nprocs, sizeof ( int ) );
+  m->rcount = Init_array ( nprocs, sizeof ( int ) );
+  m->rdispl = Init_array ( nprocs, sizeof ( int ) );
+
+  /* The particle arrays grow with the first particles */
+  m->nlocal = m->capacity = 0;
+
+  d->forward_plans = 3;
+  d->backward_plans = 3;
+
+  d->forward_plan[0] = Wisdom_plan_many_dft_1d ( M, m->ny0*m->nz1, m->mx, FFTW_FORWARD );
+  d->forward_plan[1] = Wisdom_plan_many_dft_1d ( M, m->nx0*m->nz1, m->my, FFTW_FORWARD );
+  d->forward_plan[2] = Wisdom_plan_many_dft_1d ( M, m->nx0*m->ny1, m->mq, FFTW_FORWARD );
+
+  d->backward_plan[0] = Wisdom_plan_many_dft_1d ( M, m->nx0*m->ny1, m->mf, FFTW_BACKWARD );
+  d->backward_plan[1] = Wisdom_plan_many_dft_1d ( M, m->nx0*m->nz1, m->my, FFTW_BACKWARD );
+  d->backward_plan[2] = Wisdom_plan_many_dft_1d ( M, m->ny0*m->nz1, m->mx, FFTW_BACKWARD );
+
+  /* Influence function on the stage Z pencil */
+  d->G_hat = Init_array ( m->nx0*m->ny1*M, sizeof ( FLOAT_TYPE ) );
+  Influence_function_ik_mpi ( s, p, d );
+
+  return d;
+}
+
+/* Method data hook, Free_data releases the common parts. */
+void Free_ik_mpi ( void *method_data ) {
+  ik_mpi_t *m = method_data;
+  int l;
+
+  for ( l = 0; l < 2; l++ ) {
+    Free_transpose ( &m->t[l] );
+    MPI_Comm_free ( &m->comm[l] );
+  }
+  MPI_Comm_free ( &m->cart );
+
+  Free_array ( m->mx );
+  Free_array ( m->my );
+  Free_array ( m->mq );
+  Free_array ( m->mf );
+  Free_array ( m->sbuf );
+  Free_array ( m->rbuf );
+  Free_array ( m->qpad );
+  for ( l = 0; l < 3; l++ )
+    Free_array ( m->fpad[l] );
+  Free_array ( m->hs );
+  Free_array ( m->hr );
+  Free_array ( m->rank_of );
+  Free_array ( m->scount );
+  Free_array ( m->sdispl );
+  Free_array ( m->rcount );
+  Free_array ( m->rdispl );
+  if ( m->capacity > 0 ) {
+    for ( l = 0; l < 3; l++ )
+      Free_array ( m->pos[l] );
+    Free_array ( m->q );
+    Free_array ( m->gid );
+    Free_array ( m->base );
+    Free_array ( m->w );
+    Free_array ( m->f );
+  }
+  Free_array ( m );
+}
+
+/* Same influence function as P3M_ik, only on the local pencil. */
+void Influence_function_ik_mpi ( system_t *s, parameters_t *p, data_t *d ) {
+  ik_mpi_t *m = d->method_data;
+  const int M = d->grid[2];
+  int x;
+
+  Set_aliasing_tables ( d, p->cao, d->inter->U_hat );
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for ( x = 0; x < m->nx0; x++ )
+    for ( int y = 0; y < m->ny1; y++ )
+      for ( int z = 0; z < M; z++ )
+        d->G_hat[( x*m->ny1 + y )*M + z] = influence_function_ik ( s, p, d, m->x0 + x, m->y1 + y, z );
+}
+
+/* Grid point of the first point of the stencil of a particle at x. */
+inline static int stencil_start ( FLOAT_TYPE x, FLOAT_TYPE Hi, FLOAT_TYPE pos_shift, int M, FLOAT_TYPE *dist ) {
+  const FLOAT_TYPE pos = x*Hi - pos_shift;
+  const int nmp = ( int ) FLOOR ( pos + 0.5 );
+
+  if ( dist != NULL )
+    *dist = pos - nmp;
+
+  return ( ( nmp % M ) + M ) % M;
+}
+
+/* Rank whose stage X pencil holds the stencil start of particle i. */
+static int owner ( const ik_mpi_t *m, int M, FLOAT_TYPE Hi, FLOAT_TYPE pos_shift, int i ) {
+  const int cy = block_of ( M, m->dims[0], stencil_start ( m->pos[1][i], Hi, pos_shift, M, NULL ) );
+  const int cz = block_of ( M, m->dims[1], stencil_start ( m->pos[2][i], Hi, pos_shift, M, NULL ) );
+
+  return m->rank_of[cy*m->dims[1] + cz];
+}
+
+/* Room for n particles, keeps the positions, charges and ids. */
+static void reserve_particles ( ik_mpi_t *m, int n, int cao ) {
+  const int c = m->capacity;
+  int l;
+
+  if ( n <= c )
+    return;
+
+  if ( n < 2*c )
+    n = 2*c;
+
+  for ( l = 0; l < 3; l++ )
+    m->pos[l] = Resize_array ( m->pos[l], n*sizeof ( FLOAT_TYPE ), c*sizeof ( FLOAT_TYPE ) );
+  m->q = Resize_array ( m->q, n*sizeof ( FLOAT_TYPE ), c*sizeof ( FLOAT_TYPE ) );
+  m->gid = Resize_array ( m->gid, n*sizeof ( int ), c*sizeof ( int ) );
+
+  if ( c > 0 ) {
+    Free_array ( m->base );
+    Free_array ( m->w );
+    Free_array ( m->f );
+  }
+  m->base = Init_array ( 3*n, sizeof ( int ) );
+  m->w = Init_array ( 3*cao*n, sizeof ( FLOAT_TYPE ) );
+  m->f = Init_array ( 3*n, sizeof ( FLOAT_TYPE ) );
+
+  m->capacity = n;
+}
+
+/* Replaces the particles of this rank by x, q with global ids id. They
+   do not have to be in this rank's pencil, they are migrated by the
+   next force calculation. */
+void Set_particles_ik_mpi ( data_t *d, parameters_t *p, int n, FLOAT_TYPE * const x[3], const FLOAT_TYPE *q, const int *id ) {
+  ik_mpi_t *m = d->method_data;
+  int l;
+
+  reserve_particles ( m, n, p->cao );
+  for ( l = 0; l < 3; l++ )
+    memcpy ( m->pos[l], x[l], n*sizeof ( FLOAT_TYPE ) );
+  memcpy ( m->q, q, n*sizeof ( FLOAT_TYPE ) );
+  memcpy ( m->gid, id, n*sizeof ( int ) );
+  m->nlocal = n;
+}
+
+/* Particles of this rank in the order of the forces of the last
+   P3M_ik_mpi_local, the positions may be changed in place. */
+int Local_particles_ik_mpi ( data_t *d, FLOAT_TYPE *x[3], FLOAT_TYPE **q, int **id ) {
+  ik_mpi_t *m = d->method_data;
+  int l;
+
+  for ( l = 0; l < 3; l++ )
+    x[l] = m->pos[l];
+  *q = m->q;
+  *id = m->gid;
+
+  return m->nlocal;
+}
+
+/* Sends the particles that are not in this rank's pencil to their
+   owners. Any rank can be the target, the counts are exchanged first. */
+static void migrate_particles ( system_t *s, parameters_t *p, data_t *d ) {
+  ik_mpi_t *m = d->method_data;
+  const int M = d->grid[0], P = m->nprocs;
+  const FLOAT_TYPE Hi = ( FLOAT_TYPE ) M / s->length;
+  const FLOAT_TYPE pos_shift = ( FLOAT_TYPE ) ( ( p->cao-1 )/2 );
+  int me, i, r, l, nsend = 0, nrecv = 0, nkeep = 0;
+  int *dest, *fill, *sid, *rid;
+  FLOAT_TYPE *sbuf, *rbuf;
+
+  MPI_Comm_rank ( m->cart, &me );
+
+  dest = Init_array ( m->nlocal + 1, sizeof ( int ) );
+  memset ( m->scount, 0, P*sizeof ( int ) );
+  for ( i = 0; i < m->nlocal; i++ ) {
+    dest[i] = owner ( m, M, Hi, pos_shift, i );
+    if ( dest[i] != me ) {
+      m->scount[dest[i]]++;
+      nsend++;
+    }
+  }
+
+  MPI_Alltoall ( m->scount, 1, MPI_INT, m->rcount, 1, MPI_INT, m->cart );
+
+  for ( r = 0; r < P; r++ ) {
+    m->sdispl[r] = ( r > 0 ) ? m->sdispl[r-1] + m->scount[r-1] : 0;
+    m->rdispl[r] = ( r > 0 ) ? m->rdispl[r-1] + m->rcount[r-1] : 0;
+    nrecv += m->rcount[r];
+  }
+
+  /* Pack the leaving particles by destination and compact the others,
+     positions and charges as 4 values, ids separately */
+  fill = Init_array ( P, sizeof ( int ) );
+  memcpy ( fill, m->sdispl, P*sizeof ( int ) );
+  sbuf = Init_array ( 4*nsend + 1, sizeof ( FLOAT_TYPE ) );
+  sid = Init_array ( nsend + 1, sizeof ( int ) );
+
+  for ( i = 0; i < m->nlocal; i++ ) {
+    if ( dest[i] != me ) {
+      const int k = fill[dest[i]]++;
+      for ( l = 0; l < 3; l++ )
+        sbuf[4*k + l] = m->pos[l][i];
+      sbuf[4*k + 3] = m->q[i];
+      sid[k] = m->gid[i];
+    } else {
+      for ( l = 0; l < 3; l++ )
+        m->pos[l][nkeep] = m->pos[l][i];
+      m->q[nkeep] = m->q[i];
+      m->gid[nkeep] = m->gid[i];
+      nkeep++;
+    }
+  }
+
+  rbuf = Init_array ( 4*nrecv + 1, sizeof ( FLOAT_TYPE ) );
+  rid = Init_array ( nrecv + 1, sizeof ( int ) );
+
+  MPI_Alltoallv ( sid, m->scount, m->sdispl, MPI_INT, rid, m->rcount, m->rdispl, MPI_INT, m->cart );
+
+  for ( r = 0; r < P; r++ ) {
+    m->scount[r] *= 4;
+    m->sdispl[r] *= 4;
+    m->rcount[r] *= 4;
+    m->rdispl[r] *= 4;
+  }
+  MPI_Alltoallv ( sbuf, m->scount, m->sdispl, MPI_FLOAT_TYPE, rbuf, m->rcount, m->rdispl, MPI_FLOAT_TYPE, m->cart );
+
+  reserve_particles ( m, nkeep + nrecv, p->cao );
+  for ( i = 0; i < nrecv; i++ ) {
+    for ( l = 0; l < 3; l++ )
+      m->pos[l][nkeep + i] = rbuf[4*i + l];
+    m->q[nkeep + i] = rbuf[4*i + 3];
+    m->gid[nkeep + i] = rid[i];
+  }
+  m->nlocal = nkeep + nrecv;
+
+  Free_array ( dest );
+  Free_array ( fill );
+  Free_array ( sbuf );
+  Free_array ( sid );
+  Free_array ( rbuf );
+  Free_array ( rid );
+}
+
+/* Assigns the charges of the particles of this rank, whose stencils
+   start in its stage X pencil, and remembers their weights. */
+static void assign_charge_local ( system_t *s, parameters_t *p, data_t *d ) {
+  ik_mpi_t *m = d->method_data;
+  const int cao = p->cao, M = d->grid[0];
+  const FLOAT_TYPE Hi = ( FLOAT_TYPE ) M / s->length;
+  const FLOAT_TYPE pos_shift = ( FLOAT_TYPE ) ( ( cao-1 )/2 );
+  const FLOAT_TYPE MI2 = 2.0* ( FLOAT_TYPE ) MaxInterpol;
+  const int start[3] = { 0, m->y0, m->z1 };
+  FLOAT_TYPE * restrict q = m->qpad;
+  int n, dim, i0, i1, i2;
+
+  memset ( q, 0, m->py*m->pz*M*sizeof ( FLOAT_TYPE ) );
+
+  for ( n = 0; n < m->nlocal; n++ ) {
+    int *base = m->base + 3*n;
+    FLOAT_TYPE *w = m->w + 3*cao*n;
+    FLOAT_TYPE dist, tmp0, tmp1;
+
+    for ( dim = 0; dim < 3; dim++ ) {
+      base[dim] = stencil_start ( m->pos[dim][n], Hi, pos_shift, M, &dist ) - start[dim];
+      if ( d->inter->direct )
+        caf_bspline_weights ( cao, dist, w + cao*dim );
+      else
+        memcpy ( w + cao*dim, d->inter->interpol[( int ) FLOOR ( ( dist + 0.5 )*MI2 )], cao*sizeof ( FLOAT_TYPE ) );
+    }
+
+    assert ( ( base[1] >= 0 ) && ( base[1] < m->ny0 ) && ( base[2] >= 0 ) && ( base[2] < m->nz1 ) );
+
+    for ( i0 = 0; i0 < cao; i0++ ) {
+      const int x = ( base[0] + i0 ) % M;
+      tmp0 = m->q[n]*w[i0];
+      for ( i1 = 0; i1 < cao; i1++ ) {
+        tmp1 = tmp0*w[cao + i1];
+        for ( i2 = 0; i2 < cao; i2++ )
+          q[( ( base[1] + i1 )*m->pz + base[2] + i2 )*M + x] += tmp1*w[2*cao + i2];
+      }
+    }
+  }
+}
+
+/* Migrates the particles of this rank to their owners and calculates
+   their k-space forces. Returns the forces f[3*i + dim] of the
+   particles in the order of Local_particles_ik_mpi. The system only
+   provides the box. All ranks have to call this together. */
+const FLOAT_TYPE *P3M_ik_mpi_local ( system_t *s, parameters_t *p, data_t *d ) {
+  ik_mpi_t *m = d->method_data;
+  const int M = d->grid[0], cao = p->cao;
+  const FLOAT_TYPE twopiLeni = 2.0*PI/s->length;
+  const FLOAT_TYPE prefac = 1.0/ ( 2.0*s->box_l[0]*s->box_l[1]*s->box_l[2] );
+  int i, y, z, l, n;
+
+  TIMING_START_C
+
+  migrate_particles ( s, p, d );
+  assign_charge_local ( s, p, d );
+  fold_ghosts ( m, M );
+
+  TIMING_STOP_C
+
+  TIMING_START_G
+
+  for ( y = 0; y < m->ny0; y++ )
+    for ( z = 0; z < m->nz1; z++ )
+      for ( i = 0; i < M; i++ ) {
+        m->mx[( y*m->nz1 + z )*M + i][0] = m->qpad[( y*m->pz + z )*M + i];
+        m->mx[( y*m->nz1 + z )*M + i][1] = 0.0;
+      }
+
+  /* Forward Fast Fourier Transform */
+  FFTW_EXECUTE ( d->forward_plan[0] );
+  transpose ( &m->t[0], m->mx, m->my, m->sbuf, m->rbuf );
+  FFTW_EXECUTE ( d->forward_plan[1] );
+  transpose ( &m->t[1], m->my, m->mq, m->sbuf, m->rbuf );
+  FFTW_EXECUTE ( d->forward_plan[2] );
+
+  for ( l = 0; l < 3; l++ ) {
+    /* Convolution, F = i k G Q */
+    for ( i = 0; i < m->nx0; i++ )
+      for ( y = 0; y < m->ny1; y++ ) {
+        const int k[2] = { m->x0 + i, m->y1 + y };
+        for ( z = 0; z < M; z++ ) {
+          const int ind = ( i*m->ny1 + y )*M + z;
+          const FLOAT_TYPE dop = twopiLeni*d->Dn[( l < 2 ) ? k[l] : z]*d->G_hat[ind];
+
+          m->mf[ind][0] = -dop*m->mq[ind][1];
+          m->mf[ind][1] = dop*m->mq[ind][0];
+        }
+      }
+
+    /* Backward Fast Fourier Transform */
+    FFTW_EXECUTE ( d->backward_plan[0] );
+    transpose_back ( &m->t[1], m->my, m->mf, m->sbuf, m->rbuf );
+    FFTW_EXECUTE ( d->backward_plan[1] );
+    transpose_back ( &m->t[0], m->mx, m->my, m->sbuf, m->rbuf );
+    FFTW_EXECUTE ( d->backward_plan[2] );
+
+    for ( y = 0; y < m->ny0; y++ )
+      for ( z = 0; z < m->nz1; z++ )
+        for ( i = 0; i < M; i++ )
+          m->fpad[l][( y*m->pz + z )*M + i] = m->mx[( y*m->nz1 + z )*M + i][0];
+
+    fill_ghosts ( m, M, m->fpad[l] );
+  }
+
+  TIMING_STOP_G
+
+  TIMING_START_F
+
+  /* Force assignment */
+#ifdef _OPENMP
+#pragma omp parallel for private(l)
+#endif
+  for ( n = 0; n < m->nlocal; n++ ) {
+    const int *base = m->base + 3*n;
+    const FLOAT_TYPE *w = m->w + 3*cao*n;
+    FLOAT_TYPE field[3] = { 0.0, 0.0, 0.0 };
+
+    for ( int i0 = 0; i0 < cao; i0++ ) {
+      const int x = ( base[0] + i0 ) % M;
+      for ( int i1 = 0; i1 < cao; i1++ ) {
+        const FLOAT_TYPE w01 = prefac*m->q[n]*w[i0]*w[cao + i1];
+        for ( int i2 = 0; i2 < cao; i2++ ) {
+          const int ind = ( ( base[1] + i1 )*m->pz + base[2] + i2 )*M + x;
+          const FLOAT_TYPE B = w01*w[2*cao + i2];
+          for ( l = 0; l < 3; l++ )
+            field[l] -= m->fpad[l][ind]*B;
+        }
+      }
+    }
+
+    for ( l = 0; l < 3; l++ )
+      m->f[3*n + l] = field[l];
+  }
+
+  TIMING_STOP_F
+
+  return m->f;
+}
+
+/* Entry point for drivers that keep the whole system on every rank.
+   Each rank only takes its block of N/P particles from s, they are
+   migrated to their owners and the k-space forces are added to f->f_k
+   for the particles the rank owns afterwards. The other entries of
+   f->f_k are not touched, Gather_forces_ik_mpi collects them. */
+void P3M_ik_mpi ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
+  ik_mpi_t *m = d->method_data;
+  const int N = s->nparticles;
+  const FLOAT_TYPE *fl;
+  int me, i, l, n0, n;
+
+  MPI_Comm_rank ( m->cart, &me );
+  n0 = block_start ( N, m->nprocs, me );
+  n = block_size ( N, m->nprocs, me );
+
+  reserve_particles ( m, n, p->cao );
+  for ( l = 0; l < 3; l++ )
+    memcpy ( m->pos[l], s->p->fields[l] + n0, n*sizeof ( FLOAT_TYPE ) );
+  memcpy ( m->q, s->q + n0, n*sizeof ( FLOAT_TYPE ) );
+  for ( i = 0; i < n; i++ )
+    m->gid[i] = n0 + i;
+  m->nlocal = n;
+
+  fl = P3M_ik_mpi_local ( s, p, d );
+
+  for ( i = 0; i < m->nlocal; i++ )
+    for ( l = 0; l < 3; l++ )
+      f->f_k->fields[l][m->gid[i]] += fl[3*i + l];
+}
+
+/* Collects the k-space forces of the last P3M_ik_mpi of all ranks in
+   f->f_k on rank 0 of MPI_COMM_WORLD and updates the total forces
+   there, for the comparison with the reference forces. Only rank 0
+   needs memory for all particles. */
+void Gather_forces_ik_mpi ( system_t *s, data_t *d, forces_t *f ) {
+  ik_mpi_t *m = d->method_data;
+  const int N = s->nparticles;
+  int rank, nprocs, i, l, *counts = NULL, *displ = NULL, *ids = NULL;
+  FLOAT_TYPE *fk = NULL;
+
+  MPI_Comm_rank ( MPI_COMM_WORLD, &rank );
+  MPI_Comm_size ( MPI_COMM_WORLD, &nprocs );
+
+  if ( rank == 0 ) {
+    counts = Init_array ( nprocs, sizeof ( int ) );
+    displ = Init_array ( nprocs, sizeof ( int ) );
+    ids = Init_array ( N, sizeof ( int ) );
+    fk = Init_array ( 3*N, sizeof ( FLOAT_TYPE ) );
+  }
+
+  MPI_Gather ( &m->nlocal, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD );
+
+  if ( rank == 0 )
+    for ( i = 0; i < nprocs; i++ )
+      displ[i] = ( i > 0 ) ? displ[i-1] + counts[i-1] : 0;
+
+  MPI_Gatherv ( m->gid, m->nlocal, MPI_INT, ids, counts, displ, MPI_INT, 0, MPI_COMM_WORLD );
+
+  if ( rank == 0 )
+    for ( i = 0; i < nprocs; i++ ) {
+      counts[i] *= 3;
+      displ[i] *= 3;
+    }
+
+  MPI_Gatherv ( m->f, 3*m->nlocal, MPI_FLOAT_TYPE, fk, counts, displ, MPI_FLOAT_TYPE, 0, MPI_COMM_WORLD );
+
+  if ( rank == 0 ) {
+    for ( i = 0; i < N; i++ )
+      for ( l = 0; l < 3; l++ )
+        f->f_k->fields[l][ids[i]] = fk[3*i + l];
+
+    for ( l = 0; l < 3; l++ )
+      for ( i = 0; i < N; i++ )
+        f->f->fields[l][i] = f->f_k->fields[l][i] + f->f_r->fields[l][i];
+
+    Free_array ( counts );
+    Free_array ( displ );
+    Free_array ( ids );
+    Free_array ( fk );
+  }
+}
@@ -0,0 +1,32 @@
+/**    Copyright (C) 2011,2012,2013,2014 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+#ifndef P3M_IK_MPI_H
+#define P3M_IK_MPI_H
+
+#include "types.h"
+
+data_t *Init_ik_mpi(system_t *, parameters_t *);
+void Influence_function_ik_mpi(system_t *, parameters_t *, data_t *);
+void P3M_ik_mpi(system_t *, parameters_t *, data_t *, forces_t *);
+void Set_particles_ik_mpi(data_t *, parameters_t *, int, FLOAT_TYPE * const [3], const FLOAT_TYPE *, const int *);
+int Local_particles_ik_mpi(data_t *, FLOAT_TYPE *[3], FLOAT_TYPE **, int **);
+const FLOAT_TYPE *P3M_ik_mpi_local(system_t *, parameters_t *, data_t *);
+void Gather_forces_ik_mpi(system_t *, data_t *, forces_t *);
+void Free_ik_mpi(void *);
+
+extern const method_t method_p3m_ik_mpi;
+
+#endif
@@ -76,19 +76,25 @@ void P3M_ik_r_ns ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
     int Mesh = p->mesh;
     int c_index;
 
-    /* Setting charge mesh to zero */
-    memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
+    if ( Charge_mesh_cache_load ( d ) ) {
+      TIMING_START_G
+    } else {
+      /* Setting charge mesh to zero */
+      memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
 
-    TIMING_START_C
+      TIMING_START_C
 
-    /* chargeassignment */
-    assign_charge_real_nostor ( s, p, d );
+      /* chargeassignment */
+      assign_charge_real_nostor ( s, p, d );
 
-    TIMING_STOP_C
-    TIMING_START_G
+      TIMING_STOP_C
+      TIMING_START_G
 
-    /* Forward Fast Fourier Transform */
-    forward_fft(d);
+      /* Forward Fast Fourier Transform */
+      forward_fft(d);
+
+      Charge_mesh_cache_store ( d );
+    }
 
     double q_r, q_i;
 
@@ -0,0 +1,174 @@
+/**    Copyright (C) 2011,2012,2013 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fftw3.h>
+#include <string.h>
+
+// General typ definitions
+#include "types.h"
+#include "common.h"
+#include "p3m-common.h"
+#include "wisdom.h"
+// Charge assignment
+#include "charge-assign.h"
+
+// For realpart error
+#include "realpart.h"
+
+#include "p3m-ik-real-packed.h"
+#include "p3m-ik.h"
+
+/* Real input ik P3M with two backward transforms instead of three.
+   The force components are real, so Fx + i Fy is recovered from one
+   complex backward transform of the full spectrum
+   Fx_hat + i Fy_hat, and Fz from one c2r transform. */
+
+// declaration of the method
+
+const method_t method_p3m_ik_r_p = { METHOD_P3M_ik_r_p, "P3M with ik differentiation, not intelaced, real input, packed backward transforms.", "p3m-ik-r-p",
+                                 METHOD_FLAG_P3M | METHOD_FLAG_ik | METHOD_FLAG_r2c,
+                                 &Init_ik_r_p, &Influence_function_berechnen_ik, &P3M_ik_r_p, &Error_ik, &Error_ik_k,
+                               };
+
+/* Index of (i,j,k) in the r2c half spectrum. */
+#define h_ind(A,B,C) (2*(Mesh*(Mesh/2+1)*(A) + (Mesh/2+1)*(B) + (C)))
+
+data_t *Init_ik_r_p ( system_t *s, parameters_t *p ) {
+    int mesh = p->mesh;
+
+    data_t *d = Init_data ( &method_p3m_ik_r_p, s, p );
+
+    d->forward_plans = 1;
+    d->backward_plans = 2;
+
+    d->forward_plan[0] = Wisdom_plan_dft_r2c_3d ( mesh, mesh, mesh, d->Qmesh, (FFTW_COMPLEX *)d->Qmesh );
+
+    /* Fx + i Fy on the full complex mesh */
+    d->backward_plan[0] = Wisdom_plan_dft_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[0] ), ( FFTW_COMPLEX * ) ( d->Fmesh->fields[0] ), FFTW_BACKWARD );
+    d->backward_plan[1] = Wisdom_plan_dft_c2r_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[2] ), ( d->Fmesh->fields[2] ) );
+
+    return d;
+}
+
+/* Splits the complex field Fx + i Fy in Fmesh[0] into the real r2c
+   layout of Fmesh[0] and Fmesh[1]. The real index never exceeds the
+   complex one, so this works in place going forward. */
+
+static void unpack_forces ( int Mesh, data_t *d ) {
+    FLOAT_TYPE * restrict fx = d->Fmesh->fields[0];
+    FLOAT_TYPE * restrict fy = d->Fmesh->fields[1];
+    int r_index, c_index = 0;
+
+    for ( int i=0; i<Mesh; i++ ) {
+      for ( int j=0; j<Mesh; j++ ) {
+	r_index = (Mesh+2)*(Mesh*i + j);
+	for ( int k=0; k<Mesh; k++, c_index += 2 ) {
+	  fy[r_index+k] = fx[c_index+1];
+	  fx[r_index+k] = fx[c_index];
+	}
+      }
+    }
+}
+
+/* Calculates k-space part of the force, using ik-differentiation.
+ */
+
+void P3M_ik_r_p ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
+    /* Loop counters */
+    int i, j, k;
+    /* helper variables */
+    FLOAT_TYPE T1, q_r, q_i, dx, dy, dz;
+
+    const FLOAT_TYPE twopiLeni = 2.0*PI/s->length;
+
+    const int Mesh = p->mesh;
+    int h_index;
+
+    FLOAT_TYPE * restrict Fxy = d->Fmesh->fields[0];
+    FLOAT_TYPE * restrict Fz = d->Fmesh->fields[2];
+
+    if ( Charge_mesh_cache_load ( d ) ) {
+      TIMING_START_G
+    } else {
+      /* Setting charge mesh to zero */
+      memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
+
+      TIMING_START_C
+
+      assign_charge_real ( s, p, d );
+
+      TIMING_STOP_C
+      TIMING_START_G
+
+      /* Forward Fast Fourier Transform */
+      FFTW_EXECUTE ( d->forward_plan[0] );
+
+      Charge_mesh_cache_store ( d );
+    }
+
+    /* Convolution, the upper half of the spectrum follows from
+       Q(-k) = conj(Q(k)). */
+    for ( i=0; i<Mesh; i++ ) {
+      for ( j=0; j<Mesh; j++ ) {
+	for ( k=0; k<Mesh; k++ ) {
+	  if ( k <= Mesh/2 ) {
+	    h_index = h_ind ( i, j, k );
+	    q_r = d->Qmesh[h_index];
+	    q_i = d->Qmesh[h_index+1];
+	  } else {
+	    h_index = h_ind ( (Mesh-i)%Mesh, (Mesh-j)%Mesh, Mesh-k );
+	    q_r =  d->Qmesh[h_index];
+	    q_i = -d->Qmesh[h_index+1];
+	  }
+
+	  /* G_hat is stored on the half spectrum like Qmesh */
+	  T1 = twopiLeni*d->G_hat[h_index/2];
+	  q_r *= T1;
+	  q_i *= T1;
+
+	  dx = d->Dn[i];
+	  dy = d->Dn[j];
+
+	  /* i Dx q + i (i Dy q) */
+	  Fxy[c_ind ( i,j,k )]   = -dx*q_i - dy*q_r;
+	  Fxy[c_ind ( i,j,k )+1] =  dx*q_r - dy*q_i;
+
+	  if ( k <= Mesh/2 ) {
+	    dz = d->Dn[k];
+	    Fz[h_index]   = -dz*q_i;
+	    Fz[h_index+1] =  dz*q_r;
+	  }
+	}
+      }
+    }
+
+    /* Backward Fast Fourier Transformation */
+    FFTW_EXECUTE ( d->backward_plan[0] );
+    FFTW_EXECUTE ( d->backward_plan[1] );
+
+    unpack_forces ( Mesh, d );
+
+    TIMING_STOP_G
+    TIMING_START_F
+
+    /* Force assignment */
+    assign_forces_real ( 1.0/ ( 2.0*s->length*s->length*s->length ),s,p,d,f);
+
+    TIMING_STOP_F
+}
@@ -24,6 +24,7 @@
 #include "types.h"
 #include "common.h"
 #include "p3m-common.h"
+#include "wisdom.h"
 // Charge assignment
 #include "charge-assign.h"
 
@@ -41,14 +42,15 @@
 // declaration of the method
 
 const method_t method_p3m_ik_r = { METHOD_P3M_ik_r, "P3M with ik differentiation, not intelaced, real input.", "p3m-ik-r",
-                                 METHOD_FLAG_P3M | METHOD_FLAG_ik,
-                                 &Init_ik_r, &Influence_function_berechnen_ik, &P3M_ik_r, &Error_ik, &Error_ik_k,
+                                 METHOD_FLAG_P3M | METHOD_FLAG_ik | METHOD_FLAG_r2c | METHOD_FLAG_mesh_float,
+                                 &Init_ik_r, &Influence_function_berechnen_ik_r, &P3M_ik_r, &Error_ik, &Error_ik_k,
                                };
 
 // Forward declaration of local functions
 
 static void forward_fft ( data_t * );
 static void backward_fft ( data_t * );
+static void P3M_ik_r_float ( system_t *, parameters_t *, data_t *, forces_t * );
 
 inline void forward_fft ( data_t *d ) {
     FFTW_EXECUTE ( d->forward_plan[0] );
@@ -66,17 +68,69 @@ data_t *Init_ik_r ( system_t *s, parameters_t *p ) {
 
     data_t *d = Init_data ( &method_p3m_ik_r, s, p );
 
+    if ( P3M_MESH_FLOAT ) {
+      /* Init_data did not allocate the double meshes and G_hat, there
+         are no double plans. r2c layout, the last dimension is padded
+         to mesh+2 */
+      const int size = mesh*mesh*(mesh+2);
+      d->Qmesh_f = (float *)fftwf_malloc ( size*sizeof ( float ) );
+      d->G_hat_f = (float *)fftwf_malloc ( mesh*mesh*d->G_hat_nz*sizeof ( float ) );
+      d->forward_plan_f = Wisdom_plan_dft_r2c_3d_float ( mesh, mesh, mesh, d->Qmesh_f, (fftwf_complex *)d->Qmesh_f );
+      for ( l=0;l<3;l++ ) {
+        d->Fmesh_f[l] = (float *)fftwf_malloc ( size*sizeof ( float ) );
+        d->backward_plan_f[l] = Wisdom_plan_dft_c2r_3d_float ( mesh, mesh, mesh, (fftwf_complex *)d->Fmesh_f[l], d->Fmesh_f[l] );
+      }
+      if ( d->G_hat != NULL ) {
+        /* Tuning dummy from Init_data */
+        for ( l=0;l<mesh*mesh*d->G_hat_nz;l++ )
+          d->G_hat_f[l] = d->G_hat[l];
+      } else {
+        Influence_function_berechnen_ik_r ( s, p, d );
+      }
+      return d;
+    }
+
     d->forward_plans = 1;
     d->backward_plans = 3;
 
-    d->forward_plan[0] = FFTW_PLAN_DFT_R2C_3D ( mesh, mesh, mesh, d->Qmesh, (FFTW_COMPLEX *)d->Qmesh, FFTW_PATIENT );
+    d->forward_plan[0] = Wisdom_plan_dft_r2c_3d ( mesh, mesh, mesh, d->Qmesh, (FFTW_COMPLEX *)d->Qmesh );
 
     for ( l=0;l<3;l++ ) {
-        d->backward_plan[l] = FFTW_PLAN_DFT_C2R_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), ( d->Fmesh->fields[l] ), FFTW_PATIENT );
+        d->backward_plan[l] = Wisdom_plan_dft_c2r_3d ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), ( d->Fmesh->fields[l] ) );
+    }
+
+    if ( P3M_PADDED_MESH ) {
+      int pmesh = mesh + p->cao - 1;
+      d->Qmesh_pad = (FLOAT_TYPE *)Init_array ( pmesh*pmesh*pmesh, sizeof ( FLOAT_TYPE ) );
+      d->Fmesh_pad = Init_vector_array ( pmesh*pmesh*pmesh );
     }
     return d;
 }
 
+/* Influence function as for ik, with the single precision copy
+   for the mixed precision mode. There the double G_hat is only a
+   temporary, unless it is the shared tuning dummy. */
+
+void Influence_function_berechnen_ik_r ( system_t *s, parameters_t *p, data_t *d ) {
+    const int size = p->mesh*p->mesh*d->G_hat_nz;
+    const int tmp = ( d->G_hat_f != NULL ) && ( d->G_hat == NULL );
+
+    if ( tmp )
+      d->G_hat = (FLOAT_TYPE *)Init_array ( size, sizeof ( FLOAT_TYPE ) );
+
+    Influence_function_berechnen_ik ( s, p, d );
+
+    if ( d->G_hat_f != NULL ) {
+      for ( int l=0;l<size;l++ )
+        d->G_hat_f[l] = d->G_hat[l];
+    }
+
+    if ( tmp ) {
+      FFTW_FREE ( d->G_hat );
+      d->G_hat = NULL;
+    }
+}
+
 /* Calculates k-space part of the force, using ik-differentiation.
  */
 
@@ -91,46 +145,62 @@ void P3M_ik_r ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
     const FLOAT_TYPE Leni = 1.0/s->length;
 
     const int Mesh = p->mesh;
-    int c_index;
+    int ind = 0;
 
-    /* Setting charge mesh to zero */
-    memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
+    if ( d->Qmesh_f != NULL ) {
+      P3M_ik_r_float ( s, p, d, f );
+      return;
+    }
 
-    TIMING_START_C
+    if ( Charge_mesh_cache_load ( d ) ) {
+      TIMING_START_G
+    } else {
+      /* Setting charge mesh to zero */
+      memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
+
+      TIMING_START_C
+
+      /* chargeassignment */
+      if ( d->Qmesh_pad != NULL ) {
+        const int pmesh = Mesh + p->cao - 1;
+        memset ( d->Qmesh_pad, 0, pmesh*pmesh*pmesh*sizeof ( FLOAT_TYPE ) );
+        assign_charge_real_padded ( s, p, d );
+        fold_padded_mesh_real ( p, d );
+      } else {
+        assign_charge_real ( s, p, d );
+      }
 
-    /* chargeassignment */
-    assign_charge_real ( s, p, d );
+      TIMING_STOP_C
+      TIMING_START_G
 
-    TIMING_STOP_C
-    TIMING_START_G
+      /* Forward Fast Fourier Transform */
+      forward_fft(d);
 
-    /* Forward Fast Fourier Transform */
-    forward_fft(d);
+      Charge_mesh_cache_store ( d );
+    }
 
     double q_r, q_i;
 
-    /* Convolution */
+    /* Convolution, G_hat and Qmesh share the half spectrum layout */
     for ( i=0; i<Mesh; i++ ) {
       for ( j=0; j<Mesh; j++ ) {
-	for ( k=0; k<(Mesh/2+1); k++ ) {
-	  c_index = 2*(Mesh*(Mesh/2+1)* i + (Mesh/2+1)*j + k);
-
-	  T1 = d->G_hat[r_ind ( i,j,k ) ];
+	for ( k=0; k<(Mesh/2+1); k++, ind++ ) {
+	  T1 = d->G_hat[ind];
 
-	  q_r = d->Qmesh[c_index] *T1;
-	  q_i = d->Qmesh[c_index+1] *T1;
+	  q_r = d->Qmesh[2*ind] *T1;
+	  q_i = d->Qmesh[2*ind+1] *T1;
 
 	  dop = d->Dn[i];	 
-	  d->Fmesh->fields[0][c_index]   =  -2.0*PI*Leni*dop*q_i;
-	  d->Fmesh->fields[0][c_index+1] =   2.0*PI*Leni*dop*q_r;
+	  d->Fmesh->fields[0][2*ind]   =  -2.0*PI*Leni*dop*q_i;
+	  d->Fmesh->fields[0][2*ind+1] =   2.0*PI*Leni*dop*q_r;
 
 	  dop = d->Dn[j];
-	  d->Fmesh->fields[1][c_index]   =  -2.0*PI*Leni*dop*q_i;
-	  d->Fmesh->fields[1][c_index+1] =   2.0*PI*Leni*dop*q_r;
+	  d->Fmesh->fields[1][2*ind]   =  -2.0*PI*Leni*dop*q_i;
+	  d->Fmesh->fields[1][2*ind+1] =   2.0*PI*Leni*dop*q_r;
 
 	  dop = d->Dn[k];
-	  d->Fmesh->fields[2][c_index]   =  -2.0*PI*Leni*dop*q_i;
-	  d->Fmesh->fields[2][c_index+1] =   2.0*PI*Leni*dop*q_r;
+	  d->Fmesh->fields[2][2*ind]   =  -2.0*PI*Leni*dop*q_i;
+	  d->Fmesh->fields[2][2*ind+1] =   2.0*PI*Leni*dop*q_r;
 	}
       }
     }
@@ -141,8 +211,67 @@ void P3M_ik_r ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
     TIMING_START_F
 
     /* Force assignment */
-    assign_forces_real ( 1.0/ ( 2.0*s->length*s->length*s->length ),s,p,d,f);
+    if ( d->Fmesh_pad != NULL ) {
+      mirror_padded_mesh_real ( p, d );
+      assign_forces_real_padded ( 1.0/ ( 2.0*s->length*s->length*s->length ),s,p,d,f);
+    } else {
+      assign_forces_real ( 1.0/ ( 2.0*s->length*s->length*s->length ),s,p,d,f);
+    }
 
     TIMING_STOP_F
 }
 
+/* Mixed precision variant, mesh, influence function and ffts in single
+   precision, positions and force accumulation in double. */
+
+static void P3M_ik_r_float ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
+    int i, j, k, l;
+    const int Mesh = p->mesh;
+    const float twopiLeni = 2.0*PI/s->length;
+    int ind = 0;
+    float T1, dop, q_r, q_i;
+
+    memset ( d->Qmesh_f, 0, Mesh*Mesh*(Mesh+2)*sizeof ( float ) );
+
+    TIMING_START_C
+
+    assign_charge_real_float ( s, p, d );
+
+    TIMING_STOP_C
+    TIMING_START_G
+
+    fftwf_execute ( d->forward_plan_f );
+
+    for ( i=0; i<Mesh; i++ ) {
+      for ( j=0; j<Mesh; j++ ) {
+	for ( k=0; k<(Mesh/2+1); k++, ind++ ) {
+	  T1 = d->G_hat_f[ind];
+
+	  q_r = d->Qmesh_f[2*ind] *T1;
+	  q_i = d->Qmesh_f[2*ind+1] *T1;
+
+	  dop = twopiLeni*d->Dn[i];
+	  d->Fmesh_f[0][2*ind]   = -dop*q_i;
+	  d->Fmesh_f[0][2*ind+1] =  dop*q_r;
+
+	  dop = twopiLeni*d->Dn[j];
+	  d->Fmesh_f[1][2*ind]   = -dop*q_i;
+	  d->Fmesh_f[1][2*ind+1] =  dop*q_r;
+
+	  dop = twopiLeni*d->Dn[k];
+	  d->Fmesh_f[2][2*ind]   = -dop*q_i;
+	  d->Fmesh_f[2][2*ind+1] =  dop*q_r;
+	}
+      }
+    }
+
+    for ( l=0;l<3;l++ )
+      fftwf_execute ( d->backward_plan_f[l] );
+
+    TIMING_STOP_G
+    TIMING_START_F
+
+    assign_forces_real_float ( 1.0/ ( 2.0*s->length*s->length*s->length ),s,p,d,f);
+
+    TIMING_STOP_F
+}
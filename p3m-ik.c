@@ -25,6 +25,7 @@
 #include "types.h"
 #include "common.h"
 #include "p3m-common.h"
+#include "wisdom.h"
 // Charge assignment
 #include "charge-assign.h"
 
@@ -44,7 +45,7 @@
 // declaration of the method
 
 const method_t method_p3m_ik = { METHOD_P3M_ik, "P3M with ik differentiation, not intelaced.", "p3m-ik",
-                                 METHOD_FLAG_P3M | METHOD_FLAG_ik,
+                                 METHOD_FLAG_P3M | METHOD_FLAG_ik | METHOD_FLAG_noncubic,
                                  &Init_ik, &Influence_function_berechnen_ik, &P3M_ik, &Error_ik, &Error_ik_k,
                                };
 
@@ -54,9 +55,11 @@ static void forward_fft ( data_t * );
 static void backward_fft ( data_t * );
 static void p3m_tune_aliasing_sums_ik ( int, int, int,
                                         const system_t *, const parameters_t *,
+                                        const aliasing_table_t *,
                                         FLOAT_TYPE *, FLOAT_TYPE * );
 
 FLOAT_TYPE p3m_k_space_error_ik ( FLOAT_TYPE prefac, const system_t *s, const parameters_t *p );
+static FLOAT_TYPE p3m_k_space_error_ik_noncubic ( const system_t *s, const parameters_t *p );
 
 inline void forward_fft ( data_t *d ) {
     FFTW_EXECUTE ( d->forward_plan[0] );
@@ -74,102 +77,95 @@ FLOAT_TYPE Error_ik_k( system_t *s, parameters_t *p ) {
 
 data_t *Init_ik ( system_t *s, parameters_t *p ) {
     int l;
-    int mesh = p->mesh;
 
     data_t *d = Init_data ( &method_p3m_ik, s, p );
+    const int *grid = d->grid;
 
     d->forward_plans = 1;
     d->backward_plans = 3;
 
-    d->forward_plan[0] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD, FFTW_PATIENT );
+    d->forward_plan[0] = Wisdom_plan_dft_3d ( grid[0], grid[1], grid[2], ( FFTW_COMPLEX * ) d->Qmesh, ( FFTW_COMPLEX * ) d->Qmesh, FFTW_FORWARD );
 
     for ( l=0;l<3;l++ ) {
-        d->backward_plan[l] = FFTW_PLAN_DFT_3D ( mesh, mesh, mesh, ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), FFTW_BACKWARD, FFTW_PATIENT );
+        d->backward_plan[l] = Wisdom_plan_dft_3d ( grid[0], grid[1], grid[2], ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), ( FFTW_COMPLEX * ) ( d->Fmesh->fields[l] ), FFTW_BACKWARD );
     }
+
+    if ( P3M_INCREMENTAL )
+      Init_charge_incremental ( s, d );
+
     return d;
 }
 
 
 void Aliasing_sums_ik ( system_t *s, parameters_t *p, data_t *d, int NX, int NY, int NZ,
                         FLOAT_TYPE *Zaehler, FLOAT_TYPE *Nenner ) {
-    FLOAT_TYPE S1,S2,S3;
-    FLOAT_TYPE fak1,fak2,zwi;
+    const aliasing_table_t *const *t = d->alias;
+    const int nm = 2*t[0]->mc+1;
+    const int nx = d->nshift_axis[0][NX], ny = d->nshift_axis[1][NY], nz = d->nshift_axis[2][NZ];
+    const FLOAT_TYPE *ux = t[0]->u2 + Aliasing_row ( t[0], nx );
+    const FLOAT_TYPE *uy = t[1]->u2 + Aliasing_row ( t[1], ny );
+    const FLOAT_TYPE *uz = t[2]->u2 + Aliasing_row ( t[2], nz );
+    FLOAT_TYPE kx[nm], ky[nm], kz[nm], ex[nm], ey[nm], ez[nm];
+    FLOAT_TYPE S2, S3, E2, K2, zwi;
+    FLOAT_TYPE zx = 0.0, zy = 0.0, zz = 0.0, n = 0.0;
     int    MX,MY,MZ;
-    FLOAT_TYPE NMX,NMY,NMZ;
-    FLOAT_TYPE NM2;
-    FLOAT_TYPE expo, TE;
-    int Mesh = d->mesh;
-    FLOAT_TYPE Leni = 1.0/s->length;
-    FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE) = d->inter->U_hat;
-
-    fak1 = 1.0/ ( FLOAT_TYPE ) Mesh;
-    fak2 = SQR ( PI/ ( p->alpha ) );
-
-    Zaehler[0] = Zaehler[1] = Zaehler[2] = *Nenner = 0.0;
-
-    for ( MX = -P3M_BRILLOUIN; MX <= P3M_BRILLOUIN; MX++ ) {
-        NMX = d->nshift[NX] + Mesh*MX;
-        S1 = my_power ( U_hat ( p->cao, fak1*NMX ), 2 );
-        for ( MY = -P3M_BRILLOUIN; MY <= P3M_BRILLOUIN; MY++ ) {
-            NMY = d->nshift[NY] + Mesh*MY;
-            S2   = S1*my_power ( U_hat ( p->cao, fak1*NMY ), 2 );
-            for ( MZ = -P3M_BRILLOUIN; MZ <= P3M_BRILLOUIN; MZ++ ) {
-                NMZ = d->nshift[NZ] + Mesh*MZ;
-                S3   = S2*my_power ( U_hat ( p->cao, fak1*NMZ ), 2 );
-
-                NM2 = SQR ( NMX*Leni ) + SQR ( NMY*Leni ) + SQR ( NMZ*Leni );
-                *Nenner += S3;
-
-                expo = fak2*NM2;
-                TE = EXP ( -expo );
-                zwi  = S3 * TE/NM2;
-                Zaehler[0] += NMX*zwi*Leni;
-                Zaehler[1] += NMY*zwi*Leni;
-                Zaehler[2] += NMZ*zwi*Leni;
+
+    /* The window and Gaussian factorize over the axes, so they are
+       evaluated once per axis and the inner loop is plain arithmetic. */
+    Aliasing_factors ( p, t[0], s->box_l[0], nx, kx, ex );
+    Aliasing_factors ( p, t[1], s->box_l[1], ny, ky, ey );
+    Aliasing_factors ( p, t[2], s->box_l[2], nz, kz, ez );
+
+    for ( MX = 0; MX < nm; MX++ ) {
+        for ( MY = 0; MY < nm; MY++ ) {
+            S2 = ux[MX]*uy[MY];
+            E2 = ex[MX]*ey[MY];
+            K2 = SQR ( kx[MX] ) + SQR ( ky[MY] );
+            for ( MZ = 0; MZ < nm; MZ++ ) {
+                S3 = S2*uz[MZ];
+                n += S3;
+
+                zwi = S3 * E2*ez[MZ] / ( K2 + SQR ( kz[MZ] ) );
+                zx += kx[MX]*zwi;
+                zy += ky[MY]*zwi;
+                zz += kz[MZ]*zwi;
             }
         }
     }
-}
 
-/* Calculate influence function */
-void Influence_function_berechnen_ik ( system_t *s, parameters_t *p, data_t *d ) {
+    Zaehler[0] = zx;
+    Zaehler[1] = zy;
+    Zaehler[2] = zz;
+    *Nenner = n;
+}
 
-  int    NX,NY,NZ;
+/* Influence function at one mesh point */
+FLOAT_TYPE influence_function_ik ( system_t *s, parameters_t *p, data_t *d, int NX, int NY, int NZ ) {
   FLOAT_TYPE Dnx,Dny,Dnz;
   FLOAT_TYPE Zaehler[3]={0.0,0.0,0.0},Nenner=0.0;
   FLOAT_TYPE zwi;
-  int ind = 0;
-  int Mesh = p->mesh;
-  FLOAT_TYPE Leni = 1.0/s->length;
-  for ( NX=0; NX<Mesh; NX++ ) {
-    Dnx = d->Dn[NX];
-    for ( NY=0; NY<Mesh; NY++ ) {
-      Dny = d->Dn[NY];
-#ifdef _OPENMP
-#pragma omp parallel for private(NZ, ind, Zaehler, Nenner, Dnz, zwi)
-#endif
-      for ( NZ=0; NZ<Mesh; NZ++ ) {
-	ind = r_ind ( NX, NY, NZ );
-	  
-	if ( ( NX==0 ) && ( NY==0 ) && ( NZ==0 ) )
-	  d->G_hat[ind]=0.0;
-	else if ( ( NX% ( Mesh/2 ) == 0 ) && ( NY% ( Mesh/2 ) == 0 ) && ( NZ% ( Mesh/2 ) == 0 ) )
-	  d->G_hat[ind]=0.0;
-	else {
-	  Aliasing_sums_ik ( s, p, d, NX, NY, NZ, Zaehler, &Nenner );
-		  
-	  Dnz = d->Dn[NZ];
-	    
-	  zwi  = Dnx*Zaehler[0]*Leni + Dny*Zaehler[1]*Leni + Dnz*Zaehler[2]*Leni;
-	  zwi /= ( ( SQR ( Dnx*Leni ) + SQR ( Dny*Leni ) + SQR ( Dnz*Leni ) ) * SQR ( Nenner ) );
-	  d->G_hat[ind] = 2.0 * zwi / PI;
-	}
-      }
-    }
-  }
-#ifdef _OPENMP
-#pragma omp barrier
-#endif
+
+  if ( ( NX==0 ) && ( NY==0 ) && ( NZ==0 ) )
+    return 0.0;
+  if ( ( NX% ( d->grid[0]/2 ) == 0 ) && ( NY% ( d->grid[1]/2 ) == 0 ) && ( NZ% ( d->grid[2]/2 ) == 0 ) )
+    return 0.0;
+
+  Aliasing_sums_ik ( s, p, d, NX, NY, NZ, Zaehler, &Nenner );
+
+  /* Differential operator in units of 1/length per axis */
+  Dnx = d->Dn_axis[0][NX] / s->box_l[0];
+  Dny = d->Dn_axis[1][NY] / s->box_l[1];
+  Dnz = d->Dn_axis[2][NZ] / s->box_l[2];
+
+  zwi  = Dnx*Zaehler[0] + Dny*Zaehler[1] + Dnz*Zaehler[2];
+  zwi /= ( ( SQR ( Dnx ) + SQR ( Dny ) + SQR ( Dnz ) ) * SQR ( Nenner ) );
+  return 2.0 * zwi / PI;
+}
+
+/* Calculate influence function */
+void Influence_function_berechnen_ik ( system_t *s, parameters_t *p, data_t *d ) {
+  Set_aliasing_tables ( d, p->cao, d->inter->U_hat );
+  Influence_function_symmetric ( s, p, d, &influence_function_ik );
 }
 
 
@@ -183,49 +179,56 @@ void P3M_ik ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
   FLOAT_TYPE T1;
   FLOAT_TYPE dop;
   
-  // One over boxlength
-  FLOAT_TYPE Leni = 1.0/s->length;
+  // 2 pi over boxlength per axis
+  const FLOAT_TYPE twopiLeni[3] = { 2.0*PI/s->box_l[0], 2.0*PI/s->box_l[1], 2.0*PI/s->box_l[2] };
 
-  int Mesh = p->mesh;
   int c_index;
 
-  /* Setting charge mesh to zero */
-  memset ( d->Qmesh, 0, 2*Mesh*Mesh*Mesh*sizeof ( FLOAT_TYPE ) );
-
-  TIMING_START_C
+  if ( Charge_mesh_cache_load ( d ) ) {
+    TIMING_START_G
+  } else {
+    TIMING_START_C
   
-  /* chargeassignment */
-  assign_charge ( s, p, d, 0 );
+    /* chargeassignment */
+    if ( d->Qmesh_inc != NULL ) {
+      assign_charge_incremental ( s, p, d );
+    } else {
+      memset ( d->Qmesh, 0, 2*Mesh_size ( d )*sizeof ( FLOAT_TYPE ) );
+      assign_charge ( s, p, d, 0 );
+    }
 
-  TIMING_STOP_C
+    TIMING_STOP_C
 
-  TIMING_START_G
+    TIMING_START_G
 
-  /* Forward Fast Fourier Transform */
-  forward_fft(d);
+    /* Forward Fast Fourier Transform */
+    forward_fft(d);
+
+    Charge_mesh_cache_store ( d );
+  }
 
   double q_r, q_i;
 
 
   /* Convolution */
-  for ( i=0; i<Mesh; i++ )
-    for ( j=0; j<Mesh; j++ )
-      for ( k=0; k<Mesh; k++ ) {
+  for ( i=0; i<d->grid[0]; i++ )
+    for ( j=0; j<d->grid[1]; j++ )
+      for ( k=0; k<d->grid[2]; k++ ) {
 	c_index = c_ind ( i,j,k );
 
 	T1 = d->G_hat[r_ind ( i,j,k ) ];
-	q_r = 2.0*PI*Leni*d->Qmesh[c_index] *T1;
-	q_i = -2.0*PI*Leni*d->Qmesh[c_index+1] *T1;
+	q_r = d->Qmesh[c_index] *T1;
+	q_i = -d->Qmesh[c_index+1] *T1;
 
-	dop = d->Dn[i];	 
+	dop = twopiLeni[0]*d->Dn_axis[0][i];
 	d->Fmesh->fields[0][c_index]   =  dop*q_i;
 	d->Fmesh->fields[0][c_index+1] =  dop*q_r;
 
-	dop = d->Dn[j];
+	dop = twopiLeni[1]*d->Dn_axis[1][j];
 	d->Fmesh->fields[1][c_index]   =  dop*q_i;
 	d->Fmesh->fields[1][c_index+1] =  dop*q_r;
 
-	dop = d->Dn[k];
+	dop = twopiLeni[2]*d->Dn_axis[2][k];
 	d->Fmesh->fields[2][c_index]   =  dop*q_i;
 	d->Fmesh->fields[2][c_index+1] =  dop*q_r;
  
@@ -239,7 +242,7 @@ void P3M_ik ( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
   TIMING_START_F
 
   /* Force assignment */
-  assign_forces ( 1.0/ ( 2.0*s->length*s->length*s->length ),s,p,d,f,0 );
+  assign_forces ( 1.0/ ( 2.0*s->box_l[0]*s->box_l[1]*s->box_l[2] ),s,p,d,f,0 );
 
   TIMING_STOP_F
 }
@@ -262,9 +265,13 @@ FLOAT_TYPE Error_ik( system_t *s, parameters_t *p) {
 
 FLOAT_TYPE p3m_k_space_error_ik ( FLOAT_TYPE prefac, const system_t *s, const parameters_t *p ) {
   int mesh = p->mesh;
+  FLOAT_TYPE he_q;
+
+  if ( !Box_is_cubic ( s ) )
+    return p3m_k_space_error_ik_noncubic ( s, p );
 
   // Check whether value pair is tabulated.
-  FLOAT_TYPE he_q = p3m_find_error(p->alpha*s->length, mesh, p->cao, 0);
+  he_q = p3m_find_error(p->alpha*s->length, mesh, p->cao, 0);
 
   // Parameter set not found
   if(he_q < 0) {
@@ -274,6 +281,7 @@ FLOAT_TYPE p3m_k_space_error_ik ( FLOAT_TYPE prefac, const system_t *s, const pa
     FLOAT_TYPE alias1, alias2, n2, cs;
     FLOAT_TYPE ctan_x, ctan_y;
     FLOAT_TYPE meshi = 1.0/(FLOAT_TYPE)(p->mesh);
+    const aliasing_table_t *t = Aliasing_table ( mesh, p->cao, P3M_BRILLOUIN_TUNING, NULL );
 #ifdef _OPENMP
 #pragma omp parallel for private(ctan_x, ctan_y, n2, cs, alias1, alias2, ny, nz) reduction( + : he_q )
 #endif
@@ -285,7 +293,7 @@ FLOAT_TYPE p3m_k_space_error_ik ( FLOAT_TYPE prefac, const system_t *s, const pa
 	  if ( ( nx!=0 ) || ( ny!=0 ) || ( nz!=0 ) ) {
 	    n2 = SQR ( nx ) + SQR ( ny ) + SQR ( nz );
 	    cs = analytic_cotangent_sum ( nz, meshi ,p->cao ) *ctan_y;
-	    p3m_tune_aliasing_sums_ik ( nx,ny,nz, s, p, &alias1,&alias2 );
+	    p3m_tune_aliasing_sums_ik ( nx,ny,nz, s, p, t, &alias1,&alias2 );
 	    he_q += ( alias1  -  SQR ( alias2/cs ) / n2 );
 	  }
 	}
@@ -300,38 +308,105 @@ FLOAT_TYPE p3m_k_space_error_ik ( FLOAT_TYPE prefac, const system_t *s, const pa
   return 2.0*s->q2*SQRT ( he_q/ ( FLOAT_TYPE ) s->nparticles ) / ( SQR ( s->length ) );
 }
 
+/* Same estimate for a non-cubic box, the sums are over the per axis
+   meshes of Mesh_grid() and in units of 1/length instead of the
+   mesh index. */
+static FLOAT_TYPE p3m_k_space_error_ik_noncubic ( const system_t *s, const parameters_t *p ) {
+  int grid[3];
+  const aliasing_table_t *t[3];
+  FLOAT_TYPE he_q = 0.0;
+  int nx, ny, nz, dim;
 
-void p3m_tune_aliasing_sums_ik ( int nx, int ny, int nz,
-                                 const system_t *s, const parameters_t *p,
-                                 FLOAT_TYPE *alias1, FLOAT_TYPE *alias2 ) {
+  Mesh_grid ( s, p, grid );
+  for ( dim = 0; dim < 3; dim++ )
+    t[dim] = Aliasing_table ( grid[dim], p->cao, P3M_BRILLOUIN_TUNING, NULL );
 
-    int    mx,my,mz;
-    FLOAT_TYPE nmx,nmy,nmz;
-    FLOAT_TYPE fnmx,fnmy,fnmz;
+#ifdef _OPENMP
+#pragma omp parallel for private(ny, nz) reduction( + : he_q )
+#endif
+  for ( nx=-grid[0]/2; nx<grid[0]/2; nx++ ) {
+    const int nm = 2*t[0]->mc+1;
+    const FLOAT_TYPE *ux = t[0]->sinc2 + Aliasing_row ( t[0], nx );
+    FLOAT_TYPE kx[nm], ky[nm], kz[nm], ex[nm], ey[nm], ez[nm];
+    FLOAT_TYPE csx = analytic_cotangent_sum ( nx, 1.0/grid[0], p->cao );
+    FLOAT_TYPE k0[3];
+    int mx, my, mz;
+
+    Aliasing_factors ( p, t[0], s->box_l[0], nx, kx, ex );
+    k0[0] = nx / s->box_l[0];
+    for ( ny=-grid[1]/2; ny<grid[1]/2; ny++ ) {
+      const FLOAT_TYPE *uy = t[1]->sinc2 + Aliasing_row ( t[1], ny );
+      FLOAT_TYPE csy = csx * analytic_cotangent_sum ( ny, 1.0/grid[1], p->cao );
+
+      Aliasing_factors ( p, t[1], s->box_l[1], ny, ky, ey );
+      k0[1] = ny / s->box_l[1];
+      for ( nz=-grid[2]/2; nz<grid[2]/2; nz++ ) {
+        const FLOAT_TYPE *uz = t[2]->sinc2 + Aliasing_row ( t[2], nz );
+        FLOAT_TYPE cs, k02, km2, ex3, a1 = 0.0, a2 = 0.0;
+
+        if ( ( nx==0 ) && ( ny==0 ) && ( nz==0 ) )
+          continue;
+
+        Aliasing_factors ( p, t[2], s->box_l[2], nz, kz, ez );
+        k0[2] = nz / s->box_l[2];
+        k02 = SQR ( k0[0] ) + SQR ( k0[1] ) + SQR ( k0[2] );
+        cs = csy * analytic_cotangent_sum ( nz, 1.0/grid[2], p->cao );
+
+        for ( mx = 0; mx < nm; mx++ )
+          for ( my = 0; my < nm; my++ )
+            for ( mz = 0; mz < nm; mz++ ) {
+              km2 = SQR ( kx[mx] ) + SQR ( ky[my] ) + SQR ( kz[mz] );
+              ex3 = ex[mx]*ey[my]*ez[mz];
+
+              a1 += SQR ( ex3 ) / km2;
+              a2 += ux[mx]*uy[my]*uz[mz] * ex3 * ( k0[0]*kx[mx] + k0[1]*ky[my] + k0[2]*kz[mz] ) / km2;
+            }
+        he_q += a1 - SQR ( a2/cs ) / k02;
+      }
+    }
+  }
 
-    FLOAT_TYPE ex,ex2,nm2,U2,factor1;
-    int mesh = p->mesh;
-    FLOAT_TYPE meshi = 1.0/(FLOAT_TYPE)(p->mesh);
-  
-    factor1 = SQR ( PI / ( p->alpha * s->length ) );
+  he_q = fabs(he_q);
 
-    *alias1 = *alias2 = 0.0;
-    for ( mx=-P3M_BRILLOUIN_TUNING; mx<=P3M_BRILLOUIN_TUNING; mx++ ) {
-        fnmx = meshi * ( nmx = nx + mx*mesh );
-        for ( my=-P3M_BRILLOUIN_TUNING; my<=P3M_BRILLOUIN_TUNING; my++ ) {
-            fnmy = meshi * ( nmy = ny + my*mesh );
-            for ( mz=-P3M_BRILLOUIN_TUNING; mz<=P3M_BRILLOUIN_TUNING; mz++ ) {
-                fnmz = meshi * ( nmz = nz + mz*mesh );
+  return 2.0*s->q2*SQRT ( he_q/ ( FLOAT_TYPE ) s->nparticles ) / ( s->box_l[0]*s->box_l[1]*s->box_l[2] );
+}
 
-                nm2 = SQR ( nmx ) + SQR ( nmy ) + SQR ( nmz );
-                ex = EXP ( -factor1*nm2 );
-                ex2 = SQR ( ex );
 
-                U2 = my_power ( sinc ( fnmx ) *sinc ( fnmy ) *sinc ( fnmz ), 2*p->cao );
+void p3m_tune_aliasing_sums_ik ( int nx, int ny, int nz,
+                                 const system_t *s, const parameters_t *p,
+                                 const aliasing_table_t *t,
+                                 FLOAT_TYPE *alias1, FLOAT_TYPE *alias2 ) {
+    const int nm = 2*t->mc+1;
+    const FLOAT_TYPE *nmx = t->nm + Aliasing_row ( t, nx );
+    const FLOAT_TYPE *nmy = t->nm + Aliasing_row ( t, ny );
+    const FLOAT_TYPE *nmz = t->nm + Aliasing_row ( t, nz );
+    const FLOAT_TYPE *ux = t->sinc2 + Aliasing_row ( t, nx );
+    const FLOAT_TYPE *uy = t->sinc2 + Aliasing_row ( t, ny );
+    const FLOAT_TYPE *uz = t->sinc2 + Aliasing_row ( t, nz );
+    FLOAT_TYPE k[nm], ex[nm], ey[nm], ez[nm];
+    FLOAT_TYPE S2, E2, N2, D2, ex3, nm2;
+    FLOAT_TYPE a1 = 0.0, a2 = 0.0;
+    int    mx,my,mz;
 
-                *alias1 += ex2 / nm2;
-                *alias2 += U2 * ex * ( nx*nmx + ny*nmy + nz*nmz ) / nm2;
+    Aliasing_factors ( p, t, s->length, nx, k, ex );
+    Aliasing_factors ( p, t, s->length, ny, k, ey );
+    Aliasing_factors ( p, t, s->length, nz, k, ez );
+
+    for ( mx = 0; mx < nm; mx++ ) {
+        for ( my = 0; my < nm; my++ ) {
+            S2 = ux[mx]*uy[my];
+            E2 = ex[mx]*ey[my];
+            N2 = SQR ( nmx[mx] ) + SQR ( nmy[my] );
+            D2 = nx*nmx[mx] + ny*nmy[my];
+            for ( mz = 0; mz < nm; mz++ ) {
+                nm2 = N2 + SQR ( nmz[mz] );
+                ex3 = E2*ez[mz];
+
+                a1 += SQR ( ex3 ) / nm2;
+                a2 += S2*uz[mz] * ex3 * ( D2 + nz*nmz[mz] ) / nm2;
             }
         }
     }
+    *alias1 = a1;
+    *alias2 = a2;
 }
@@ -19,6 +19,7 @@
 #include "types.h"
 
 void Influence_function_berechnen_ik(system_t*, parameters_t*, data_t*);
+FLOAT_TYPE influence_function_ik(system_t *, parameters_t *, data_t *, int, int, int);
 void P3M_ik(system_t *, parameters_t *, data_t *, forces_t *);
 data_t *Init_ik(system_t*, parameters_t*);
 FLOAT_TYPE Error_ik( system_t *, parameters_t *);
@@ -0,0 +1,99 @@
+/**    Copyright (C) 2011,2012,2013,2014 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+/* Compares charge assignment with tabulated weights against
+   direct evaluation of the B-spline polynomials. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "wtime.h"
+#include "types.h"
+#include "common.h"
+#include "generate_system.h"
+#include "charge-assign.h"
+#include "interpol.h"
+#include "p3m-common.h"
+#include "p3m-ad-real.h"
+
+int main(int argc, char **argv) {
+  system_t *s;
+  forces_t *forces;
+  parameters_t p;
+  data_t *d;
+  int n, mesh, reps = 10;
+  FLOAT_TYPE box = 10.0;
+  double t[2][3];
+
+  if(argc < 3) {
+    fprintf(stderr, "usage: %s <particles> <mesh> [repetitions]\n", argv[0]);
+    return 1;
+  }
+
+  n = atoi(argv[1]);
+  mesh = atoi(argv[2]);
+  if(argc > 3)
+    reps = atoi(argv[3]);
+
+  s = generate_system( SYSTEM_RANDOM, n, box, 1.0);
+  forces = Init_forces(s->nparticles);
+
+  printf("# %d particles, mesh %d, %d repetitions\n", n, mesh, reps);
+  printf("#cao charge-table charge-direct forces-table forces-direct charge_and_derivatives-table charge_and_derivatives-direct\n");
+
+  for(int cao = 1; cao <= BSPLINE_MAX_CAO; cao++) {
+    memset(&p, 0, sizeof(parameters_t));
+    p.tuning = 1;
+    p.cao = cao;
+    p.cao3 = cao*cao*cao;
+    p.ip = cao-1;
+    p.mesh = mesh;
+
+    for(int direct = 0; direct < 2; direct++) {
+      d = Init_data(&method_p3m_ad_r, s, &p);
+      d->Fmesh = Init_vector_array(2*mesh*mesh*mesh);
+      /* Replace the dummy tuning tables by the ones for this cao. */
+      d->inter = direct ? Init_interpolation_direct(p.ip) : Init_interpolation(p.ip, cao > 1);
+
+      t[direct][0] = wtime();
+      for(int r = 0; r < reps; r++)
+	assign_charge_real(s, &p, d);
+      t[direct][0] = (wtime() - t[direct][0]) / reps;
+
+      t[direct][1] = wtime();
+      for(int r = 0; r < reps; r++)
+	assign_forces_real_nostor(1.0, s, &p, d, forces);
+      t[direct][1] = (wtime() - t[direct][1]) / reps;
+
+      t[direct][2] = 0.0;
+      if(cao > 1) {
+	t[direct][2] = wtime();
+	for(int r = 0; r < reps; r++)
+	  assign_charge_and_derivatives_real(s, &p, d);
+	t[direct][2] = (wtime() - t[direct][2]) / reps;
+      }
+
+      Free_data(d);
+    }
+    printf("%d %e %e %e %e %e %e\n", cao, t[0][0], t[1][0], t[0][1], t[1][1], t[0][2], t[1][2]);
+  }
+
+  Free_forces(forces);
+  Free_system(s);
+
+  return 0;
+}
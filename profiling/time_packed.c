@@ -0,0 +1,105 @@
+/**    Copyright (C) 2011,2012,2013 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+/* Compares the packed backward transforms of p3m-ik-r-p with p3m-ik-r
+   and the complex p3m-ik for meshes 32 to 256.
+   Usage: time_packed particles box cao [samples]
+   Minimal t_g and total k-space times go to packed.dat. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "common.h"
+#include "generate_system.h"
+#include "p3m-common.h"
+#include "p3m-ik.h"
+#include "p3m-ik-real.h"
+#include "p3m-ik-real-packed.h"
+
+static const method_t *methods[] = { &method_p3m_ik, &method_p3m_ik_r, &method_p3m_ik_r_p };
+
+#define N_METHODS (sizeof(methods)/sizeof(methods[0]))
+
+#define MIN(A,B) (((A) < (B)) ? (A) : (B))
+
+static runtime_t time_kspace(const method_t *m, system_t *s, parameters_t *p, forces_t *f, int samples) {
+  runtime_t best = { 1e99, 1e99, 1e99, 1e99 };
+  data_t *d = m->Init(s, p);
+
+  m->Kspace_force(s, p, d, f);
+
+  for(int i = 0; i < samples; i++) {
+    memset(&(d->runtime), 0, sizeof(runtime_t));
+    m->Kspace_force(s, p, d, f);
+    best.t_c = MIN(best.t_c, d->runtime.t_c);
+    best.t_g = MIN(best.t_g, d->runtime.t_g);
+    best.t_f = MIN(best.t_f, d->runtime.t_f);
+    best.t = MIN(best.t, d->runtime.t_c + d->runtime.t_g + d->runtime.t_f);
+  }
+
+  Free_data(d);
+  return best;
+}
+
+int main(int argc, char **argv) {
+  parameters_t p;
+  int samples = 10;
+  FILE *out;
+
+  if(argc < 4) {
+    puts("usage: time_packed particles box cao [samples]");
+    return 1;
+  }
+
+  if(argc > 4)
+    samples = atoi(argv[4]);
+
+  system_t *s = generate_system( SYSTEM_RANDOM, atoi(argv[1]), atof(argv[2]), 1.0);
+  forces_t *f = Init_forces(s->nparticles);
+
+  memset(&p, 0, sizeof(parameters_t));
+  p.tuning = 1;
+  p.cao = atoi(argv[3]);
+  p.cao3 = p.cao*p.cao*p.cao;
+  p.ip = p.cao - 1;
+  p.alpha = 1.0;
+  p.rcut = 0.5*s->length;
+
+  out = fopen("packed.dat", "w");
+  fprintf(out, "#mesh");
+  for(int i = 0; i < N_METHODS; i++)
+    fprintf(out, " t_g-%s t-%s", methods[i]->method_name_short, methods[i]->method_name_short);
+  fprintf(out, "\n");
+
+  for(p.mesh = 32; p.mesh <= 256; p.mesh *= 2) {
+    printf("mesh %d\n", p.mesh);
+    fprintf(out, "%d", p.mesh);
+    for(int i = 0; i < N_METHODS; i++) {
+      runtime_t r = time_kspace(methods[i], s, &p, f, samples);
+      printf("\t%-12s t_g %e t %e\n", methods[i]->method_name_short, r.t_g, r.t);
+      fprintf(out, " %e %e", r.t_g, r.t);
+    }
+    fprintf(out, "\n");
+    fflush(out);
+  }
+
+  fclose(out);
+  Free_forces(f);
+  Free_system(s);
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+/**    Copyright (C) 2011,2012,2013 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+/* Thread scaling of the phases of the k-space methods.
+   Usage: time_scaling particles box mesh cao [samples]
+   For 1, 2, 4, ... up to omp_get_max_threads() threads the minimal
+   times of charge assignment (t_c), mesh phase (t_g, FFTs and
+   influence function) and force assignment (t_f) are written to
+   scaling.dat together with the speedup against one thread. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "types.h"
+#include "common.h"
+#include "generate_system.h"
+#include "p3m-common.h"
+#include "p3m-ik.h"
+#include "p3m-ik-i.h"
+#include "p3m-ad.h"
+#include "p3m-ad-i.h"
+#include "p3m-ik-real.h"
+#include "p3m-ad-real.h"
+
+static const method_t *methods[] = { &method_p3m_ik, &method_p3m_ik_i, &method_p3m_ad, &method_p3m_ad_i, &method_p3m_ik_r, &method_p3m_ad_r };
+
+#define MIN(A,B) (((A) < (B)) ? (A) : (B))
+
+static runtime_t time_phases(const method_t *m, system_t *s, parameters_t *p, forces_t *f, int samples) {
+  runtime_t best = { 1e99, 1e99, 1e99, 1e99 };
+  data_t *d = m->Init(s, p);
+
+  /* First call touches the meshes. */
+  m->Kspace_force(s, p, d, f);
+
+  for(int i = 0; i < samples; i++) {
+    memset(&(d->runtime), 0, sizeof(runtime_t));
+    m->Kspace_force(s, p, d, f);
+    best.t_c = MIN(best.t_c, d->runtime.t_c);
+    best.t_g = MIN(best.t_g, d->runtime.t_g);
+    best.t_f = MIN(best.t_f, d->runtime.t_f);
+    best.t = MIN(best.t, d->runtime.t_c + d->runtime.t_g + d->runtime.t_f);
+  }
+
+  Free_data(d);
+  return best;
+}
+
+int main(int argc, char **argv) {
+  parameters_t p;
+  int max_threads = 1;
+  int samples = 10;
+  FILE *out;
+
+  if(argc < 5) {
+    puts("usage: time_scaling particles box mesh cao [samples]");
+    return 1;
+  }
+
+  if(argc > 5)
+    samples = atoi(argv[5]);
+
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+
+  system_t *s = generate_system( SYSTEM_RANDOM, atoi(argv[1]), atof(argv[2]), 1.0);
+  forces_t *f = Init_forces(s->nparticles);
+
+  memset(&p, 0, sizeof(parameters_t));
+  p.tuning = 1;
+  p.mesh = atoi(argv[3]);
+  p.cao = atoi(argv[4]);
+  p.cao3 = p.cao*p.cao*p.cao;
+  p.ip = p.cao - 1;
+  p.alpha = 1.0;
+  p.rcut = 0.5*s->length;
+
+  out = fopen("scaling.dat", "w");
+  fprintf(out, "#method threads t_c t_g t_f t speedup_c speedup_g speedup_f speedup\n");
+
+  for(int i = 0; i < sizeof(methods)/sizeof(methods[0]); i++) {
+    runtime_t serial = { 0.0, 0.0, 0.0, 0.0 };
+
+    printf("%s\n", methods[i]->method_name);
+
+    for(int t = 1; ; t = (2*t > max_threads && t < max_threads) ? max_threads : 2*t) {
+#ifdef _OPENMP
+      omp_set_num_threads(t);
+#endif
+      runtime_t r = time_phases(methods[i], s, &p, f, samples);
+
+      if(t == 1)
+	serial = r;
+
+      printf("\t%2d threads: t_c %e t_g %e t_f %e t %e, speedup c %.2f g %.2f f %.2f total %.2f\n", t,
+	     r.t_c, r.t_g, r.t_f, r.t, serial.t_c / r.t_c, serial.t_g / r.t_g, serial.t_f / r.t_f, serial.t / r.t);
+      fprintf(out, "%d %d %e %e %e %e %e %e %e %e\n", methods[i]->method_id, t,
+	      r.t_c, r.t_g, r.t_f, r.t, serial.t_c / r.t_c, serial.t_g / r.t_g, serial.t_f / r.t_f, serial.t / r.t);
+      fflush(out);
+
+      if(t >= max_threads)
+	break;
+    }
+  }
+
+  fclose(out);
+  Free_forces(f);
+  Free_system(s);
+
+  return 0;
+}
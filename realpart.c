@@ -14,16 +14,56 @@
        along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
 
 #include <math.h>
+#include <assert.h>
 #include <string.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "common.h"
 
 #include "realpart.h"
+#include "p3m-common.h"
 #include "sort.h"
 
 static int to_left=0;
 static int to_right=0;
 
+/* Intervals of the table of the vectorized kernels if P3M_REALSPACE_TABLE is 0 */
+#define REALSPACE_TABLE_SIMD 4096
+
+/* Table intervals of the scalar (simd = 0) or vectorized kernels, 0 if
+   the pair functions are evaluated directly. */
+static int realspace_table_size( int simd ) {
+  if(P3M_REALSPACE_TABLE != 0)
+    return (P3M_REALSPACE_TABLE > 0) ? P3M_REALSPACE_TABLE : 0;
+  return simd ? REALSPACE_TABLE_SIMD : 0;
+}
+
+/* Table for the real space kernels, NULL if the pair functions are
+   evaluated directly. */
+static const pair_table_t *realspace_table( const parameters_t *p, int simd ) {
+  const int n = realspace_table_size( simd );
+
+  return n ? Pair_table( p, n ) : NULL;
+}
+
+/* Force factor and potential of a pair with unit charges at distance^2 r2. */
+static inline FLOAT_TYPE ewald_pair( const parameters_t *p, const pair_table_t *t, FLOAT_TYPE r2, FLOAT_TYPE *pot ) {
+  const FLOAT_TYPE wupi = 1.77245385090551602729816748334;
+  FLOAT_TYPE r, ar, erfc_teil;
+
+  if(t != NULL)
+    return Pair_table_eval( t, r2, pot );
+
+  r = SQRT(r2);
+  ar = p->alpha*r;
+  erfc_teil = ERFC(ar);
+  *pot = erfc_teil/r;
+  return (erfc_teil/r+(2.0*p->alpha/wupi)*EXP(-ar*ar))/r2;
+}
+
 /* static inline void ewald_pair(parameters_t *p, forces_t *f, int id, int r, FLOAT_TYPE q12) { */
 /*   FLOAT_TYPE erfc_teil; */
 /*   FLOAT_TYPE r2, r; */
@@ -42,7 +82,7 @@ int *count_neighbors( system_t *s, parameters_t *p )
     int t1,t2;
     /* Minimum-Image-Abstand: */
     FLOAT_TYPE dx,dy,dz,r;
-    FLOAT_TYPE lengthi = 1.0/s->length;
+    const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
     int *nb = (int *)FFTW_MALLOC(s->nparticles*sizeof(int));
 
     memset(nb, 0, s->nparticles * sizeof(int));
@@ -53,11 +93,11 @@ int *count_neighbors( system_t *s, parameters_t *p )
 	    continue;
 
 	  dx = s->p->x[t1] - s->p->x[t2];
-	  dx -= ROUND(dx*lengthi)*s->length;
+	  dx -= ROUND(dx*lengthi[0])*s->box_l[0];
 	  dy = s->p->y[t1] - s->p->y[t2];
-	  dy -= ROUND(dy*lengthi)*s->length;
+	  dy -= ROUND(dy*lengthi[1])*s->box_l[1];
 	  dz = s->p->z[t1] - s->p->z[t2];
-	  dz -= ROUND(dz*lengthi)*s->length;
+	  dz -= ROUND(dz*lengthi[2])*s->box_l[2];
 	  
 	  r = SQRT(SQR(dx) + SQR(dy) + SQR(dz));
 	  if (r<=p->rcut)
@@ -69,28 +109,474 @@ int *count_neighbors( system_t *s, parameters_t *p )
     return nb;
 }
 
-int *count_neighbors_dd(domain_decomposition_t *dd, parameters_t *p) {
+/* Number of linked cells per direction, the cell size is at least rcut.
+   Returns 0 if the box is too small for three cells in some direction. */
+static int linked_cell_grid( system_t *s, FLOAT_TYPE rcut, int n[3] ) {
+  int i, max;
+
+  for(i=0;i<3;i++) {
+    n[i] = (int)FLOOR(s->box_l[i] / rcut);
+    if(n[i] < 3)
+      return 0;
+  }
+
+  /* Not more cells than particles, empty cells cost only overhead. */
+  while(n[0]*n[1]*n[2] > s->nparticles) {
+    max = 0;
+    for(i=1;i<3;i++)
+      if(n[i] > n[max])
+	max = i;
+    if(n[max] <= 3)
+      break;
+    n[max]--;
+  }
+
+  return 1;
+}
+
+static inline FLOAT_TYPE min_image_dist2( const FLOAT_TYPE *box, const FLOAT_TYPE *lengthi, 
+					  const cell_t *a, int i, const cell_t *b, int j, FLOAT_TYPE *d ) {
+  for(int k=0;k<3;k++) {
+    d[k] = a->fields[k][i] - b->fields[k][j];
+    d[k] -= ROUND(d[k]*lengthi[k])*box[k];
+  }
+  return SQR(d[0]) + SQR(d[1]) + SQR(d[2]);
+}
+
+static domain_decomposition_t *cells_dd = NULL;
+
+/* Single cached decomposition, it is only rebuilt if the cell grid or
+   the box change, otherwise the particles are just binned again. */
+static domain_decomposition_t *realspace_dd( system_t *s, const int n[3] ) {
+  if(cells_dd != NULL)
+    for(int k = 0; k < 3; k++)
+      if((cells_dd->cells_per_direction[k] != n[k]) || (cells_dd->box[k] != s->box_l[k])) {
+	Free_realspace_dd();
+	break;
+      }
+
+  if(cells_dd == NULL)
+    cells_dd = Init_dd( n, s->box_l );
+
+  Bin_system( cells_dd, s );
+
+  return cells_dd;
+}
+
+void Free_realspace_dd( void ) {
+  if(cells_dd == NULL)
+    return;
+
+  Free_dd(cells_dd);
+  cells_dd = NULL;
+}
+
+int *count_neighbors_dd( system_t *s, parameters_t *p ) {
+  domain_decomposition_t *dd;
+  celllist_t *next;
+  cell_t *a, *b;
+  int n[3], *nb;
+  FLOAT_TYPE d[3];
+  const FLOAT_TYPE rcut2 = SQR(p->rcut);
+  const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+
+  if(!linked_cell_grid( s, p->rcut, n ))
+    return count_neighbors( s, p );
+
+  dd = realspace_dd( s, n );
+
+  nb = (int *)Init_array(s->nparticles, sizeof(int));
+  memset(nb, 0, s->nparticles * sizeof(int));
+
+  for(int c = 0; c < dd->total_cells; c++) {
+    a = &(dd->cells[c]);
+    for(int i = 0; i < a->n_particles; i++) {
+      for(int j = i+1; j < a->n_particles; j++) {
+	if(min_image_dist2( s->box_l, lengthi, a, i, a, j, d ) <= rcut2) {
+	  nb[a->ids[i]]++;
+	  nb[a->ids[j]]++;
+	}
+      }
+      for(next = a->half_shell; next != NULL; next = next->next) {
+	b = next->c;
+	for(int j = 0; j < b->n_particles; j++) {
+	  if(min_image_dist2( s->box_l, lengthi, a, i, b, j, d ) <= rcut2) {
+	    nb[a->ids[i]]++;
+	    nb[b->ids[j]]++;
+	  }
+	}
+      }
+    }
+  }
+
+  return nb;
+}
+
+/* Pairs per chunk of the vectorized kernels */
+#define PAIR_CHUNK 64
+
+/* Interactions of particle i at xi with the n <= PAIR_CHUNK particles
+   x, y, z, q with ids id. The force on i is added to fi, the opposite
+   forces to the buffer f, returns the energy. The distances are
+   computed for all candidates, the pairs within rcut are compacted
+   and only those are evaluated. Both loops have no branches so that
+   they are vectorized; with the table the kernel only needs a gather.
+   Without it erfc and exp are scalar calls, which is what the reference
+   forces use. */
+static inline FLOAT_TYPE pair_chunk( const parameters_t *p, const pair_table_t *t,
+				     const FLOAT_TYPE *box, const FLOAT_TYPE *lengthi,
+				     const FLOAT_TYPE *xi, FLOAT_TYPE qi, int n,
+				     const FLOAT_TYPE * restrict x, const FLOAT_TYPE * restrict y,
+				     const FLOAT_TYPE * restrict z, const FLOAT_TYPE * restrict q,
+				     const int * restrict id, FLOAT_TYPE *fi, FLOAT_TYPE * const *f ) {
+  FLOAT_TYPE dx[PAIR_CHUNK], dy[PAIR_CHUNK], dz[PAIR_CHUNK], r2[PAIR_CHUNK];
+  FLOAT_TYPE fx[PAIR_CHUNK], fy[PAIR_CHUNK], fz[PAIR_CHUNK];
+  int sel[PAIR_CHUNK], m = 0;
+  FLOAT_TYPE fix = 0.0, fiy = 0.0, fiz = 0.0, energy = 0.0;
+  const FLOAT_TYPE rcut2 = SQR(p->rcut);
+  const FLOAT_TYPE x0 = xi[0], y0 = xi[1], z0 = xi[2];
+  const FLOAT_TYPE lx = lengthi[0], ly = lengthi[1], lz = lengthi[2];
+  const FLOAT_TYPE bx = box[0], by = box[1], bz = box[2];
+
+  /* RINT instead of ROUND, which has no vector version; they only
+     differ for distances of exactly half the box. */
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(int k = 0; k < n; k++) {
+    dx[k] = x0 - x[k];
+    dx[k] -= RINT(dx[k]*lx)*bx;
+    dy[k] = y0 - y[k];
+    dy[k] -= RINT(dy[k]*ly)*by;
+    dz[k] = z0 - z[k];
+    dz[k] -= RINT(dz[k]*lz)*bz;
+    r2[k] = SQR(dx[k]) + SQR(dy[k]) + SQR(dz[k]);
+  }
+
+  for(int k = 0; k < n; k++) {
+    sel[m] = k;
+    m += (r2[k] <= rcut2);
+  }
+
+#ifdef _OPENMP
+#pragma omp simd reduction(+:fix,fiy,fiz,energy)
+#endif
+  for(int u = 0; u < m; u++) {
+    const int k = sel[u];
+    FLOAT_TYPE fak, pot;
+
+    fak = qi*q[k]*ewald_pair( p, t, r2[k], &pot );
+
+    fx[u] = fak*dx[k];
+    fy[u] = fak*dy[k];
+    fz[u] = fak*dz[k];
+    fix += fx[u];
+    fiy += fy[u];
+    fiz += fz[u];
+    energy += qi*q[k]*pot;
+  }
+
+  for(int u = 0; u < m; u++) {
+    f[0][id[sel[u]]] -= fx[u];
+    f[1][id[sel[u]]] -= fy[u];
+    f[2][id[sel[u]]] -= fz[u];
+  }
+
+  fi[0] += fix;
+  fi[1] += fiy;
+  fi[2] += fiz;
+
+  return energy;
+}
+
+/* Particle i of cell a with the particles first ... n-1 of cell b. */
+static inline FLOAT_TYPE pair_cells( const parameters_t *p, const pair_table_t *t,
+				     const FLOAT_TYPE *box, const FLOAT_TYPE *lengthi,
+				     const cell_t *a, int i, const cell_t *b, int first,
+				     FLOAT_TYPE *fi, FLOAT_TYPE * const *f ) {
+  const FLOAT_TYPE xi[3] = { a->fields[0][i], a->fields[1][i], a->fields[2][i] };
+  FLOAT_TYPE energy = 0.0;
+
+  for(int j = first; j < b->n_particles; j += PAIR_CHUNK)
+    energy += pair_chunk( p, t, box, lengthi, xi, a->q[i],
+			  (b->n_particles - j < PAIR_CHUNK) ? b->n_particles - j : PAIR_CHUNK,
+			  b->fields[0] + j, b->fields[1] + j, b->fields[2] + j, b->q + j, b->ids + j, fi, f );
+
+  return energy;
+}
+
+/* Per thread force buffers, 3*n values per thread. */
+static FLOAT_TYPE *init_thread_forces( int n, int *nthreads ) {
+  *nthreads = 1;
+#ifdef _OPENMP
+  *nthreads = omp_get_max_threads();
+#endif
+  return (FLOAT_TYPE *)Init_array( 3*n*(*nthreads), sizeof(FLOAT_TYPE) );
+}
+
+/* Adds the thread buffers to f->f_r, call in a parallel region. The
+   caller frees buf. */
+static void reduce_thread_forces( int n, int nthreads, FLOAT_TYPE *buf, forces_t *f ) {
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+  for(int i = 0; i < n; i++)
+    for(int t = 0; t < nthreads; t++)
+      for(int k = 0; k < 3; k++)
+	f->f_r->fields[k][i] += buf[3*n*t + k*n + i];
+}
+
+/* Real space part with linked cells of size >= rcut. Every pair of
+   neighboring cells is visited once via the half shell, the forces
+   are applied to both particles. The cells are distributed over the
+   threads, each thread has its own force buffer. Falls back to Realteil
+   for boxes that are too small for three cells per direction. */
+void Realpart_cells( system_t *s, parameters_t *p, forces_t *f ) {
+  domain_decomposition_t *dd;
+  FLOAT_TYPE *buf;
+  int n[3], nthreads;
+  FLOAT_TYPE energy = 0.0;
+  const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+  const pair_table_t *table = realspace_table( p, 1 );
+
+  if(!linked_cell_grid( s, p->rcut, n )) {
+    Realteil( s, p, f );
+    return;
+  }
+
+  dd = realspace_dd( s, n );
+
+  buf = init_thread_forces( s->nparticles, &nthreads );
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:energy)
+#endif
+  {
+    int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+    FLOAT_TYPE * const ft[3] = { buf + 3*s->nparticles*tid, buf + (3*tid+1)*s->nparticles, buf + (3*tid+2)*s->nparticles };
+
+    memset(ft[0], 0, 3*s->nparticles*sizeof(FLOAT_TYPE));
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 4)
+#endif
+    for(int c = 0; c < dd->total_cells; c++) {
+      const cell_t *a = &(dd->cells[c]);
+      for(int i = 0; i < a->n_particles; i++) {
+	FLOAT_TYPE fi[3] = { 0.0, 0.0, 0.0 };
+	energy += pair_cells( p, table, s->box_l, lengthi, a, i, a, i+1, fi, ft );
+	for(const celllist_t *next = a->half_shell; next != NULL; next = next->next)
+	  energy += pair_cells( p, table, s->box_l, lengthi, a, i, next->c, 0, fi, ft );
+	for(int k = 0; k < 3; k++)
+	  ft[k][a->ids[i]] += fi[k];
+      }
+    }
+
+    reduce_thread_forces( s->nparticles, nthreads, buf, f );
+  }
+
+  s->energy += energy;
+
+  FFTW_FREE(buf);
+}
+
+static inline void verlet_list_push( verlet_list_t *l, int pos, int id ) {
+  if(pos >= l->size) {
+    l->id = (int *)Resize_array( l->id, 2*l->size*sizeof(int), l->size*sizeof(int) );
+    l->size *= 2;
+  }
+  l->id[pos] = id;
+}
+
+/* Appends the particles of c within rlist of i that have an id
+   larger than min_id, returns the new list length. */
+static int verlet_list_scan_cell( system_t *s, verlet_list_t *l, int pos, int i, const cell_t *c,
+				  int min_id, const FLOAT_TYPE *lengthi ) {
+  FLOAT_TYPE d[3];
+  const FLOAT_TYPE rlist2 = SQR(l->rlist);
+
+  for(int j=0;j<c->n_particles;j++) {
+    if(c->ids[j] <= min_id)
+      continue;
+    for(int k=0;k<3;k++) {
+      d[k] = s->p->fields[k][i] - c->fields[k][j];
+      d[k] -= ROUND(d[k]*lengthi[k])*s->box_l[k];
+    }
+    if(SQR(d[0]) + SQR(d[1]) + SQR(d[2]) <= rlist2)
+      verlet_list_push( l, pos++, c->ids[j] );
+  }
+
+  return pos;
+}
+
+static void verlet_list_build( system_t *s, verlet_list_t *l ) {
+  domain_decomposition_t *dd;
   celllist_t *next;
-  FLOAT_TYPE rcut2= SQR(p->rcut);
-  FLOAT_TYPE dx,dy,dz,r;
-  const FLOAT_TYPE box = dd->h*dd->cells_per_direction;
-  const FLOAT_TYPE lengthi = dd->h;
-  FLOAT_TYPE xi[3];
-
-  for(int i = 0; i < dd->total_cells; i++) {
-    for(int j = 0; j < dd->cells[i].n_particles; j++) {
-      next = dd->cells[i].neighbors->next;
-      xi[0] = dd->cells[i].p->x[j];
-      xi[1] = dd->cells[i].p->y[j];
-      xi[2] = dd->cells[i].p->z[j];
-      while(next != NULL) {
-	for(int k = 0; k < next->c->n_particles; k++) {
-	  ;
+  cell_t *c;
+  int n[3], pos = 0;
+  FLOAT_TYPE d[3];
+  const FLOAT_TYPE rlist2 = SQR(l->rlist);
+  const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+
+  if(linked_cell_grid( s, l->rlist, n )) {
+    dd = realspace_dd( s, n );
+
+    /* Pairs in the same cell belong to the smaller id, pairs in
+       neighboring cells to the cell that has the other in its half shell. */
+    for(int i=0;i<s->nparticles;i++) {
+      l->offset[i] = pos;
+      c = &(dd->cells[dd->cell_of[i]]);
+      pos = verlet_list_scan_cell( s, l, pos, i, c, i, lengthi );
+      for(next = c->half_shell; next != NULL; next = next->next)
+	pos = verlet_list_scan_cell( s, l, pos, i, next->c, -1, lengthi );
+    }
+
+  } else {
+    for(int i=0;i<s->nparticles;i++) {
+      l->offset[i] = pos;
+      for(int j=i+1;j<s->nparticles;j++) {
+	for(int k=0;k<3;k++) {
+	  d[k] = s->p->fields[k][i] - s->p->fields[k][j];
+	  d[k] -= ROUND(d[k]*lengthi[k])*s->box_l[k];
 	}
-	next=next->next;
+	if(SQR(d[0]) + SQR(d[1]) + SQR(d[2]) <= rlist2)
+	  verlet_list_push( l, pos++, j );
       }
     }
   }
+  l->offset[s->nparticles] = pos;
+
+  for(int k=0;k<3;k++) {
+    memcpy( l->p0->fields[k], s->p->fields[k], s->nparticles*sizeof(FLOAT_TYPE) );
+    l->box_l[k] = s->box_l[k];
+  }
+
+  l->builds++;
+}
+
+/* A list is valid as long as no particle moved more than half the skin. */
+static int verlet_list_valid( system_t *s, verlet_list_t *l ) {
+  FLOAT_TYPE d, dr2, max2 = 0.0;
+  const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+
+  for(int k=0;k<3;k++)
+    if(l->box_l[k] != s->box_l[k])
+      return 0;
+
+  for(int i=0;i<s->nparticles;i++) {
+    dr2 = 0.0;
+    for(int k=0;k<3;k++) {
+      d = s->p->fields[k][i] - l->p0->fields[k][i];
+      d -= ROUND(d*lengthi[k])*s->box_l[k];
+      dr2 += SQR(d);
+    }
+    if(dr2 > max2)
+      max2 = dr2;
+  }
+
+  return 4.0*max2 <= SQR(l->skin);
+}
+
+void Free_verlet_list( verlet_list_t *l ) {
+  if(l == NULL)
+    return;
+
+  Free_vector_array(l->p0);
+  FFTW_FREE(l->offset);
+  FFTW_FREE(l->id);
+  FFTW_FREE(l);
+}
+
+/* Builds the list of d on first use, and rebuilds it if the cutoff,
+   the box or the particle number changed or a particle moved more than
+   skin/2 since the last build. */
+void Update_verlet_list( system_t *s, parameters_t *p, data_t *d, FLOAT_TYPE skin ) {
+  verlet_list_t *l = d->verlet_list;
+
+  if((l != NULL) && ((l->n != s->nparticles) || (l->rlist != p->rcut + skin))) {
+    Free_verlet_list(l);
+    l = d->verlet_list = NULL;
+  }
+
+  if(l == NULL) {
+    l = d->verlet_list = (verlet_list_t *)Init_array( 1, sizeof(verlet_list_t) );
+    l->n = s->nparticles;
+    l->skin = skin;
+    l->rlist = p->rcut + skin;
+    l->offset = (int *)Init_array( s->nparticles + 1, sizeof(int) );
+    l->size = 16*s->nparticles;
+    l->id = (int *)Init_array( l->size, sizeof(int) );
+    l->p0 = Init_vector_array( s->nparticles );
+    l->builds = 0;
+  } else if(verlet_list_valid( s, l )) {
+    return;
+  }
+
+  verlet_list_build( s, l );
+}
+
+/* Real space part from the Verlet list of d, see Update_verlet_list.
+   The neighbors of a particle are gathered in chunks for the vectorized
+   pair loop, the rows are distributed over the threads. */
+void Realpart_verlet( system_t *s, parameters_t *p, data_t *d, forces_t *f ) {
+  const verlet_list_t *l = d->verlet_list;
+  const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+  const pair_table_t *table = realspace_table( p, 1 );
+  FLOAT_TYPE *buf;
+  FLOAT_TYPE energy = 0.0;
+  int nthreads;
+
+  assert(l != NULL);
+
+  buf = init_thread_forces( s->nparticles, &nthreads );
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:energy)
+#endif
+  {
+    FLOAT_TYPE x[PAIR_CHUNK], y[PAIR_CHUNK], z[PAIR_CHUNK], q[PAIR_CHUNK];
+    int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+    FLOAT_TYPE * const ft[3] = { buf + 3*s->nparticles*tid, buf + (3*tid+1)*s->nparticles, buf + (3*tid+2)*s->nparticles };
+
+    memset(ft[0], 0, 3*s->nparticles*sizeof(FLOAT_TYPE));
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for(int i=0;i<s->nparticles;i++) {
+      const FLOAT_TYPE xi[3] = { s->p->x[i], s->p->y[i], s->p->z[i] };
+      FLOAT_TYPE fi[3] = { 0.0, 0.0, 0.0 };
+
+      for(int k=l->offset[i];k<l->offset[i+1];k+=PAIR_CHUNK) {
+	const int m = (l->offset[i+1] - k < PAIR_CHUNK) ? l->offset[i+1] - k : PAIR_CHUNK;
+	const int *id = l->id + k;
+
+	for(int j=0;j<m;j++) {
+	  x[j] = s->p->x[id[j]];
+	  y[j] = s->p->y[id[j]];
+	  z[j] = s->p->z[id[j]];
+	  q[j] = s->q[id[j]];
+	}
+
+	energy += pair_chunk( p, table, s->box_l, lengthi, xi, s->q[i], m, x, y, z, q, id, fi, ft );
+      }
+
+      for(int k=0;k<3;k++)
+	ft[k][i] += fi[k];
+    }
+
+    reduce_thread_forces( s->nparticles, nthreads, buf, f );
+  }
+
+  s->energy += energy;
+
+  FFTW_FREE(buf);
 }
 
 /* void Shortrange_Interactions( domain_decomposition_t *dd, parameters_t *p, forces_t *f ) { */
@@ -126,13 +612,11 @@ void Realteil( system_t *s, parameters_t *p, forces_t *f )
     /* Zwei Teilchennummern: */
     int t1,t2;
     /* Minimum-Image-Abstand: */
-    FLOAT_TYPE dx,dy,dz,r, r2;
+    FLOAT_TYPE dx,dy,dz,r2;
     /* Staerke der elegktrostatischen Kraefte */
-    FLOAT_TYPE fak;
-    /* Zur Approximation der Fehlerfunktion */
-    FLOAT_TYPE ar,erfc_teil;
-    FLOAT_TYPE lengthi = 1.0/s->length;
-    const FLOAT_TYPE wupi = 1.77245385090551602729816748334;
+    FLOAT_TYPE fak, pot;
+    const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+    const pair_table_t *table = realspace_table( p, 0 );
 
     for (t1=0; t1<s->nparticles; t1++) {
         for (t2=0; t2<s->nparticles; t2++) {
@@ -140,27 +624,22 @@ void Realteil( system_t *s, parameters_t *p, forces_t *f )
 	    continue;
 
 	  dx = s->p->x[t1] - s->p->x[t2];
-	  dx -= ROUND(dx*lengthi)*s->length;
+	  dx -= ROUND(dx*lengthi[0])*s->box_l[0];
 	  dy = s->p->y[t1] - s->p->y[t2];
-	  dy -= ROUND(dy*lengthi)*s->length;
+	  dy -= ROUND(dy*lengthi[1])*s->box_l[1];
 	  dz = s->p->z[t1] - s->p->z[t2];
-	  dz -= ROUND(dz*lengthi)*s->length;
+	  dz -= ROUND(dz*lengthi[2])*s->box_l[2];
 	  
-	  r = SQRT(SQR(dx) + SQR(dy) + SQR(dz));
-	  if (r<=p->rcut)
+	  r2 = SQR(dx) + SQR(dy) + SQR(dz);
+	  if (r2<=SQR(p->rcut))
             {
-	      ar= p->alpha*r;
-
-	      erfc_teil = ERFC(ar);
-	      r2 = SQR(r);
-	      fak = s->q[t1]*s->q[t2]*
-		(erfc_teil/r+(2.0*p->alpha/wupi)*EXP(-ar*ar))/r2;
+	      fak = s->q[t1]*s->q[t2]*ewald_pair( p, table, r2, &pot );
 	      
 	      f->f_r->x[t1] += fak*dx;
 	      f->f_r->y[t1] += fak*dy;
 	      f->f_r->z[t1] += fak*dz;
 
-	      s->energy += 0.5 * s->q[t1] * s->q[t2] * erfc_teil / r;
+	      s->energy += 0.5 * s->q[t1] * s->q[t2] * pot;
             }
         }
     }
@@ -169,7 +648,7 @@ void Realteil( system_t *s, parameters_t *p, forces_t *f )
 static void build_neighbor_list_for_particle(system_t *s, parameters_t *p, data_t *d, vector_array_t *buffer, int *neighbor_id_buffer, FLOAT_TYPE *charges_buffer, int id) {
   int i, j, np=0, last=id;
     FLOAT_TYPE r, dx, dy, dz;
-    FLOAT_TYPE lengthi = 1.0/s->length;
+    const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
     neighbor_list_t *neighbor_list = d->neighbor_list;
 
     for (i=id+1;i!=id;i--) {
@@ -180,14 +659,14 @@ static void build_neighbor_list_for_particle(system_t *s, parameters_t *p, data_
 	  break;
       }
       dx = s->p->x[id] - s->p->x[i];
-      dx -= ROUND(dx*lengthi)*s->length;
+      dx -= ROUND(dx*lengthi[0])*s->box_l[0];
       if(dx > p->rcut) {
 	break;
       }
       dy = s->p->y[id] - s->p->y[i];
-      dy -= ROUND(dy*lengthi)*s->length;
+      dy -= ROUND(dy*lengthi[1])*s->box_l[1];
       dz = s->p->z[id] - s->p->z[i];
-      dz -= ROUND(dz*lengthi)*s->length;
+      dz -= ROUND(dz*lengthi[2])*s->box_l[2];
 
       r = SQRT(SQR(dx) + SQR(dy) + SQR(dz));
 
@@ -212,14 +691,14 @@ static void build_neighbor_list_for_particle(system_t *s, parameters_t *p, data_
       if( i == last)
 	break;
       dx = s->p->x[id] - s->p->x[i];
-      dx -= ROUND(dx*lengthi)*s->length;
+      dx -= ROUND(dx*lengthi[0])*s->box_l[0];
       if(fabs(dx) > p->rcut) {
 	break;
       }
       dy = s->p->y[id] - s->p->y[i];
-      dy -= ROUND(dy*lengthi)*s->length;
+      dy -= ROUND(dy*lengthi[1])*s->box_l[1];
       dz = s->p->z[id] - s->p->z[i];
-      dz -= ROUND(dz*lengthi)*s->length;
+      dz -= ROUND(dz*lengthi[2])*s->box_l[2];
 
       r = SQRT(SQR(dx) + SQR(dy) + SQR(dz));
 
@@ -292,13 +771,11 @@ void Realpart_neighborlist(system_t *s, parameters_t *p, data_t *d, forces_t *f
 {
     int i,j;
     /* Minimum-Image-Abstand: */
-    FLOAT_TYPE dx,dy,dz,r, r2;
+    FLOAT_TYPE dx,dy,dz,r2;
     /* Staerke der elegktrostatischen Kraefte */
-    FLOAT_TYPE fak;
-    /* Zur Approximation der Fehlerfunktion */
-    FLOAT_TYPE ar,erfc_teil;
-    FLOAT_TYPE lengthi = 1.0/s->length;
-    const FLOAT_TYPE wupi = 1.77245385090551602729816748334;
+    FLOAT_TYPE fak, pot;
+    const FLOAT_TYPE lengthi[3] = { 1.0/s->box_l[0], 1.0/s->box_l[1], 1.0/s->box_l[2] };
+    const pair_table_t *table = realspace_table( p, 0 );
 
     neighbor_list_t *neighbor_list = d->neighbor_list;
 
@@ -306,21 +783,16 @@ void Realpart_neighborlist(system_t *s, parameters_t *p, data_t *d, forces_t *f
         for (j=0; j<neighbor_list[i].n; j++)
         {
             dx = s->p->fields[0][i] - neighbor_list[i].p->x[j];
-            dx -= ROUND(dx*lengthi)*s->length;
+            dx -= ROUND(dx*lengthi[0])*s->box_l[0];
             dy = s->p->fields[1][i] - neighbor_list[i].p->y[j];
-            dy -= ROUND(dy*lengthi)*s->length;
+            dy -= ROUND(dy*lengthi[1])*s->box_l[1];
             dz = s->p->fields[2][i] - neighbor_list[i].p->z[j];
-            dz -= ROUND(dz*lengthi)*s->length;
+            dz -= ROUND(dz*lengthi[2])*s->box_l[2];
 
-            r = SQRT(SQR(dx) + SQR(dy) + SQR(dz));
-            if ( r <= p->rcut )
+            r2 = SQR(dx) + SQR(dy) + SQR(dz);
+            if ( r2 <= SQR(p->rcut) )
             {
-	      ar= p->alpha*r;
-
-	      erfc_teil = ERFC(ar);
-	      r2 = SQR(r);
-	      fak = s->q[i]*neighbor_list[i].q[j]*
-		(erfc_teil/r+(2.0*p->alpha/wupi)*EXP(-ar*ar))/r2;
+	      fak = s->q[i]*neighbor_list[i].q[j]*ewald_pair( p, table, r2, &pot );
 	      
 	      f->f_r->x[i] += fak*dx;
 	      f->f_r->y[i] += fak*dy;
@@ -340,8 +812,144 @@ void Free_neighborlist(data_t *d) {
   FFTW_FREE(d->neighbor_list);
 }
 
+/* Cutoff error, plus the interpolation error if the kernel is tabulated. */
 FLOAT_TYPE Realspace_error( const system_t *s, const parameters_t *p )
 {
-  return (2.0*s->q2*EXP(-SQR(p->rcut * p->alpha))) / (SQRT((double)s->nparticles* p->rcut*s->length*s->length*s->length ));
+  const FLOAT_TYPE cut = (2.0*s->q2*EXP(-SQR(p->rcut * p->alpha))) / (SQRT((double)s->nparticles* p->rcut*s->box_l[0]*s->box_l[1]*s->box_l[2] ));
+
+  return SQRT(SQR(cut) + SQR(Realspace_table_error( s, p )));
+}
+
+static pair_table_t *pair_table = NULL;
+
+/* S_F, S_E and their derivatives in u = r^2, see pair_table_t. For
+   small alpha r the power series avoid the cancellation. */
+static void pair_table_functions( FLOAT_TYPE alpha, FLOAT_TYPE u, FLOAT_TYPE *f, FLOAT_TYPE *df,
+				  FLOAT_TYPE *e, FLOAT_TYPE *de ) {
+  const FLOAT_TYPE c = 2.0*alpha/1.77245385090551602729816748334;
+  const FLOAT_TYPE x2 = SQR(alpha)*u;
+  FLOAT_TYPE r, ex, term;
+
+  if(x2 < 0.5) {
+    /* term = (-x2)^k/k! */
+    term = 1.0;
+    *e = *f = *df = 0.0;
+    for(int k = 0; k < 24; k++) {
+      *e += term / (2*k+1);
+      *f += 2.0 * term / (2*k+3);
+      *df -= 2.0 * term / (2*k+5);
+      term *= -x2 / (k+1);
+    }
+    *e *= c;
+    *f *= c*SQR(alpha);
+    *df *= c*SQR(SQR(alpha));
+  } else {
+    r = SQRT(u);
+    ex = EXP(-x2);
+    *e = ERF(alpha*r)/r;
+    *f = (*e - c*ex)/u;
+    *df = (c*SQR(alpha)*ex - 1.5 * *f)/u;
+  }
+  *de = -0.5 * *f;
+}
+
+static void build_pair_table( pair_table_t *t ) {
+  const FLOAT_TYPE h = SQR(t->rcut) / t->n;
+  FLOAT_TYPE f[2], df[2], e[2], de[2], u, x, fak, pot, fak_ex;
+  FLOAT_TYPE *c;
+
+  t->hi = 1.0 / h;
+
+  pair_table_functions( t->alpha, 0.0, &f[0], &df[0], &e[0], &de[0] );
+  for(int k = 0; k < t->n; k++) {
+    pair_table_functions( t->alpha, (k+1)*h, &f[1], &df[1], &e[1], &de[1] );
+
+    c = t->c + 8*k;
+    c[0] = f[0];
+    c[1] = h*df[0];
+    c[2] = 3.0*(f[1] - f[0]) - h*(2.0*df[0] + df[1]);
+    c[3] = 2.0*(f[0] - f[1]) + h*(df[0] + df[1]);
+    c[4] = e[0];
+    c[5] = h*de[0];
+    c[6] = 3.0*(e[1] - e[0]) - h*(2.0*de[0] + de[1]);
+    c[7] = 2.0*(e[0] - e[1]) + h*(de[0] + de[1]);
+
+    f[0] = f[1]; df[0] = df[1]; e[0] = e[1]; de[0] = de[1];
+  }
+
+  /* The interpolation error is largest inside the intervals */
+  t->error = 0.0;
+  for(int k = 0; k < t->n; k++) {
+    for(int i = 1; i < 4; i++) {
+      u = (k + 0.25*i)*h;
+      x = SQRT(u)*t->alpha;
+      fak = Pair_table_eval( t, u, &pot );
+      fak_ex = (ERFC(x)/SQRT(u) + 2.0*t->alpha/1.77245385090551602729816748334*EXP(-SQR(x)))/u;
+      if(FLOAT_ABS(fak - fak_ex)*SQRT(u) > t->error)
+	t->error = FLOAT_ABS(fak - fak_ex)*SQRT(u);
+    }
+  }
+}
+
+/* Single cached table, e.g. an alpha sweep rebuilds it for every alpha. */
+const pair_table_t *Pair_table( const parameters_t *p, int n ) {
+  assert(n > 0);
+
+  if((pair_table != NULL) && ((pair_table->alpha != p->alpha) || (pair_table->rcut != p->rcut) || (pair_table->n != n)))
+    Free_pair_table();
+
+  if(pair_table == NULL) {
+    pair_table = (pair_table_t *)Init_array( 1, sizeof(pair_table_t) );
+    pair_table->n = n;
+    pair_table->alpha = p->alpha;
+    pair_table->rcut = p->rcut;
+    pair_table->c = (FLOAT_TYPE *)Init_array( 8*n, sizeof(FLOAT_TYPE) );
+    build_pair_table( pair_table );
+  }
+
+  return pair_table;
+}
+
+void Free_pair_table( void ) {
+  if(pair_table == NULL)
+    return;
+
+  FFTW_FREE(pair_table->c);
+  FFTW_FREE(pair_table);
+  pair_table = NULL;
+}
+
+/* Interpolation error of a table with n intervals. The cached table is
+   used if it matches, otherwise a temporary one is built so that the
+   table of the force kernels is kept. */
+static FLOAT_TYPE pair_table_error( const parameters_t *p, int n ) {
+  pair_table_t t;
+
+  if((pair_table != NULL) && (pair_table->alpha == p->alpha) && (pair_table->rcut == p->rcut) && (pair_table->n == n))
+    return pair_table->error;
+
+  t.n = n;
+  t.alpha = p->alpha;
+  t.rcut = p->rcut;
+  t.c = (FLOAT_TYPE *)Init_array( 8*n, sizeof(FLOAT_TYPE) );
+  build_pair_table( &t );
+  FFTW_FREE(t.c);
+
+  return t.error;
+}
+
+/* Pair errors with random signs, summed over the neighbors within rcut.
+   The table is the one Calculate_forces uses for s. */
+FLOAT_TYPE Realspace_table_error( const system_t *s, const parameters_t *p )
+{
+  const FLOAT_TYPE V = s->box_l[0]*s->box_l[1]*s->box_l[2];
+  const int simd = P3M_VERLET_LISTS || (s->nparticles >= P3M_LINKED_CELLS_MIN);
+  const int n = realspace_table_size( simd );
+
+  if((n == 0) || (p->rcut <= 0.0))
+    return 0.0;
+
+  return pair_table_error( p, n ) * s->q2 *
+    SQRT(4.0/3.0*PI*p->rcut*p->rcut*p->rcut / (V * s->nparticles));
 }
 
@@ -37,13 +37,54 @@ void Free_neighborlist(data_t *);
 
 void Realteil(system_t *, parameters_t *, forces_t *);
 
+// linked cell algorithm, O(n) for fixed density
+
+void Realpart_cells(system_t *, parameters_t *, forces_t *);
+// Releases the cell decomposition kept between the calls
+void Free_realspace_dd( void );
+
+// functions for Verlet lists, rebuilt when a particle moved more than skin/2
+
+void Update_verlet_list(system_t *, parameters_t *, data_t *, FLOAT_TYPE skin);
+void Realpart_verlet(system_t *, parameters_t *, data_t *, forces_t *);
+void Free_verlet_list(verlet_list_t *);
+
 FLOAT_TYPE Realpart_corr_error(FLOAT_TYPE rcut, FLOAT_TYPE alpha);
 
 // Error of the realspace part
 
 FLOAT_TYPE Realspace_error( const system_t *, const parameters_t * );
 
+// Tabulated pair kernel, the table is rebuilt if alpha, rcut or n change
+
+const pair_table_t *Pair_table( const parameters_t *, int n );
+void Free_pair_table( void );
+
+// Error of the real space part from the table interpolation, 0 if no table is used
+
+FLOAT_TYPE Realspace_table_error( const system_t *, const parameters_t * );
+
+// Force factor and potential of a pair at distance^2 r2 <= rcut^2 for unit charges
+
+static inline FLOAT_TYPE Pair_table_eval( const pair_table_t *t, FLOAT_TYPE r2, FLOAT_TYPE *pot ) {
+  FLOAT_TYPE x = r2 * t->hi;
+  int k = (int)x;
+  const FLOAT_TYPE *c;
+  FLOAT_TYPE ri;
+
+  if(k >= t->n)
+    k = t->n - 1;
+  x -= k;
+  c = t->c + 8*k;
+  ri = 1.0/SQRT(r2);
+
+  *pot = ri - (c[4] + x*(c[5] + x*(c[6] + x*c[7])));
+  return ri*ri*ri - (c[0] + x*(c[1] + x*(c[2] + x*c[3])));
+}
+
 // Count neighbor pairs in s
 int *count_neighbors( system_t *s, parameters_t *p );
+// Same with linked cells
+int *count_neighbors_dd( system_t *s, parameters_t *p );
 
 #endif
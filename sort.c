@@ -13,7 +13,12 @@
        You should have received a copy of the GNU General Public License
        along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
 
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
 #include "sort.h"
+#include "common.h"
 
 void sort_particles_r(system_t *s, int m, int n);
 
@@ -72,3 +77,98 @@ void sort_particles_r(system_t *s, int m, int n) {
     
   }
 }
+
+/* Spreads the lower 21 bits of v so that there are two zero bits between them. */
+inline static uint64_t spread_bits(uint64_t v) {
+  uint64_t r = 0;
+  int b;
+
+  for(b = 0; b < 21; b++)
+    r |= ((v >> b) & 1) << (3*b);
+  return r;
+}
+
+inline static int mesh_cell(FLOAT_TYPE x, FLOAT_TYPE hi, int mesh) {
+  int c = (int)FLOOR(x * hi);
+  return (c < 0) ? 0 : ((c >= mesh) ? mesh - 1 : c);
+}
+
+// Computes the order of the particles along a Morton (z-order) curve
+// over the mesh cells. perm[i] is the original index of the i'th particle.
+// Keys are sorted with a LSD radix sort ( O(n) ).
+void morton_order(system_t *s, int mesh, int *perm) {
+  const int n = s->nparticles;
+  const FLOAT_TYPE hi = mesh / s->length;
+  uint64_t *key = (uint64_t *)Init_array(n, sizeof(uint64_t));
+  uint64_t *key_tmp = (uint64_t *)Init_array(n, sizeof(uint64_t));
+  int *perm_tmp = (int *)Init_array(n, sizeof(int));
+  int count[256];
+  int i, pass, bits = 1, passes;
+
+  while((1 << bits) < mesh)
+    bits++;
+  passes = (3*bits + 7) / 8;
+
+  for(i = 0; i < n; i++) {
+    key[i] = spread_bits(mesh_cell(s->p->x[i], hi, mesh)) << 2 |
+      spread_bits(mesh_cell(s->p->y[i], hi, mesh)) << 1 |
+      spread_bits(mesh_cell(s->p->z[i], hi, mesh));
+    perm[i] = i;
+  }
+
+  for(pass = 0; pass < passes; pass++) {
+    const int shift = 8*pass;
+    int sum = 0, c;
+
+    memset(count, 0, sizeof(count));
+    for(i = 0; i < n; i++)
+      count[(key[i] >> shift) & 0xff]++;
+    for(c = 0; c < 256; c++) {
+      const int tmp = count[c];
+      count[c] = sum;
+      sum += tmp;
+    }
+    for(i = 0; i < n; i++) {
+      const int dst = count[(key[i] >> shift) & 0xff]++;
+      key_tmp[dst] = key[i];
+      perm_tmp[dst] = perm[i];
+    }
+    memcpy(key, key_tmp, n*sizeof(uint64_t));
+    memcpy(perm, perm_tmp, n*sizeof(int));
+  }
+
+  FFTW_FREE(key);
+  FFTW_FREE(key_tmp);
+  FFTW_FREE(perm_tmp);
+}
+
+// Copy of the positions and charges of s in the order given by perm.
+system_t *Init_system_permuted(system_t *s, const int *perm) {
+  system_t *t = (system_t *)Init_array( 1, sizeof(system_t));
+
+  t->p = Init_vector_array(s->nparticles);
+  t->q = (FLOAT_TYPE *)Init_array(s->nparticles, sizeof(FLOAT_TYPE));
+  Permute_system(t, s, perm);
+
+  return t;
+}
+
+/* Refills t, allocated for s->nparticles particles, with s in the order perm. */
+void Permute_system(system_t *t, system_t *s, const int *perm) {
+  vector_array_t *p = t->p;
+  FLOAT_TYPE *q = t->q;
+  int i;
+
+  *t = *s;
+  t->p = p;
+  t->q = q;
+  t->v = NULL;
+  t->reference = NULL;
+
+  for(i = 0; i < s->nparticles; i++) {
+    t->p->x[i] = s->p->x[perm[i]];
+    t->p->y[i] = s->p->y[perm[i]];
+    t->p->z[i] = s->p->z[perm[i]];
+    t->q[i] = s->q[perm[i]];
+  }
+}
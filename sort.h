@@ -19,5 +19,8 @@
 #include "types.h"
 
 void sort_particles(system_t *);
+void morton_order(system_t *s, int mesh, int *perm);
+system_t *Init_system_permuted(system_t *s, const int *perm);
+void Permute_system(system_t *t, system_t *s, const int *perm);
 
 #endif
@@ -0,0 +1,102 @@
+#!/usr/bin/python
+#
+# Generates the B-spline coefficient tables in window-functions.c.
+# Usage: bspline_tables.py [max_cao]
+#
+# bspline_coef[cao][k][i] is the coefficient of x^k of assignment
+# weight i, M_cao(x + 0.5 + cao - 1 - i) with M_cao the cardinal
+# B-spline of order cao, for x in [-0.5,0.5].
+#
+# bspline_alias_coef[cao][j] is the coefficient of c^j, c = cos^2(pi z),
+# of the aliasing sum sum_m sinc(z+m)^(2 cao), which follows from the
+# derivatives of pi cot(pi z) = sum_m 1/(z+m).
+
+from fractions import Fraction as F
+from math import factorial
+import sys
+
+MAXCAO = int(sys.argv[1]) if len(sys.argv) > 1 else 12
+
+def binom(n, k):
+    return factorial(n) // (factorial(k) * factorial(n - k))
+
+def polymul(a, b):
+    r = [F(0)] * (len(a) + len(b) - 1)
+    for i, x in enumerate(a):
+        for j, y in enumerate(b):
+            r[i + j] += x * y
+    return r
+
+def polypow(a, n):
+    r = [F(1)]
+    for _ in range(n):
+        r = polymul(r, a)
+    return r
+
+def polyadd(a, b):
+    r = [F(0)] * max(len(a), len(b))
+    for i, x in enumerate(a):
+        r[i] += x
+    for i, x in enumerate(b):
+        r[i] += x
+    return r
+
+def weights(cao):
+    W = []
+    for i in range(cao):
+        c = [F(0)] * cao
+        s = F(1, 2) + cao - 1 - i
+        for k in range(0, cao - i):
+            p = polypow([s - k, F(1)], cao - 1)
+            f = F((-1)**k * binom(cao, k), factorial(cao - 1))
+            for m in range(len(p)):
+                c[m] += f * p[m]
+        W.append(c)
+    return W
+
+def alias_sum(cao):
+    # Q_{n+1}(u) = -(1+u^2) Q_n'(u), Q_0 = u with u = cot(pi z)
+    q = [F(0), F(1)]
+    for _ in range(2 * cao - 1):
+        d = [m * q[m] for m in range(1, len(q))] or [F(0)]
+        q = [-x for x in polymul(d, [F(1), F(0), F(1)])]
+    # sin^(2 cao) u^(2 j) = c^j (1-c)^(cao-j)
+    r = [F(0)]
+    for j in range(0, len(q), 2):
+        if q[j] != 0:
+            t = polymul([F(0)] * (j // 2) + [F(1)], polypow([F(1), F(-1)], cao - j // 2))
+            r = polyadd(r, [-q[j] * x for x in t])
+    r = [x / factorial(2 * cao - 1) for x in r]
+    return r[:cao] + [F(0)] * (cao - len(r))
+
+def lit(f):
+    if f == 0:
+        return '0.0'
+    if f.denominator == 1:
+        return '%d.0' % f.numerator
+    return '%d.0/%d.0' % (f.numerator, f.denominator)
+
+out = []
+out.append('/* Generated by tools/bspline_tables.py %d, weight i is' % MAXCAO)
+out.append('   M_cao(x + 0.5 + cao - 1 - i). */')
+out.append('const FLOAT_TYPE bspline_coef[BSPLINE_MAX_CAO+1][BSPLINE_MAX_CAO][BSPLINE_MAX_CAO] = {')
+out.append('  /* cao 0 (unused) */')
+out.append('  { { 0.0 } },')
+for cao in range(1, MAXCAO + 1):
+    W = weights(cao)
+    out.append('  /* cao %d */' % cao)
+    out.append('  {')
+    for k in range(cao):
+        out.append('    { %s },' % ', '.join(lit(W[i][k]) for i in range(cao)))
+    out[-1] = out[-1].rstrip(',')
+    out.append('  },' if cao < MAXCAO else '  }')
+out.append('};')
+out.append('')
+out.append('/* Generated by tools/bspline_tables.py %d, coefficients of' % MAXCAO)
+out.append('   sum_m sinc(z+m)^(2 cao) in powers of cos^2(pi z). */')
+out.append('const FLOAT_TYPE bspline_alias_coef[BSPLINE_MAX_CAO+1][BSPLINE_MAX_CAO] = {')
+out.append('  { 0.0 },')
+for cao in range(1, MAXCAO + 1):
+    out.append('  { %s }%s' % (', '.join(lit(x) for x in alias_sum(cao)), ',' if cao < MAXCAO else ''))
+out.append('};')
+print('\n'.join(out))
@@ -17,11 +17,12 @@
 #define TUNING_H
 
 #include "types.h"
+#include "window-functions.h"
 
 // @TODO: Make this more elegant
 
 #define CAO_MIN 2
-#define CAO_MAX 7
+#define CAO_MAX BSPLINE_MAX_CAO
 
 #define N_TUNING_SAMPLES 50
 
@@ -42,7 +42,7 @@ int main(int argc, char *argv[]) {
 
   system->q[0] = 1.0;
   system->q[1] = -1.0;
-  system->length = 100.0;
+  Set_box(system, 100.0, 100.0, 100.0);
   system->q2 = 2.;
   
   system->p->x[0] = system->p->x[1] = 0.5*box; 
@@ -36,16 +36,28 @@ extern int __detailed_timings;
 #define COS cosf
 #define SQRT sqrtf
 #define ERFC erfcf
+#define ERF erff
 #define FLOAT_ABS fabsf
 #define FFTW_FREE fftwf_free
 #define FFTW_MALLOC fftwf_malloc
 #define FFTW_EXECUTE fftwf_execute
 #define FFTW_COMPLEX fftwf_complex
 #define FFTW_PLAN_DFT_3D fftwf_plan_dft_3d
+#define FFTW_PLAN_DFT_R2C_3D fftwf_plan_dft_r2c_3d
+#define FFTW_PLAN_DFT_C2R_3D fftwf_plan_dft_c2r_3d
+#define FFTW_PLAN_MANY_DFT fftwf_plan_many_dft
 #define FFTW_PLAN fftwf_plan
 #define FFTW_DESTROY_PLAN fftwf_destroy_plan
+#define FFTW_INIT_THREADS fftwf_init_threads
+#define FFTW_PLAN_WITH_NTHREADS fftwf_plan_with_nthreads
+#define FFTW_FORGET_WISDOM fftwf_forget_wisdom
+#define FFTW_IMPORT_WISDOM fftwf_import_wisdom_from_filename
+#define FFTW_EXPORT_WISDOM fftwf_export_wisdom_to_filename
+#define FFTW_PREC_NAME "f"
 #define ROUND roundf
+#define RINT rintf
 #define FLOOR floorf
+#define LOG logf
 #endif
 
 #ifdef DOUBLE_PREC
@@ -57,6 +69,7 @@ extern int __detailed_timings;
 #define COS cos
 #define SQRT sqrt
 #define ERFC erfc
+#define ERF erf
 #define FLOAT_ABS fabs
 #define FFTW_FREE fftw_free
 #define FFTW_MALLOC fftw_malloc
@@ -65,9 +78,17 @@ extern int __detailed_timings;
 #define FFTW_PLAN_DFT_3D fftw_plan_dft_3d
 #define FFTW_PLAN_DFT_R2C_3D fftw_plan_dft_r2c_3d
 #define FFTW_PLAN_DFT_C2R_3D fftw_plan_dft_c2r_3d
+#define FFTW_PLAN_MANY_DFT fftw_plan_many_dft
 #define FFTW_PLAN fftw_plan
 #define FFTW_DESTROY_PLAN fftw_destroy_plan
+#define FFTW_INIT_THREADS fftw_init_threads
+#define FFTW_PLAN_WITH_NTHREADS fftw_plan_with_nthreads
+#define FFTW_FORGET_WISDOM fftw_forget_wisdom
+#define FFTW_IMPORT_WISDOM fftw_import_wisdom_from_filename
+#define FFTW_EXPORT_WISDOM fftw_export_wisdom_to_filename
+#define FFTW_PREC_NAME "d"
 #define ROUND round
+#define RINT rint
 #define FLOOR floor
 #define LOG log
 #endif
@@ -82,17 +103,26 @@ extern int __detailed_timings;
 #define COS cosl
 #define SQRT sqrtl
 #define ERFC erfcl
+#define ERF erfl
 #define FLOAT_ABS fabsl
 #define FFTW_FREE fftwl_free
 #define FFTW_MALLOC fftwl_malloc
 #define FFTW_EXECUTE fftwl_execute
 #define FFTW_COMPLEX fftwl_complex
 #define FFTW_PLAN_DFT_3D fftwl_plan_dft_3d
-#define FFTW_PLAN_DFT_R2C_3D fftw_plan_dft_r2c_3d
-#define FFTW_PLAN_DFT_C2R_3D fftw_plan_dft_c2r_3d
+#define FFTW_PLAN_DFT_R2C_3D fftwl_plan_dft_r2c_3d
+#define FFTW_PLAN_DFT_C2R_3D fftwl_plan_dft_c2r_3d
+#define FFTW_PLAN_MANY_DFT fftwl_plan_many_dft
 #define FFTW_PLAN fftwl_plan
 #define FFTW_DESTROY_PLAN fftwl_destroy_plan
+#define FFTW_INIT_THREADS fftwl_init_threads
+#define FFTW_PLAN_WITH_NTHREADS fftwl_plan_with_nthreads
+#define FFTW_FORGET_WISDOM fftwl_forget_wisdom
+#define FFTW_IMPORT_WISDOM fftwl_import_wisdom_from_filename
+#define FFTW_EXPORT_WISDOM fftwl_export_wisdom_to_filename
+#define FFTW_PREC_NAME "l"
 #define ROUND roundl
+#define RINT rintl
 #define FLOOR floorl
 #define LOG logl
 #endif
@@ -114,7 +144,9 @@ enum {
     METHOD_EWALD = 4,
     METHOD_P3M_ik_cuda = 5,
     METHOD_P3M_ik_r = 6,
-    METHOD_P3M_ad_r = 7
+    METHOD_P3M_ad_r = 7,
+    METHOD_P3M_ik_r_p = 8,
+    METHOD_P3M_ik_mpi = 9
 };
 
 // Container type for arrays of 3d-vectors
@@ -162,8 +194,10 @@ typedef struct {
 
 typedef
 struct {
-    // box length
+    // box length, the longest axis for a non-cubic box
     FLOAT_TYPE length;
+    // box lengths per axis
+    FLOAT_TYPE box_l[3];
     // number of particles
     int        nparticles;
     // particle positions;
@@ -196,6 +230,45 @@ struct {
   int *id;
 } neighbor_list_t;
 
+// Verlet list with skin, every pair within rcut + skin is stored once
+// at the smaller id. Neighbors of i are id[offset[i]] ... id[offset[i+1]-1].
+
+typedef
+struct {
+  // number of particles the list was built for
+  int n;
+  // list radius, rcut + skin
+  FLOAT_TYPE rlist;
+  FLOAT_TYPE skin;
+  // box at build time
+  FLOAT_TYPE box_l[3];
+  // row offsets, n+1 entries
+  int *offset;
+  // neighbor ids and allocated size
+  int *id;
+  int size;
+  // positions at build time for the displacement check
+  vector_array_t *p0;
+  // number of builds
+  int builds;
+} verlet_list_t;
+
+// Table of the real space pair kernel for (alpha, rcut) in u = r^2,
+// piecewise cubic Hermite on n intervals of [0, rcut^2]. The smooth
+// parts S_F = 1/r^3 - fak and S_E = 1/r - erfc(alpha r)/r are stored,
+// coefficients c[8*k] ... c[8*k+3] for S_F and c[8*k+4] ... for S_E.
+
+typedef
+struct {
+  int n;
+  FLOAT_TYPE alpha, rcut;
+  // intervals per unit of u
+  FLOAT_TYPE hi;
+  FLOAT_TYPE *c;
+  // max. abs. error of the pair force for unit charges
+  FLOAT_TYPE error;
+} pair_table_t;
+
 
 // Struct holding method parameters.
 
@@ -221,10 +294,28 @@ typedef struct {
   FLOAT_TYPE **interpol;
   // Interpolation of the derivative
   FLOAT_TYPE **interpol_d;
+  // If true, there are no tables and the weights
+  // are evaluated directly from the polynomials.
+  int direct;
   // array function pointers to the FT of the CA-function
   FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE);
 } interpolation_t;
 
+// One dimensional factors of the aliasing sums for a (mesh, cao, mc)
+// triple. Row n + mesh/2 of each table holds the 2*mc+1 values for
+// the shifted mesh index n and m = -mc..mc.
+typedef struct aliasing_table_s {
+  int mesh, cao, mc;
+  FLOAT_TYPE (*U_hat)(int, FLOAT_TYPE);
+  // Shifted wave numbers n + m*mesh
+  FLOAT_TYPE *nm;
+  // sinc(nm/mesh)^(2 cao)
+  FLOAT_TYPE *sinc2;
+  // U_hat(cao, nm/mesh)^2, same as sinc2 if U_hat is NULL
+  FLOAT_TYPE *u2;
+  struct aliasing_table_s *next;
+} aliasing_table_t;
+
 typedef struct {
   double avg;
   double sgm;
@@ -252,22 +343,64 @@ typedef struct {
 typedef struct {
   // Mesh size the struct is initialized for
   int mesh;
+  // Mesh points per axis, all equal to mesh for a cubic mesh
+  int grid[3];
   // Influence function
   FLOAT_TYPE *G_hat;
+  // Number of k_z planes stored in G_hat, mesh/2+1 for r2c methods
+  int G_hat_nz;
   // Charge mesh
   FLOAT_TYPE *Qmesh;
   // Force mesh for k space differentiation
   vector_array_t *Fmesh;
+  // Ghost-padded charge and force meshes with (mesh+cao-1)^3 points,
+  // NULL if not used
+  FLOAT_TYPE *Qmesh_pad;
+  vector_array_t *Fmesh_pad;
+  // Single precision charge mesh, force meshes, influence function
+  // and plans for the mixed precision mode, NULL if not used
+  float *Qmesh_f;
+  float *Fmesh_f[3];
+  float *G_hat_f;
+  fftwf_plan forward_plan_f;
+  fftwf_plan backward_plan_f[3];
+  // Real space charge mesh, positions and charges at the last assignment
+  // and scratch list of moved particles for the incremental charge
+  // assignment, NULL if not used
+  FLOAT_TYPE *Qmesh_inc;
+  FLOAT_TYPE *pos_inc;
+  FLOAT_TYPE *q_inc;
+  int *inc_ids;
+  int inc_valid, inc_steps;
+  // Forward transformed charge mesh of the current configuration for
+  // alpha sweeps, NULL if not used
+  FLOAT_TYPE *Qmesh_hat;
+  int Qmesh_hat_valid;
+  // Morton order, ordered copy of the system and its forces for the
+  // reordered k-space part, rebuilt when the positions change, NULL if
+  // not used
+  int *order;
+  system_t *ordered;
+  forces_t *ordered_forces;
   // Shifted kvectors (fftw convention)
   FLOAT_TYPE *nshift;
   // Fourier coefficients of the differential operator
   FLOAT_TYPE *Dn;
+  // Per axis views into nshift and Dn, all three are the same array
+  // for a cubic mesh
+  FLOAT_TYPE *nshift_axis[3];
+  FLOAT_TYPE *Dn_axis[3];
+  // Per axis aliasing tables of the influence function, owned by the
+  // table cache
+  const aliasing_table_t *alias[3];
   // Derivatives of the charge assignment function for analytical differentiation
   /* FLOAT_TYPE *dQdx[2], *dQdy[2], *dQdz[2]; */
   FLOAT_TYPE *dQ[2];
   // Cache for charge assignment
   int *ca_ind[2];
   FLOAT_TYPE *cf[2];
+  // If set, cf and dQ only hold the 3*cao one-dimensional weights per particle
+  int cf_separable;
   // Struct for interpolated charge assignment function
   interpolation_t *inter;
   // fftw plans
@@ -279,9 +412,13 @@ typedef struct {
   FFTW_PLAN backward_plan[3];
   // neighbor list for real space calculation
   neighbor_list_t *neighbor_list;
+  // Verlet list for real space calculation, NULL if not used
+  verlet_list_t *verlet_list;
   // Self forces corrections
   FLOAT_TYPE *self_force_corrections;
+  // Method private data and the method's hook to release it
   void *method_data;
+  void ( *free_method_data ) ( void * );
   runtime_t runtime;
 } data_t;
 
@@ -297,6 +434,9 @@ enum {
     METHOD_FLAG_Qmesh = 32, // Method needs charge mesh
     METHOD_FLAG_ca = 64, // Method uses charge assignment
     METHOD_FLAG_self_force_correction = 128, // Method need self force correction
+    METHOD_FLAG_r2c = 256, // Method uses real to complex transforms, G_hat is stored on the half spectrum
+    METHOD_FLAG_noncubic = 512, // Method supports non-cubic boxes, with per axis meshes
+    METHOD_FLAG_mesh_float = 1024, // Method has single precision meshes, with P3M_MESH_FLOAT no double meshes are allocated
 };
 
 // Common flags for all p3m methods for convinience
@@ -307,17 +447,21 @@ typedef struct {
     int  method_id;
     const char *method_name;
     const char *method_name_short;
-    char flags;
+    int flags;
     data_t * ( *Init ) ( system_t *, parameters_t * );
     void ( *Influence_function ) ( system_t *, parameters_t *, data_t * );
     void ( *Kspace_force ) ( system_t *, parameters_t *, data_t *, forces_t * );
     FLOAT_TYPE ( *Error ) ( system_t *, parameters_t * );
     FLOAT_TYPE ( *Error_k ) ( system_t *, parameters_t * );
+    // Releases data_t::method_data, called from Free_data; NULL if unused
+    void ( *Free ) ( void * );
 } method_t;
 
 // Function pointer types
 
 typedef FLOAT_TYPE (*R3_to_R)(int, int, int, system_t *s, parameters_t *p);
 typedef FLOAT_TYPE (*R_to_R)(FLOAT_TYPE);
+// Value of an influence function at mesh point (NX, NY, NZ)
+typedef FLOAT_TYPE (*influence_kernel_t)(system_t *, parameters_t *, data_t *, int, int, int);
 
 #endif
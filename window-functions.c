@@ -37,6 +37,145 @@ FLOAT_TYPE caf_kaiserbessel(int i, FLOAT_TYPE x, int cao) {
   }
 }
 
+/* Generated by tools/bspline_tables.py 12, weight i is
+   M_cao(x + 0.5 + cao - 1 - i). */
+const FLOAT_TYPE bspline_coef[BSPLINE_MAX_CAO+1][BSPLINE_MAX_CAO][BSPLINE_MAX_CAO] = {
+  /* cao 0 (unused) */
+  { { 0.0 } },
+  /* cao 1 */
+  {
+    { 1.0 }
+  },
+  /* cao 2 */
+  {
+    { 1.0/2.0, 1.0/2.0 },
+    { -1.0, 1.0 }
+  },
+  /* cao 3 */
+  {
+    { 1.0/8.0, 3.0/4.0, 1.0/8.0 },
+    { -1.0/2.0, 0.0, 1.0/2.0 },
+    { 1.0/2.0, -1.0, 1.0/2.0 }
+  },
+  /* cao 4 */
+  {
+    { 1.0/48.0, 23.0/48.0, 23.0/48.0, 1.0/48.0 },
+    { -1.0/8.0, -5.0/8.0, 5.0/8.0, 1.0/8.0 },
+    { 1.0/4.0, -1.0/4.0, -1.0/4.0, 1.0/4.0 },
+    { -1.0/6.0, 1.0/2.0, -1.0/2.0, 1.0/6.0 }
+  },
+  /* cao 5 */
+  {
+    { 1.0/384.0, 19.0/96.0, 115.0/192.0, 19.0/96.0, 1.0/384.0 },
+    { -1.0/48.0, -11.0/24.0, 0.0, 11.0/24.0, 1.0/48.0 },
+    { 1.0/16.0, 1.0/4.0, -5.0/8.0, 1.0/4.0, 1.0/16.0 },
+    { -1.0/12.0, 1.0/6.0, 0.0, -1.0/6.0, 1.0/12.0 },
+    { 1.0/24.0, -1.0/6.0, 1.0/4.0, -1.0/6.0, 1.0/24.0 }
+  },
+  /* cao 6 */
+  {
+    { 1.0/3840.0, 79.0/1280.0, 841.0/1920.0, 841.0/1920.0, 79.0/1280.0, 1.0/3840.0 },
+    { -1.0/384.0, -25.0/128.0, -77.0/192.0, 77.0/192.0, 25.0/128.0, 1.0/384.0 },
+    { 1.0/96.0, 7.0/32.0, -11.0/48.0, -11.0/48.0, 7.0/32.0, 1.0/96.0 },
+    { -1.0/48.0, -1.0/16.0, 7.0/24.0, -7.0/24.0, 1.0/16.0, 1.0/48.0 },
+    { 1.0/48.0, -1.0/16.0, 1.0/24.0, 1.0/24.0, -1.0/16.0, 1.0/48.0 },
+    { -1.0/120.0, 1.0/24.0, -1.0/12.0, 1.0/12.0, -1.0/24.0, 1.0/120.0 }
+  },
+  /* cao 7 */
+  {
+    { 1.0/46080.0, 361.0/23040.0, 10543.0/46080.0, 5887.0/11520.0, 10543.0/46080.0, 361.0/23040.0, 1.0/46080.0 },
+    { -1.0/3840.0, -59.0/960.0, -289.0/768.0, 0.0, 289.0/768.0, 59.0/960.0, 1.0/3840.0 },
+    { 1.0/768.0, 37.0/384.0, 79.0/768.0, -77.0/192.0, 79.0/768.0, 37.0/384.0, 1.0/768.0 },
+    { -1.0/288.0, -5.0/72.0, 43.0/288.0, 0.0, -43.0/288.0, 5.0/72.0, 1.0/288.0 },
+    { 1.0/192.0, 1.0/96.0, -17.0/192.0, 7.0/48.0, -17.0/192.0, 1.0/96.0, 1.0/192.0 },
+    { -1.0/240.0, 1.0/60.0, -1.0/48.0, 0.0, 1.0/48.0, -1.0/60.0, 1.0/240.0 },
+    { 1.0/720.0, -1.0/120.0, 1.0/48.0, -1.0/36.0, 1.0/48.0, -1.0/120.0, 1.0/720.0 }
+  },
+  /* cao 8 */
+  {
+    { 1.0/645120.0, 2179.0/645120.0, 20219.0/215040.0, 259723.0/645120.0, 259723.0/645120.0, 20219.0/215040.0, 2179.0/645120.0, 1.0/645120.0 },
+    { -1.0/46080.0, -721.0/46080.0, -9821.0/46080.0, -289.0/1024.0, 289.0/1024.0, 9821.0/46080.0, 721.0/46080.0, 1.0/46080.0 },
+    { 1.0/7680.0, 47.0/1536.0, 403.0/2560.0, -289.0/1536.0, -289.0/1536.0, 403.0/2560.0, 47.0/1536.0, 1.0/7680.0 },
+    { -1.0/2304.0, -73.0/2304.0, -5.0/2304.0, 43.0/256.0, -43.0/256.0, 5.0/2304.0, 73.0/2304.0, 1.0/2304.0 },
+    { 1.0/1152.0, 19.0/1152.0, -7.0/128.0, 43.0/1152.0, 43.0/1152.0, -7.0/128.0, 19.0/1152.0, 1.0/1152.0 },
+    { -1.0/960.0, -1.0/960.0, 19.0/960.0, -3.0/64.0, 3.0/64.0, -19.0/960.0, 1.0/960.0, 1.0/960.0 },
+    { 1.0/1440.0, -1.0/288.0, 1.0/160.0, -1.0/288.0, -1.0/288.0, 1.0/160.0, -1.0/288.0, 1.0/1440.0 },
+    { -1.0/5040.0, 1.0/720.0, -1.0/240.0, 1.0/144.0, -1.0/144.0, 1.0/240.0, -1.0/720.0, 1.0/5040.0 }
+  },
+  /* cao 9 */
+  {
+    { 1.0/10321920.0, 13.0/20480.0, 82903.0/2580480.0, 310661.0/1290240.0, 259723.0/573440.0, 310661.0/1290240.0, 82903.0/2580480.0, 13.0/20480.0, 1.0/10321920.0 },
+    { -1.0/645120.0, -121.0/35840.0, -4177.0/46080.0, -14219.0/46080.0, 0.0, 14219.0/46080.0, 4177.0/46080.0, 121.0/35840.0, 1.0/645120.0 },
+    { 1.0/92160.0, 1.0/128.0, 455.0/4608.0, 199.0/5760.0, -289.0/1024.0, 199.0/5760.0, 455.0/4608.0, 1.0/128.0, 1.0/92160.0 },
+    { -1.0/23040.0, -13.0/1280.0, -487.0/11520.0, 1327.0/11520.0, 0.0, -1327.0/11520.0, 487.0/11520.0, 13.0/1280.0, 1.0/23040.0 },
+    { 1.0/9216.0, 1.0/128.0, -17.0/2304.0, -49.0/1152.0, 43.0/512.0, -49.0/1152.0, -17.0/2304.0, 1.0/128.0, 1.0/9216.0 },
+    { -1.0/5760.0, -1.0/320.0, 41.0/2880.0, -53.0/2880.0, 0.0, 53.0/2880.0, -41.0/2880.0, 1.0/320.0, 1.0/5760.0 },
+    { 1.0/5760.0, 0.0, -1.0/288.0, 1.0/90.0, -1.0/64.0, 1.0/90.0, -1.0/288.0, 0.0, 1.0/5760.0 },
+    { -1.0/10080.0, 1.0/1680.0, -1.0/720.0, 1.0/720.0, 0.0, -1.0/720.0, 1.0/720.0, -1.0/1680.0, 1.0/10080.0 },
+    { 1.0/40320.0, -1.0/5040.0, 1.0/1440.0, -1.0/720.0, 1.0/576.0, -1.0/720.0, 1.0/1440.0, -1.0/5040.0, 1.0/40320.0 }
+  },
+  /* cao 10 */
+  {
+    { 1.0/185794560.0, 19673.0/185794560.0, 87817.0/9289728.0, 5426993.0/46448640.0, 34706647.0/92897280.0, 34706647.0/92897280.0, 5426993.0/46448640.0, 87817.0/9289728.0, 19673.0/185794560.0, 1.0/185794560.0 },
+    { -1.0/10321920.0, -6551.0/10321920.0, -16253.0/516096.0, -25639.0/122880.0, -156409.0/737280.0, 156409.0/737280.0, 25639.0/122880.0, 16253.0/516096.0, 6551.0/10321920.0, 1.0/10321920.0 },
+    { 1.0/1290240.0, 311.0/184320.0, 2815.0/64512.0, 5021.0/46080.0, -14219.0/92160.0, -14219.0/92160.0, 5021.0/46080.0, 2815.0/64512.0, 311.0/184320.0, 1.0/1290240.0 },
+    { -1.0/276480.0, -719.0/276480.0, -419.0/13824.0, 493.0/23040.0, 14597.0/138240.0, -14597.0/138240.0, -493.0/23040.0, 419.0/13824.0, 719.0/276480.0, 1.0/276480.0 },
+    { 1.0/92160.0, 233.0/92160.0, 37.0/4608.0, -907.0/23040.0, 1327.0/46080.0, 1327.0/46080.0, -907.0/23040.0, 37.0/4608.0, 233.0/92160.0, 1.0/92160.0 },
+    { -1.0/46080.0, -71.0/46080.0, 7.0/2304.0, 9.0/1280.0, -583.0/23040.0, 583.0/23040.0, -9.0/1280.0, -7.0/2304.0, 71.0/46080.0, 1.0/46080.0 },
+    { 1.0/34560.0, 17.0/34560.0, -5.0/1728.0, 47.0/8640.0, -53.0/17280.0, -53.0/17280.0, 47.0/8640.0, -5.0/1728.0, 17.0/34560.0, 1.0/34560.0 },
+    { -1.0/40320.0, 1.0/40320.0, 1.0/2016.0, -1.0/480.0, 11.0/2880.0, -11.0/2880.0, 1.0/480.0, -1.0/2016.0, -1.0/40320.0, 1.0/40320.0 },
+    { 1.0/80640.0, -1.0/11520.0, 1.0/4032.0, -1.0/2880.0, 1.0/5760.0, 1.0/5760.0, -1.0/2880.0, 1.0/4032.0, -1.0/11520.0, 1.0/80640.0 },
+    { -1.0/362880.0, 1.0/40320.0, -1.0/10080.0, 1.0/4320.0, -1.0/2880.0, 1.0/2880.0, -1.0/4320.0, 1.0/10080.0, -1.0/40320.0, 1.0/362880.0 }
+  },
+  /* cao 11 */
+  {
+    { 1.0/3715891200.0, 4217.0/265420800.0, 9116141.0/3715891200.0, 22287613.0/464486400.0, 453461641.0/1857945600.0, 381773117.0/928972800.0, 453461641.0/1857945600.0, 22287613.0/464486400.0, 9116141.0/3715891200.0, 4217.0/265420800.0, 1.0/3715891200.0 },
+    { -1.0/185794560.0, -2459.0/23224320.0, -64321.0/6881280.0, -138553.0/1290240.0, -1135841.0/4423680.0, 0.0, 1135841.0/4423680.0, 138553.0/1290240.0, 64321.0/6881280.0, 2459.0/23224320.0, 1.0/185794560.0 },
+    { 1.0/20643840.0, 655.0/2064384.0, 318509.0/20643840.0, 228577.0/2580480.0, 515.0/294912.0, -156409.0/737280.0, 515.0/294912.0, 228577.0/2580480.0, 318509.0/20643840.0, 655.0/2064384.0, 1.0/20643840.0 },
+    { -1.0/3870720.0, -17.0/30240.0, -18041.0/1290240.0, -439.0/20160.0, 8087.0/92160.0, 0.0, -8087.0/92160.0, 439.0/20160.0, 18041.0/1290240.0, 17.0/30240.0, 1.0/3870720.0 },
+    { 1.0/1105920.0, 359.0/552960.0, 7661.0/1105920.0, -1787.0/138240.0, -11639.0/552960.0, 14597.0/276480.0, -11639.0/552960.0, -1787.0/138240.0, 7661.0/1105920.0, 359.0/552960.0, 1.0/1105920.0 },
+    { -1.0/460800.0, -29.0/57600.0, -169.0/153600.0, 91.0/9600.0, -349.0/25600.0, 0.0, 349.0/25600.0, -91.0/9600.0, 169.0/153600.0, 29.0/57600.0, 1.0/460800.0 },
+    { 1.0/276480.0, 7.0/27648.0, -211.0/276480.0, -23.0/34560.0, 149.0/27648.0, -583.0/69120.0, 149.0/27648.0, -23.0/34560.0, -211.0/276480.0, 7.0/27648.0, 1.0/276480.0 },
+    { -1.0/241920.0, -1.0/15120.0, 13.0/26880.0, -1.0/840.0, 7.0/5760.0, 0.0, -7.0/5760.0, 1.0/840.0, -13.0/26880.0, 1.0/15120.0, 1.0/241920.0 },
+    { 1.0/322560.0, -1.0/161280.0, -19.0/322560.0, 13.0/40320.0, -17.0/23040.0, 11.0/11520.0, -17.0/23040.0, 13.0/40320.0, -19.0/322560.0, -1.0/161280.0, 1.0/322560.0 },
+    { -1.0/725760.0, 1.0/90720.0, -1.0/26880.0, 1.0/15120.0, -1.0/17280.0, 0.0, 1.0/17280.0, -1.0/15120.0, 1.0/26880.0, -1.0/90720.0, 1.0/725760.0 },
+    { 1.0/3628800.0, -1.0/362880.0, 1.0/80640.0, -1.0/30240.0, 1.0/17280.0, -1.0/14400.0, 1.0/17280.0, -1.0/30240.0, 1.0/80640.0, -1.0/362880.0, 1.0/3628800.0 }
+  },
+  /* cao 12 */
+  {
+    { 1.0/81749606400.0, 1687.0/778567680.0, 46702427.0/81749606400.0, 18707743.0/1089994752.0, 1806137183.0/13624934400.0, 1588223323.0/4541644800.0, 1588223323.0/4541644800.0, 1806137183.0/13624934400.0, 18707743.0/1089994752.0, 46702427.0/81749606400.0, 1687.0/778567680.0, 1.0/81749606400.0 },
+    { -1.0/3715891200.0, -19679.0/1238630400.0, -9057103.0/3715891200.0, -18798307.0/412876800.0, -4497669.0/22937600.0, -14765933.0/88473600.0, 14765933.0/88473600.0, 4497669.0/22937600.0, 18798307.0/412876800.0, 9057103.0/3715891200.0, 19679.0/1238630400.0, 1.0/3715891200.0 },
+    { 1.0/371589120.0, 6557.0/123863040.0, 49057.0/10616832.0, 404777.0/8257536.0, 925123.0/12386304.0, -1135841.0/8847360.0, -1135841.0/8847360.0, 925123.0/12386304.0, 404777.0/8257536.0, 49057.0/10616832.0, 6557.0/123863040.0, 1.0/371589120.0 },
+    { -1.0/61931520.0, -2183.0/20643840.0, -311959.0/61931520.0, -503369.0/20643840.0, 99587.0/3440640.0, 105131.0/1474560.0, -105131.0/1474560.0, -99587.0/3440640.0, 503369.0/20643840.0, 311959.0/61931520.0, 2183.0/20643840.0, 1.0/61931520.0 },
+    { 1.0/15482880.0, 145.0/1032192.0, 7421.0/2211840.0, 2011.0/1032192.0, -70657.0/2580480.0, 8087.0/368640.0, 8087.0/368640.0, -70657.0/2580480.0, 2011.0/1032192.0, 7421.0/2211840.0, 145.0/1032192.0, 1.0/15482880.0 },
+    { -1.0/5529600.0, -239.0/1843200.0, -6943.0/5529600.0, 7319.0/1843200.0, 499.0/307200.0, -4537.0/307200.0, 4537.0/307200.0, -499.0/307200.0, -7319.0/1843200.0, 6943.0/5529600.0, 239.0/1843200.0, 1.0/5529600.0 },
+    { 1.0/2764800.0, 77.0/921600.0, 11.0/110592.0, -65.0/36864.0, 71.0/18432.0, -349.0/153600.0, -349.0/153600.0, 71.0/18432.0, -65.0/36864.0, 11.0/110592.0, 77.0/921600.0, 1.0/2764800.0 },
+    { -1.0/1935360.0, -23.0/645120.0, 281.0/1935360.0, -1.0/71680.0, -31.0/35840.0, 91.0/46080.0, -91.0/46080.0, 31.0/35840.0, 1.0/71680.0, -281.0/1935360.0, 23.0/645120.0, 1.0/1935360.0 },
+    { 1.0/1935360.0, 1.0/129024.0, -19.0/276480.0, 3.0/14336.0, -97.0/322560.0, 7.0/46080.0, 7.0/46080.0, -97.0/322560.0, 3.0/14336.0, -19.0/276480.0, 1.0/129024.0, 1.0/1935360.0 },
+    { -1.0/2903040.0, 1.0/967680.0, 17.0/2903040.0, -41.0/967680.0, 19.0/161280.0, -13.0/69120.0, 13.0/69120.0, -19.0/161280.0, 41.0/967680.0, -17.0/2903040.0, -1.0/967680.0, 1.0/2903040.0 },
+    { 1.0/7257600.0, -1.0/806400.0, 1.0/207360.0, -1.0/96768.0, 1.0/80640.0, -1.0/172800.0, -1.0/172800.0, 1.0/80640.0, -1.0/96768.0, 1.0/207360.0, -1.0/806400.0, 1.0/7257600.0 },
+    { -1.0/39916800.0, 1.0/3628800.0, -1.0/725760.0, 1.0/241920.0, -1.0/120960.0, 1.0/86400.0, -1.0/86400.0, 1.0/120960.0, -1.0/241920.0, 1.0/725760.0, -1.0/3628800.0, 1.0/39916800.0 }
+  }
+};
+
+/* Generated by tools/bspline_tables.py 12, coefficients of
+   sum_m sinc(z+m)^(2 cao) in powers of cos^2(pi z). */
+const FLOAT_TYPE bspline_alias_coef[BSPLINE_MAX_CAO+1][BSPLINE_MAX_CAO] = {
+  { 0.0 },
+  { 1.0 },
+  { 1.0/3.0, 2.0/3.0 },
+  { 2.0/15.0, 11.0/15.0, 2.0/15.0 },
+  { 17.0/315.0, 4.0/7.0, 38.0/105.0, 4.0/315.0 },
+  { 62.0/2835.0, 1072.0/2835.0, 484.0/945.0, 247.0/2835.0, 2.0/2835.0 },
+  { 1382.0/155925.0, 35396.0/155925.0, 83021.0/155925.0, 34096.0/155925.0, 2026.0/155925.0, 4.0/155925.0 },
+  { 21844.0/6081075.0, 258887.0/2027025.0, 16976.0/36855.0, 424772.0/1216215.0, 4660.0/81081.0, 2722.0/2027025.0, 4.0/6081075.0 },
+  { 929569.0/638512875.0, 43800104.0/638512875.0, 6819044.0/19348875.0, 54604376.0/127702575.0, 17790298.0/127702575.0, 203512.0/19348875.0, 65476.0/638512875.0, 8.0/638512875.0 },
+  { 6404582.0/10854718875.0, 386219924.0/10854718875.0, 243629416.0/986792625.0, 4759655468.0/10854718875.0, 517840564.0/2170943775.0, 417628688.0/10854718875.0, 15618296.0/10854718875.0, 65519.0/10854718875.0, 2.0/10854718875.0 },
+  { 443861162.0/1856156927625.0, 854828732.0/47593767375.0, 11125402292.0/68746552875.0, 411731792.0/1039863825.0, 4097172428.0/12626917875.0, 2694413416.0/29462808375.0, 233791619.0/29462808375.0, 95282312.0/618718975875.0, 466.0/1649917269.0, 4.0/1856156927625.0 },
+  { 18888466084.0/194896477400625.0, 49399835278.0/5568470782875.0, 436158357364.0/4331032831125.0, 4220088438688.0/12993098493375.0, 694829440808.0/1856156927625.0, 72400911257.0/441942125625.0, 6913638092.0/265165275375.0, 16675245148.0/12993098493375.0, 633484.0/47593767375.0, 419422.0/38979295480125.0, 4.0/194896477400625.0 },
+  { 113927491862.0/2900518163668125.0, 30320209355224.0/7044115540336875.0, 6973234029572.0/116020726546725.0, 116052751476136.0/469607702689125.0, 1253661098623387.0/3287253918823875.0, 80459133219776.0/335434073349375.0, 143704963406344.0/2348038513445625.0, 3825389626096.0/657450783764775.0, 79073923634.0/469607702689125.0, 9377408104.0/9861761756471625.0, 184364.0/541855041564375.0, 8.0/49308808782358125.0 }
+};
+
 FLOAT_TYPE caf_bspline_k(int i, FLOAT_TYPE d)
 {
   double PId = PI*d;
@@ -44,142 +183,43 @@ FLOAT_TYPE caf_bspline_k(int i, FLOAT_TYPE d)
 }
 
 FLOAT_TYPE caf_bspline_d(int i, FLOAT_TYPE x, int cao_value) {
-  int ip = cao_value - 1;
-  switch (ip) 
-    {
-    case 1:
-	    switch(i) {
-	    case 0: return -1.0;
-	    case 1: return 1.0;
-	    }
-      break;
-    case 2:
-	    switch(i) {
-	    case 0: return x-0.5;
-	    case 1: return -2.0*x;
-	    case 2: return x+0.5;
-	    }
-      break;
-    case 3:
-	    switch(i) {
-	    case 0: return (-1.0+x*(  4.0+x*( -4.0)))/8.0;
-	    case 1: return (-5.0+x*( -4.0+x*( 12.0)))/8.0;
-	    case 2: return ( 5.0+x*( -4.0+x*(-12.0)))/8.0;
-	    case 3: return ( 1.0+x*(  4.0+x*(  4.0)))/8.0;
-	    }
-      break;
-    case 4:
-	    switch(i) {
-	    case 0: return ( -1.0+x*(  6.0+x*( -12.0+x*( 8.0))))/48.0;
-	    case 1: return (-11.0+x*( 12.0+x*(  12.0+x*(-16.0))))/24.0;
-	    case 2: return (      x*(-5.0+x*x*4.0))/4.0;
-	    case 3: return ( 11.0+x*( 12.0+x*( -12.0+x*(-16.0))))/ 24.0;
-	    case 4: return (  1.0+x*(  6.0+x*(  12.0+x*(  8.0))))/48.0;
-	    }
-        break;
-    case 5:
-	    switch(i) {
-	    case 0: return ( -1.0+x*(  8.0+x*( -24.0+x*(  32.0+x*(-16)))))/384.0;
-	    case 1: return (-75.0+x*( 168.0+x*( -72.0+x*( -96.0+x*(80.0)))))/384.0;
-	    case 2: return (-77.0+x*( -88.0+x*( 168.0+x*(  32.0+x*(-80.0)))))/192.0;
-	    case 3: return ( 77.0+x*( -88.0+x*(-168.0+x*(  32.0+x*(80.0)))))/192.0;
-	    case 4: return ( 75.0+x*( 168.0+x*(  72.0+x*( -96.0+x*(-80)))))/384.0;
-	    case 5: return (  1.0+x*(   8.0+x*(  24.0+x*(  32.0+x*(16.0)))))/384.0;
-	    }
-       break;
-    case 6 : 
-	    switch(i) {
-	    case 0: return (  -1.0+x*( 10.0+x*( -40.0+x*(  80.0+x*(-80.0+x*32.0)))))/3840.0;
-	    case 1: return ( -59.0+x*(185.0+x*(-200.0+x*(  40.0+x*( 80.0-x*48.0)))))/960.0;
-	    case 2: return (-289.0+x*(158.0+x*( 344.0+x*(-272.0+x*(-80.0+x*96.0)))))/768.0;
-	    case 3: return (       x*(-77.0+        x*x*(  56.0       -x*x*16.0) ) )/96.0;
-	    case 4: return ( 289.0+x*(158.0+x*(-344.0+x*(-272.0+x*( 80.0+x*96.0)))))/768.0;
-	    case 5: return (  59.0+x*(185.0+x*( 200.0+x*(  40.0+x*(-80.0-x*48.0)))))/960.0;
-	    case 6: return (   1.0+x*( 10.0+x*(  40.0+x*(  80.0+x*( 80.0+x*32.0)))))/3840.0;
-	    }
-       break;
-    default :
-      fprintf(stderr,"Charge assignment order %d unknown.\n",cao_value);
-      return 0.0;
+  const FLOAT_TYPE (*c)[BSPLINE_MAX_CAO];
+  FLOAT_TYPE r = 0.0;
+  int k;
+
+  if((cao_value < 1) || (cao_value > BSPLINE_MAX_CAO)) {
+    fprintf(stderr,"Charge assignment order %d unknown.\n",cao_value);
+    return 0.0;
   }
-  return 0.0;
+  if((i < 0) || (i >= cao_value)) {
+    fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
+    return 0.0;
+  }
+
+  c = bspline_coef[cao_value];
+  for(k=cao_value-1;k>=1;k--)
+    r = r*x + k*c[k][i];
+  return r;
 }
 
 FLOAT_TYPE caf_bspline(int i, FLOAT_TYPE x, int cao_value) {
-  switch (cao_value) {
-  case 1 : return 1.0;
-  case 2 : {
-    switch (i) {
-    case 0: return 0.5-x;
-    case 1: return 0.5+x;
-    default:
-      fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
-      return 0.0;
-    }
-  } 
-  case 3 : { 
-    switch (i) {
-    case 0: return 0.5*SQR(0.5 - x);
-    case 1: return 0.75 - SQR(x);
-    case 2: return 0.5*SQR(0.5 + x);
-    default:
-      fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
-      return 0.0;
-    }
-  case 4 : { 
-    switch (i) {
-    case 0: return ( 1.0+x*( -6.0+x*( 12.0-x* 8.0)))/48.0;
-    case 1: return (23.0+x*(-30.0+x*(-12.0+x*24.0)))/48.0;
-    case 2: return (23.0+x*( 30.0+x*(-12.0-x*24.0)))/48.0;
-    case 3: return ( 1.0+x*(  6.0+x*( 12.0+x* 8.0)))/48.0;
-    default:
-      fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
-      return 0.0;
-    }
-  }
-  case 5 : {
-    switch (i) {
-    case 0: return (  1.0+x*( -8.0+x*(  24.0+x*(-32.0+x*16.0))))/384.0;
-    case 1: return ( 19.0+x*(-44.0+x*(  24.0+x*( 16.0-x*16.0))))/ 96.0;
-    case 2: return (115.0+x*       x*(-120.0+x*       x*48.0))  /192.0;
-    case 3: return ( 19.0+x*( 44.0+x*(  24.0+x*(-16.0-x*16.0))))/ 96.0;
-    case 4: return (  1.0+x*(  8.0+x*(  24.0+x*( 32.0+x*16.0))))/384.0;
-    default:
-      fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
-      return 0.0;
-    }
-  }
-  case 6 : {
-    switch (i) {
-    case 0: return (  1.0+x*( -10.0+x*(  40.0+x*( -80.0+x*(  80.0-x* 32.0)))))/3840.0;
-    case 1: return (237.0+x*(-750.0+x*( 840.0+x*(-240.0+x*(-240.0+x*160.0)))))/3840.0;
-    case 2: return (841.0+x*(-770.0+x*(-440.0+x*( 560.0+x*(  80.0-x*160.0)))))/1920.0;
-    case 3: return (841.0+x*(+770.0+x*(-440.0+x*(-560.0+x*(  80.0+x*160.0)))))/1920.0;
-    case 4: return (237.0+x*( 750.0+x*( 840.0+x*( 240.0+x*(-240.0-x*160.0)))))/3840.0;
-    case 5: return (  1.0+x*(  10.0+x*(  40.0+x*(  80.0+x*(  80.0+x* 32.0)))))/3840.0;
-    default:
-      fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
-      return 0.0;
-    }
-  }
-  case 7 : {
-    switch (i) {
-    case 0: return (    1.0+x*(   -12.0+x*(   60.0+x*( -160.0+x*(  240.0+x*(-192.0+x* 64.0))))))/46080.0;
-    case 1: return (  361.0+x*( -1416.0+x*( 2220.0+x*(-1600.0+x*(  240.0+x*( 384.0-x*192.0))))))/23040.0;
-    case 2: return (10543.0+x*(-17340.0+x*( 4740.0+x*( 6880.0+x*(-4080.0+x*(-960.0+x*960.0))))))/46080.0;
-    case 3: return ( 5887.0+x*          x*(-4620.0+x*         x*( 1680.0-x*        x*320.0)))   /11520.0;
-    case 4: return (10543.0+x*( 17340.0+x*( 4740.0+x*(-6880.0+x*(-4080.0+x*( 960.0+x*960.0))))))/46080.0;
-    case 5: return (  361.0+x*(  1416.0+x*( 2220.0+x*( 1600.0+x*(  240.0+x*(-384.0-x*192.0))))))/23040.0;
-    case 6: return (    1.0+x*(    12.0+x*(   60.0+x*(  160.0+x*(  240.0+x*( 192.0+x* 64.0))))))/46080.0;
-    default:
-      fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
-      return 0.0;
-    }
-  }
-  default :{
+  const FLOAT_TYPE (*c)[BSPLINE_MAX_CAO];
+  FLOAT_TYPE r = 0.0;
+  int k;
+
+  if((cao_value < 1) || (cao_value > BSPLINE_MAX_CAO)) {
     fprintf(stderr,"Charge assignment order %d unknown.\n",cao_value);
     return 0.0;
-  }}}
+  }
+  if((i < 0) || (i >= cao_value)) {
+    fprintf(stderr,"Tried to access charge assignment function of degree %d in scheme of order %d.\n",i,cao_value);
+    return 0.0;
+  }
+
+  c = bspline_coef[cao_value];
+  for(k=cao_value-1;k>=0;k--)
+    r = r*x + c[k][i];
+  return r;
 }
 
 
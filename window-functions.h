@@ -27,4 +27,49 @@ FLOAT_TYPE caf_bspline_d(int i, FLOAT_TYPE x, int cao_calue);
 FLOAT_TYPE caf_kaiserbessel_k(int i, FLOAT_TYPE d);
 FLOAT_TYPE caf_kaiserbessel(int i, FLOAT_TYPE x, int cao);
 
+#define BSPLINE_MAX_CAO 12
+
+/** Expands \a X(cao, A, B) for all supported assignment orders,
+    this is the only place where they are listed. */
+#define BSPLINE_FOR_EACH_CAO(X, A, B) \
+  X(1, A, B) X(2, A, B) X(3, A, B) X(4, A, B) X(5, A, B) X(6, A, B) \
+  X(7, A, B) X(8, A, B) X(9, A, B) X(10, A, B) X(11, A, B) X(12, A, B)
+
+/** Polynomial coefficients of the B-spline assignment function,
+    bspline_coef[cao][k][i] is the coefficient of x^k for the \a i'th degree. */
+extern const FLOAT_TYPE bspline_coef[BSPLINE_MAX_CAO+1][BSPLINE_MAX_CAO][BSPLINE_MAX_CAO];
+
+/** Coefficients of the aliasing sum sum_m sinc(z+m)^(2 cao),
+    bspline_alias_coef[cao][j] is the coefficient of cos^2(pi z)^j. */
+extern const FLOAT_TYPE bspline_alias_coef[BSPLINE_MAX_CAO+1][BSPLINE_MAX_CAO];
+
+/** Computes all \a cao degrees of the assignment function at \a x
+    at once in Horner form, \a x in [-0.5,0.5]. Same as caf_bspline(i, x, cao). */
+inline static void caf_bspline_weights(int cao, FLOAT_TYPE x, FLOAT_TYPE * restrict w) {
+  const FLOAT_TYPE (* restrict c)[BSPLINE_MAX_CAO] = bspline_coef[cao];
+  int i, k;
+
+  for(i=0;i<cao;i++)
+    w[i] = c[cao-1][i];
+  for(k=cao-2;k>=0;k--) {
+#pragma omp simd
+    for(i=0;i<cao;i++)
+      w[i] = w[i]*x + c[k][i];
+  }
+}
+
+/** Same as caf_bspline_weights for the derivative, same as caf_bspline_d(i, x, cao). */
+inline static void caf_bspline_d_weights(int cao, FLOAT_TYPE x, FLOAT_TYPE * restrict w) {
+  const FLOAT_TYPE (* restrict c)[BSPLINE_MAX_CAO] = bspline_coef[cao];
+  int i, k;
+
+  for(i=0;i<cao;i++)
+    w[i] = (cao-1)*c[cao-1][i];
+  for(k=cao-2;k>=1;k--) {
+#pragma omp simd
+    for(i=0;i<cao;i++)
+      w[i] = w[i]*x + k*c[k][i];
+  }
+}
+
 #endif
@@ -0,0 +1,174 @@
+/**    Copyright (C) 2011,2012,2013 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+#include <stdio.h>
+#include <string.h>
+#include <fftw3.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "wisdom.h"
+
+/* Plan creation and persistent FFTW wisdom. Plans use as many threads
+   as OpenMP does at plan time. Every plan has its own file
+   <dir>/fftw-<precision>-<kind>-<n0>x<n1>x<n2>-t<threads>.wisdom, so the store
+   holds exactly the wisdom of one transform and stays valid across
+   runs with different meshes. The file is imported before planning;
+   if it already satisfies the requested rigor the plan is built from
+   it without measuring, otherwise the transform is planned and the
+   file is rewritten. */
+
+unsigned P3M_FFTW_FLAGS = FFTW_PATIENT;
+char *P3M_WISDOM_DIR = NULL;
+
+#define WISDOM_PATH_MAX 4096
+
+typedef struct {
+  const char *prec;
+  void (*forget)(void);
+  int (*import)(const char *);
+  int (*export)(const char *);
+  int (*init_threads)(void);
+  void (*plan_with_nthreads)(int);
+} wisdom_t;
+
+static const wisdom_t wisdom_mesh = { FFTW_PREC_NAME, FFTW_FORGET_WISDOM, FFTW_IMPORT_WISDOM, FFTW_EXPORT_WISDOM,
+				      FFTW_INIT_THREADS, FFTW_PLAN_WITH_NTHREADS };
+static const wisdom_t wisdom_float = { "f", fftwf_forget_wisdom, fftwf_import_wisdom_from_filename, fftwf_export_wisdom_to_filename,
+				       fftwf_init_threads, fftwf_plan_with_nthreads };
+
+int Wisdom_set_rigor(const char *rigor) {
+  if(strcmp(rigor, "estimate") == 0)
+    P3M_FFTW_FLAGS = FFTW_ESTIMATE;
+  else if(strcmp(rigor, "measure") == 0)
+    P3M_FFTW_FLAGS = FFTW_MEASURE;
+  else if(strcmp(rigor, "patient") == 0)
+    P3M_FFTW_FLAGS = FFTW_PATIENT;
+  else if(strcmp(rigor, "exhaustive") == 0)
+    P3M_FFTW_FLAGS = FFTW_EXHAUSTIVE;
+  else
+    return 0;
+  return 1;
+}
+
+/* Sets the number of threads for the following plans of the
+   precision, returns the number used. */
+static int wisdom_threads(const wisdom_t *w) {
+#ifdef _OPENMP
+  static int initialized[2] = { 0, 0 };
+  int *init = &initialized[(w == &wisdom_float) ? 1 : 0];
+  int nthreads = omp_get_max_threads();
+
+  if(*init == 0)
+    *init = w->init_threads() ? 1 : -1;
+
+  if(*init < 0)
+    return 1;
+
+  w->plan_with_nthreads(nthreads);
+  return nthreads;
+#else
+  return 1;
+#endif
+}
+
+/* Loads the wisdom file of the key, returns 1 if it existed. fname is
+   left empty if the store is disabled. */
+static int wisdom_import(const wisdom_t *w, const char *kind, int n0, int n1, int n2, char *fname) {
+  int nthreads = wisdom_threads(w);
+
+  fname[0] = 0;
+
+  if(P3M_WISDOM_DIR == NULL)
+    return 0;
+
+  if(snprintf(fname, WISDOM_PATH_MAX, "%s/fftw-%s-%s-%dx%dx%d-t%d.wisdom", P3M_WISDOM_DIR, w->prec, kind, n0, n1, n2, nthreads) >= WISDOM_PATH_MAX) {
+    fprintf(stderr, "Wisdom path too long, not using the wisdom store.\n");
+    fname[0] = 0;
+    return 0;
+  }
+
+  /* Start from a clean slate so that the file only receives the
+     wisdom of this transform. */
+  w->forget();
+  return w->import(fname);
+}
+
+static void wisdom_export(const wisdom_t *w, const char *fname) {
+  if(fname[0] == 0)
+    return;
+
+  if(!w->export(fname))
+    fprintf(stderr, "Could not write wisdom file '%s'.\n", fname);
+}
+
+/* Plans with FFTW_WISDOM_ONLY first, which returns NULL without
+   touching the arrays if the imported wisdom is insufficient. */
+#define WISDOM_PLAN(W, KIND, PLAN, CALL)				\
+  {									\
+    char fname[WISDOM_PATH_MAX];					\
+    unsigned flags;							\
+    PLAN = NULL;							\
+    if(wisdom_import(W, KIND, n0, n1, n2, fname)) {			\
+      flags = P3M_FFTW_FLAGS | FFTW_WISDOM_ONLY;			\
+      PLAN = CALL;							\
+    }									\
+    if(PLAN == NULL) {							\
+      flags = P3M_FFTW_FLAGS;						\
+      PLAN = CALL;							\
+      wisdom_export(W, fname);						\
+    }									\
+  }
+
+FFTW_PLAN Wisdom_plan_dft_3d(int n0, int n1, int n2, FFTW_COMPLEX *in, FFTW_COMPLEX *out, int sign) {
+  FFTW_PLAN plan;
+  WISDOM_PLAN(&wisdom_mesh, (in == out) ? "c2c-ip" : "c2c", plan, FFTW_PLAN_DFT_3D(n0, n1, n2, in, out, sign, flags));
+  return plan;
+}
+
+FFTW_PLAN Wisdom_plan_dft_r2c_3d(int n0, int n1, int n2, FLOAT_TYPE *in, FFTW_COMPLEX *out) {
+  FFTW_PLAN plan;
+  WISDOM_PLAN(&wisdom_mesh, ((void *)in == (void *)out) ? "r2c-ip" : "r2c", plan, FFTW_PLAN_DFT_R2C_3D(n0, n1, n2, in, out, flags));
+  return plan;
+}
+
+FFTW_PLAN Wisdom_plan_dft_c2r_3d(int n0, int n1, int n2, FFTW_COMPLEX *in, FLOAT_TYPE *out) {
+  FFTW_PLAN plan;
+  WISDOM_PLAN(&wisdom_mesh, ((void *)in == (void *)out) ? "c2r-ip" : "c2r", plan, FFTW_PLAN_DFT_C2R_3D(n0, n1, n2, in, out, flags));
+  return plan;
+}
+
+/* howmany contiguous in-place transforms of length n, stored one
+   after the other. The key is n x howmany x 1. */
+FFTW_PLAN Wisdom_plan_many_dft_1d(int n, int howmany, FFTW_COMPLEX *data, int sign) {
+  FFTW_PLAN plan;
+  int n0 = n, n1 = howmany, n2 = 1;
+  WISDOM_PLAN(&wisdom_mesh, "c2c-1d", plan, FFTW_PLAN_MANY_DFT(1, &n0, n1, data, NULL, 1, n0, data, NULL, 1, n0, sign, flags));
+  return plan;
+}
+
+fftwf_plan Wisdom_plan_dft_r2c_3d_float(int n0, int n1, int n2, float *in, fftwf_complex *out) {
+  fftwf_plan plan;
+  WISDOM_PLAN(&wisdom_float, ((void *)in == (void *)out) ? "r2c-ip" : "r2c", plan, fftwf_plan_dft_r2c_3d(n0, n1, n2, in, out, flags));
+  return plan;
+}
+
+fftwf_plan Wisdom_plan_dft_c2r_3d_float(int n0, int n1, int n2, fftwf_complex *in, float *out) {
+  fftwf_plan plan;
+  WISDOM_PLAN(&wisdom_float, ((void *)in == (void *)out) ? "c2r-ip" : "c2r", plan, fftwf_plan_dft_c2r_3d(n0, n1, n2, in, out, flags));
+  return plan;
+}
@@ -0,0 +1,38 @@
+/**    Copyright (C) 2011,2012,2013 Florian Weik <fweik@icp.uni-stuttgart.de>
+
+       This program is free software: you can redistribute it and/or modify
+       it under the terms of the GNU General Public License as published by
+       the Free Software Foundation, either version 3 of the License, or
+       (at your option) any later version.
+
+       This program is distributed in the hope that it will be useful,
+       but WITHOUT ANY WARRANTY; without even the implied warranty of
+       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+       GNU General Public License for more details.
+
+       You should have received a copy of the GNU General Public License
+       along with this program.  If not, see <http://www.gnu.org/licenses/>. **/
+
+#ifndef WISDOM_H
+#define WISDOM_H
+
+#include <fftw3.h>
+
+#include "types.h"
+
+/* Planner flags used for all mesh transforms. */
+extern unsigned P3M_FFTW_FLAGS;
+/* Directory of the wisdom files, NULL disables the store. */
+extern char *P3M_WISDOM_DIR;
+
+int Wisdom_set_rigor(const char *rigor);
+
+FFTW_PLAN Wisdom_plan_dft_3d(int n0, int n1, int n2, FFTW_COMPLEX *in, FFTW_COMPLEX *out, int sign);
+FFTW_PLAN Wisdom_plan_dft_r2c_3d(int n0, int n1, int n2, FLOAT_TYPE *in, FFTW_COMPLEX *out);
+FFTW_PLAN Wisdom_plan_dft_c2r_3d(int n0, int n1, int n2, FFTW_COMPLEX *in, FLOAT_TYPE *out);
+FFTW_PLAN Wisdom_plan_many_dft_1d(int n, int howmany, FFTW_COMPLEX *data, int sign);
+
+fftwf_plan Wisdom_plan_dft_r2c_3d_float(int n0, int n1, int n2, float *in, fftwf_complex *out);
+fftwf_plan Wisdom_plan_dft_c2r_3d_float(int n0, int n1, int n2, fftwf_complex *in, float *out);
+
+#endif